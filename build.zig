@@ -15,7 +15,20 @@ const tint_public_cpp_flags = [_][]const u8{
 };
 
 pub fn build(b: *Build) void {
-    _ = build_exe(b, b.standardTargetOptions(.{}), b.standardOptimizeOption(.{}), "");
+    const target = b.standardTargetOptions(.{});
+    const mode = b.standardOptimizeOption(.{});
+    _ = build_exe(b, target, mode, "");
+
+    // zig build bench -- [sokol-shdc-bench args]
+    const bench = add_exe(b, target, mode, "", "sokol-shdc-bench", "src/shdc-bench/main.cc");
+    if (bench.rootModuleTarget().os.tag == .windows) {
+        bench.linkSystemLibrary("psapi");
+    }
+    const run_bench = b.addRunArtifact(bench);
+    if (b.args) |args| {
+        run_bench.addArgs(args);
+    }
+    b.step("bench", "Run the sokol-shdc-bench pipeline benchmark").dependOn(&run_bench.step);
 }
 
 pub fn build_exe(
@@ -23,16 +36,90 @@ pub fn build_exe(
     target: Build.ResolvedTarget,
     mode: std.builtin.OptimizeMode,
     comptime prefix_path: []const u8,
+) *Build.Step.Compile {
+    const exe = add_exe(b, target, mode, prefix_path, "sokol-shdc", "src/shdc/main.cc");
+    b.installArtifact(exe);
+    return exe;
+}
+
+fn add_exe(
+    b: *Build,
+    target: Build.ResolvedTarget,
+    mode: std.builtin.OptimizeMode,
+    comptime prefix_path: []const u8,
+    name: []const u8,
+    comptime main_src: []const u8,
+) *Build.Step.Compile {
+    const exe = b.addExecutable(.{
+        .name = name,
+        .target = target,
+        .optimize = mode,
+    });
+    if (exe.rootModuleTarget().abi != .msvc)
+        exe.linkLibCpp()
+    else
+        exe.linkLibC();
+    exe.linkLibrary(lib_shdc(b, target, mode, prefix_path));
+    exe.linkLibrary(lib_fmt(b, target, mode, prefix_path));
+    exe.linkLibrary(lib_getopt(b, target, mode, prefix_path));
+    exe.linkLibrary(lib_pystring(b, target, mode, prefix_path));
+    exe.linkLibrary(lib_spirvcross(b, target, mode, prefix_path));
+    exe.linkLibrary(lib_spirvtools(b, target, mode, prefix_path));
+    exe.linkLibrary(lib_glslang(b, target, mode, prefix_path));
+    exe.linkLibrary(lib_tint(b, target, mode, prefix_path));
+    inline for (shdc_incl_dirs) |incl_dir| {
+        exe.addIncludePath(b.path(prefix_path ++ incl_dir));
+    }
+    const flags = common_cpp_flags ++ spvcross_public_cpp_flags ++ tint_public_cpp_flags;
+    exe.addCSourceFile(.{ .file = b.path(prefix_path ++ main_src), .flags = &flags });
+    return exe;
+}
+
+const shdc_incl_dirs = [_][]const u8{
+    "src/shdc",
+    "ext/fmt/include",
+    "ext/SPIRV-Cross",
+    "ext/pystring",
+    "ext/getopt/include",
+    "ext/glslang",
+    "ext/glslang/glslang/Public",
+    "ext/glslang/glslang/Include",
+    "ext/glslang/SPIRV",
+    "ext/SPIRV-Tools/include",
+    "ext/tint/include",
+    "ext/tint",
+};
+
+// the sokol-shdc compiler pipeline and the in-memory compile API (everything except main.cc)
+pub fn lib_shdc(
+    b: *Build,
+    target: Build.ResolvedTarget,
+    mode: std.builtin.OptimizeMode,
+    comptime prefix_path: []const u8,
 ) *Build.Step.Compile {
     const dir = prefix_path ++ "src/shdc/";
     const sources = [_][]const u8{
         "args.cc",
+        "batch.cc",
         "bytecode.cc",
+        "cache.cc",
         "input.cc",
-        "main.cc",
+        "jobs.cc",
+        "json.cc",
+        "lsp.cc",
+        "memstats.cc",
+        "optprofile.cc",
+        "output.cc",
+        "pipeline.cc",
         "reflection.cc",
+        "server.cc",
+        "shdc.cc",
+        "shdc_c.cc",
         "spirv.cc",
         "spirvcross.cc",
+        "stream.cc",
+        "timings.cc",
+        "watch.cc",
         "generators/bare.cc",
         "generators/generate.cc",
         "generators/generator.cc",
@@ -45,46 +132,55 @@ pub fn build_exe(
         "generators/sokolzig.cc",
         "generators/yaml.cc",
     };
-    const incl_dirs = [_][]const u8{
-        "src/shdc",
-        "ext/fmt/include",
-        "ext/SPIRV-Cross",
-        "ext/pystring",
-        "ext/getopt/include",
-        "ext/glslang",
-        "ext/glslang/glslang/Public",
-        "ext/glslang/glslang/Include",
-        "ext/glslang/SPIRV",
-        "ext/SPIRV-Tools/include",
-        "ext/tint/include",
-        "ext/tint",
-    };
-    const flags = common_cpp_flags ++ spvcross_public_cpp_flags ++ tint_public_cpp_flags;
-
-    const exe = b.addExecutable(.{
-        .name = "sokol-shdc",
+    const lib = b.addStaticLibrary(.{
+        .name = "shdc",
         .target = target,
         .optimize = mode,
     });
-    if (exe.rootModuleTarget().abi != .msvc)
-        exe.linkLibCpp()
+    if (lib.rootModuleTarget().abi != .msvc)
+        lib.linkLibCpp()
     else
-        exe.linkLibC();
-    exe.linkLibrary(lib_fmt(b, target, mode, prefix_path));
-    exe.linkLibrary(lib_getopt(b, target, mode, prefix_path));
-    exe.linkLibrary(lib_pystring(b, target, mode, prefix_path));
-    exe.linkLibrary(lib_spirvcross(b, target, mode, prefix_path));
-    exe.linkLibrary(lib_spirvtools(b, target, mode, prefix_path));
-    exe.linkLibrary(lib_glslang(b, target, mode, prefix_path));
-    exe.linkLibrary(lib_tint(b, target, mode, prefix_path));
-    inline for (incl_dirs) |incl_dir| {
-        exe.addIncludePath(b.path(prefix_path ++ incl_dir));
+        lib.linkLibC();
+    inline for (shdc_incl_dirs) |incl_dir| {
+        lib.addIncludePath(b.path(prefix_path ++ incl_dir));
     }
+    const flags = common_cpp_flags ++ spvcross_public_cpp_flags ++ tint_public_cpp_flags;
     inline for (sources) |src| {
-        exe.addCSourceFile(.{ .file = b.path(dir ++ src), .flags = &flags });
+        if (comptime std.mem.eql(u8, src, "cache.cc")) {
+            const version_flag = b.fmt("-DSHDC_BUILD_VERSION=\"{s}\"", .{build_version(b, prefix_path)});
+            const cache_flags = std.mem.concat(b.allocator, []const u8, &.{ &flags, &.{version_flag} }) catch @panic("OOM");
+            lib.addCSourceFile(.{ .file = b.path(dir ++ src), .flags = cache_flags });
+        } else {
+            lib.addCSourceFile(.{ .file = b.path(dir ++ src), .flags = &flags });
+        }
     }
-    b.installArtifact(exe);
-    return exe;
+    return lib;
+}
+
+// the sokol-tools and dependency commit hashes, these go into the
+// artifact cache keys (see Cache::key() in src/shdc/cache.cc)
+fn build_version(b: *Build, comptime prefix_path: []const u8) []const u8 {
+    const root = b.pathFromRoot(prefix_path ++ ".");
+    const cmds = [_][]const []const u8{
+        &.{ "git", "-C", root, "rev-parse", "HEAD" },
+        &.{ "git", "-C", root, "submodule", "status" },
+    };
+    var version = std.ArrayList(u8).init(b.allocator);
+    for (cmds) |cmd| {
+        var code: u8 = 0;
+        const output = b.runAllowFail(cmd, &code, .Ignore) catch continue;
+        var tokens = std.mem.tokenizeAny(u8, output, " \t\r\n+-U()");
+        while (tokens.next()) |token| {
+            if (token.len != 40) continue;
+            for (token) |c| {
+                if (!std.ascii.isHex(c)) break;
+            } else {
+                if (version.items.len > 0) version.append(',') catch @panic("OOM");
+                version.appendSlice(token) catch @panic("OOM");
+            }
+        }
+    }
+    return if (version.items.len > 0) version.items else "unknown";
 }
 
 fn lib_getopt(
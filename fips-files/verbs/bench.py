@@ -0,0 +1,160 @@
+import sys, os, time, json, importlib.util
+from mod import log, project, settings
+
+# all target languages, so that each snippet goes through every backend
+bench_slangs = 'glsl430:glsl300es:hlsl5:metal_macos:metal_ios:metal_sim:wgsl'
+default_iterations = 5
+
+# compile one shader 'iterations' times and return the fastest run in seconds,
+# runs single-threaded to get stable numbers for the translation backends
+def bench_shader(fips_dir, proj_dir, cfg_name, out_path, shader_filename, iterations, extra_args=[]):
+    cwd = proj_dir + '/test'
+    args = [
+        '-i', shader_filename,
+        '-o', f'{out_path}/{os.path.basename(shader_filename)}',
+        '-l', bench_slangs,
+        '-f', 'bare',
+        '--jobs', '1',
+    ] + extra_args
+    best = None
+    for _ in range(iterations):
+        start = time.perf_counter()
+        exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args, cwd)
+        duration = time.perf_counter() - start
+        if exit_code != 0:
+            sys.exit(exit_code)
+        if best is None or duration < best:
+            best = duration
+    return best
+
+# compile one shader 'iterations' times with --timings and return the fastest
+# 'spirv_parse' stage total in seconds, the number of SPIRV parses and the number
+# of backend translations; without a shared parsed IR each translation would
+# parse the SPIRV blob again on top of the reflection parse
+translate_stages = [ 'to_glsl', 'to_hlsl', 'to_msl', 'to_wgsl' ]
+def bench_spirv_parse(fips_dir, proj_dir, cfg_name, out_path, shader_filename, iterations):
+    trace_path = f'{out_path}/{os.path.basename(shader_filename)}.trace.json'
+    best = None
+    for _ in range(iterations):
+        bench_shader(fips_dir, proj_dir, cfg_name, out_path, shader_filename, 1, [ '--timings', trace_path ])
+        with open(trace_path, 'r') as f:
+            events = [ev for ev in json.load(f)['traceEvents'] if ev['ph'] == 'X']
+        parses = [ev['dur'] for ev in events if ev['name'] == 'spirv_parse']
+        num_translations = len([ev for ev in events if ev['name'] in translate_stages])
+        duration = sum(parses) / 1000000.0
+        if best is None or duration < best[0]:
+            best = (duration, len(parses), num_translations)
+    return best
+
+# the synthetic shader module generator in scripts/gen-synthetic-module.py
+def load_synthetic_module_generator(proj_dir):
+    spec = importlib.util.spec_from_file_location('gen_synthetic_module', f'{proj_dir}/scripts/gen-synthetic-module.py')
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+# compile all shaders 'iterations' times in a single process via
+# a batch manifest and return the fastest run in seconds
+def bench_batch(fips_dir, proj_dir, cfg_name, out_path, shaders, iterations):
+    cwd = proj_dir + '/test'
+    manifest_path = f'{out_path}/manifest.txt'
+    with open(manifest_path, 'w') as f:
+        for shader in shaders:
+            f.write(f'-i "{shader}" -o "{out_path}/{os.path.basename(shader)}" -l {bench_slangs} -f bare\n')
+    best = None
+    for _ in range(iterations):
+        start = time.perf_counter()
+        exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', [ '--batch', manifest_path ], cwd)
+        duration = time.perf_counter() - start
+        if exit_code != 0:
+            sys.exit(exit_code)
+        if best is None or duration < best:
+            best = duration
+    return best
+
+# run the check-only mode (--check) on one shader 'iterations' times and return
+# the fastest run in seconds, this includes the process startup time
+def bench_check(fips_dir, proj_dir, cfg_name, shader_filename, iterations):
+    cwd = proj_dir + '/test'
+    best = None
+    for _ in range(iterations):
+        start = time.perf_counter()
+        exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', [ '-i', shader_filename, '--check' ], cwd)
+        duration = time.perf_counter() - start
+        if exit_code != 0:
+            sys.exit(exit_code)
+        if best is None or duration < best:
+            best = duration
+    return best
+
+def run(fips_dir, proj_dir, args):
+    cfg_name = None
+    iterations = default_iterations
+    if len(args) > 0:
+        cfg_name = args[0]
+    if len(args) > 1:
+        iterations = int(args[1])
+    if cfg_name is None:
+        cfg_name = settings.get(proj_dir, 'config')
+    out_path = f'{proj_dir}/test/out/bench'
+    if not os.path.isdir(out_path):
+        os.makedirs(out_path)
+    shaders = [f'sapp/{f}' for f in sorted(os.listdir(f'{proj_dir}/test/sapp')) if f.endswith('.glsl')]
+    # the 'unshared' column is an estimate from the mean parse time, one
+    # parse per translation plus the reflection parse of each blob
+    log.info(log.YELLOW + f'\n==> sokol-shdc SPIRV parse time ({cfg_name}, spirv_parse stage, best of {iterations}):' + log.DEF)
+    log.info(f'  {"":<40} {"parses":>8} {"shared":>11} {"parses":>8} {"unshared":>11}')
+    total_shared, total_unshared = 0.0, 0.0
+    for shader in shaders:
+        duration, num_parses, num_translations = bench_spirv_parse(fips_dir, proj_dir, cfg_name, out_path, shader, iterations)
+        num_unshared = num_parses + num_translations
+        unshared = (duration / num_parses) * num_unshared if num_parses > 0 else 0.0
+        total_shared += duration
+        total_unshared += unshared
+        log.info(f'  {shader:<40} {num_parses:8} {duration * 1000.0:8.2f} ms {num_unshared:8} {unshared * 1000.0:8.2f} ms')
+    log.info(f'  {"total":<40} {"":8} {total_shared * 1000.0:8.2f} ms {"":8} {total_unshared * 1000.0:8.2f} ms')
+    batch = bench_batch(fips_dir, proj_dir, cfg_name, out_path, shaders, iterations)
+    log.info(f'  {"batch mode (--batch, all cores)":<40} {batch * 1000.0:8.2f} ms')
+    log.info(log.YELLOW + f'\n==> sokol-shdc --check ({cfg_name}, best of {iterations}):' + log.DEF)
+    check_results = [(shader, bench_check(fips_dir, proj_dir, cfg_name, shader, iterations)) for shader in shaders]
+    for shader, duration in check_results:
+        log.info(f'  {shader:<40} {duration * 1000.0:8.2f} ms')
+    slowest = max(check_results, key=lambda res: res[1])
+    log.info(f'  {"slowest (" + slowest[0] + ")":<40} {slowest[1] * 1000.0:8.2f} ms')
+    # only snippets which are used by a (selected) @program are compiled
+    log.info(log.YELLOW + f'\n==> sokol-shdc unused snippets ({cfg_name}, best of {iterations}):' + log.DEF)
+    num_pairs, num_used = 32, 4
+    all_used_path = f'{out_path}/synthetic_all_used.glsl'
+    few_used_path = f'{out_path}/synthetic_few_used.glsl'
+    synthetic = load_synthetic_module_generator(proj_dir)
+    synthetic.write_module(all_used_path, num_pairs)
+    synthetic.write_module(few_used_path, num_pairs, num_used)
+    selected = ':'.join([f'prog_{i}' for i in range(num_used)])
+    synthetic_results = [
+        (f'{num_pairs} of {num_pairs} snippet pairs used', bench_shader(fips_dir, proj_dir, cfg_name, out_path, all_used_path, iterations)),
+        (f'{num_used} of {num_pairs} snippet pairs used', bench_shader(fips_dir, proj_dir, cfg_name, out_path, few_used_path, iterations)),
+        (f'--programs ({num_used} of {num_pairs} programs)', bench_shader(fips_dir, proj_dir, cfg_name, out_path, all_used_path, iterations, [ '--programs', selected ])),
+    ]
+    for name, duration in synthetic_results:
+        log.info(f'  {name:<40} {duration * 1000.0:8.2f} ms')
+    # resuming from saved SPIRV files skips glslang and the SPIRV optimizer
+    log.info(log.YELLOW + f'\n==> sokol-shdc SPIRV input ({cfg_name}, best of {iterations}):' + log.DEF)
+    spirv_dir = f'{out_path}/spirv'
+    if not os.path.isdir(spirv_dir):
+        os.makedirs(spirv_dir)
+    spirv_args = [ '-t', spirv_dir ]
+    spirv_results = [
+        ('compile from GLSL', bench_shader(fips_dir, proj_dir, cfg_name, out_path, all_used_path, iterations, spirv_args + [ '--save-intermediate-spirv' ])),
+        ('--load-intermediate-spirv', bench_shader(fips_dir, proj_dir, cfg_name, out_path, all_used_path, iterations, spirv_args + [ '--load-intermediate-spirv' ])),
+    ]
+    for name, duration in spirv_results:
+        log.info(f'  {name:<40} {duration * 1000.0:8.2f} ms')
+    # in-process pipeline benchmark over all test shaders, slangs and output formats,
+    # compared against test/bench-baseline.json (record with --update-baseline)
+    log.info('')
+    exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc-bench', [ '--dir', f'{proj_dir}/test', '--iterations', str(iterations) ], proj_dir)
+    if exit_code != 0:
+        sys.exit(exit_code)
+
+def help():
+    log.info(log.YELLOW + 'fips bench [cfg] [iterations]\n' + log.DEF + '    time shader compilation over the test/sapp corpus')
@@ -1,11 +1,12 @@
-import sys, os
-from mod import log, project, settings
+import sys, os, shutil, subprocess, json, importlib.util
+from mod import log, project, settings, util
 
 shaders = [
     'chipvis.glsl',
     'fontstash.glsl',
     'imgui.glsl',
     'infinity.glsl',
+    'include_test.glsl',
     'inout_mismatch.glsl',
     'sgl.glsl',
     'shared_ub.glsl',
@@ -15,6 +16,7 @@ shaders = [
     'ub_equality_1.glsl',
     'ub_equality_2.glsl',
     'uniform_types.glsl',
+    'unused_snippets.glsl',
     'unused_vertex_attr.glsl',
     # sokol-samples shaders
     'sapp/arraytex-sapp.glsl',
@@ -64,10 +66,35 @@ shaders = [
     'sapp/vertexpull-sapp.glsl',
 ]
 
-def run_sokol_shdc(fips_dir, proj_dir, cfg_name, out_path, shader_filename):
+# shaders which are compiled for each target language separately and for all target
+# languages at once, the reflection info of both must match the reference files in
+# test/reflection, which were recorded with the sokol-shdc build of the baseline commit
+# before the reflection info was shared between target languages (record them with
+# 'fips run_tests [cfg] update-reflection-refs' and a baseline build)
+reflection_shaders = [
+    'reflection_slangs.glsl',
+]
+reflection_slangs = ['glsl430', 'glsl300es', 'hlsl5', 'metal_macos', 'metal_ios', 'metal_sim', 'wgsl']
+
+# shaders which are compiled without cache, with a cold cache and with a
+# warm cache (--cache-dir), the generated output must be identical
+cache_shaders = [
+    'shared_ub.glsl',
+    'sapp/shdfeatures-sapp.glsl',
+]
+
+# resolve the build config (the fips default if None), and return it together with
+# the working directory of the tests and the path of the sokol-shdc executable
+def test_setup(fips_dir, proj_dir, cfg_name):
     if cfg_name is None:
         cfg_name = settings.get(proj_dir, 'config')
     cwd = proj_dir + '/test'
+    deploy_dir = util.get_deploy_dir(fips_dir, util.get_project_name_from_dir(proj_dir), cfg_name)
+    exe_path = f'{deploy_dir}/sokol-shdc' + ('.exe' if sys.platform == 'win32' else '')
+    return cfg_name, cwd, exe_path
+
+def run_sokol_shdc(fips_dir, proj_dir, cfg_name, out_path, shader_filename):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
     args = [
         '-i', shader_filename,
         '-o', f'{out_path}/{shader_filename}.h',
@@ -79,7 +106,653 @@ def run_sokol_shdc(fips_dir, proj_dir, cfg_name, out_path, shader_filename):
     if exit_code != 0:
         sys.exit(exit_code)
 
+# split a bare_yaml reflection file into per-slang sections, without
+# the shader file paths (which depend on the output path)
+def load_reflection_sections(path):
+    sections = {}
+    with open(path, 'r') as f:
+        items = f.read().split('\n  -\n')[1:]
+    for item in items:
+        slang = None
+        lines = []
+        for line in item.splitlines():
+            stripped = line.strip()
+            if stripped.startswith('slang:'):
+                slang = stripped.split(':')[1].strip()
+            elif not stripped.startswith('path:'):
+                lines.append(line)
+        sections[slang] = '\n'.join(lines)
+    return sections
+
+def run_reflection_test(fips_dir, proj_dir, cfg_name, out_path, shader_filename, update_refs):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    log.info(f'==> {shader_filename} (reflection per slang):')
+    ref_dir = f'{cwd}/reflection'
+    runs = [ ':'.join(reflection_slangs) ] + reflection_slangs
+    for slang in runs:
+        out_base = f'{out_path}/{shader_filename}_{slang.replace(":", "_")}'
+        args = [ '-i', shader_filename, '-o', out_base, '-l', slang, '-f', 'bare_yaml' ]
+        exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args, cwd)
+        if exit_code != 0:
+            sys.exit(exit_code)
+    if update_refs:
+        if not os.path.isdir(ref_dir):
+            os.makedirs(ref_dir)
+        for slang in reflection_slangs:
+            shutil.copyfile(f'{out_path}/{shader_filename}_{slang}_reflection.yaml', f'{ref_dir}/{shader_filename}_{slang}_reflection.yaml')
+        return
+    all_refl = load_reflection_sections(f'{out_path}/{shader_filename}_{runs[0].replace(":", "_")}_reflection.yaml')
+    for slang in reflection_slangs:
+        ref_path = f'{ref_dir}/{shader_filename}_{slang}_reflection.yaml'
+        if not os.path.isfile(ref_path):
+            log.error(f'reflection reference {ref_path} missing (record it with a baseline build and "fips run_tests [cfg] update-reflection-refs")')
+            continue
+        ref_refl = load_reflection_sections(ref_path)
+        single_refl = load_reflection_sections(f'{out_path}/{shader_filename}_{slang}_reflection.yaml')
+        if single_refl[slang] != ref_refl[slang]:
+            log.error(f'reflection mismatch for {shader_filename} ({slang}) against {ref_path}')
+        if all_refl[slang] != ref_refl[slang]:
+            log.error(f'reflection mismatch for {shader_filename} ({slang}, compiled for all slangs) against {ref_path}')
+
+# load a generated file without the cmdline comment (which contains the output path)
+def load_output(path):
+    with open(path, 'r') as f:
+        return [line for line in f.read().splitlines() if 'sokol-shdc -i' not in line]
+
+def run_cache_test(fips_dir, proj_dir, cfg_name, out_path, shader_filename):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    cache_dir = f'{out_path}/cache'
+    if os.path.isdir(cache_dir):
+        shutil.rmtree(cache_dir)
+    log.info(f'==> {shader_filename} (artifact cache):')
+    outputs = []
+    for run in ['nocache', 'cold', 'warm']:
+        output = f'{out_path}/{shader_filename}.{run}.h'
+        args = [
+            '-i', shader_filename,
+            '-o', output,
+            '-l', 'glsl300es:glsl430:hlsl4:metal_macos:metal_ios:metal_sim:wgsl',
+            '-b',
+        ]
+        if run != 'nocache':
+            args += [ '--cache-dir', cache_dir ]
+        exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args, cwd)
+        if exit_code != 0:
+            sys.exit(exit_code)
+        outputs.append(output)
+    for output in outputs[1:]:
+        if load_output(outputs[0]) != load_output(output):
+            log.error(f'cached output mismatch for {shader_filename} ({output})')
+    # evicting all entries must not touch files which don't belong to the cache
+    unrelated_paths = [ f'{cache_dir}/unrelated.txt', f'{cache_dir}/sokol-shdc/unrelated.txt' ]
+    for path in unrelated_paths:
+        with open(path, 'w') as f:
+            f.write('not a cache entry\n')
+    args = [ '-i', shader_filename, '-o', f'{out_path}/{shader_filename}.trim.h', '-l', 'glsl430', '--cache-dir', cache_dir, '--cache-size', '0' ]
+    exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args, cwd)
+    if exit_code != 0:
+        sys.exit(exit_code)
+    for path in unrelated_paths:
+        if not os.path.isfile(path):
+            log.error(f'cache eviction removed unrelated file {path}')
+    if any(name.endswith('.spv') for name in os.listdir(f'{cache_dir}/sokol-shdc')):
+        log.error(f'cache eviction with --cache-size 0 left SPIRV entries in {cache_dir}')
+
+# compile a shader with --incremental before and after an unrelated edit,
+# the output must be identical to a regular compilation of the same source,
+# the manifest must only contain the names and hashes of the cache entries
+def run_incremental_test(fips_dir, proj_dir, cfg_name, out_path, shader_filename):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    incr_path = f'{out_path}/incremental'
+    if os.path.isdir(incr_path):
+        shutil.rmtree(incr_path)
+    os.makedirs(incr_path)
+    src_path = f'{incr_path}/{os.path.basename(shader_filename)}'
+    shutil.copyfile(f'{cwd}/{shader_filename}', src_path)
+    log.info(f'==> {shader_filename} (incremental):')
+    for run in ['cold', 'warm', 'edit']:
+        if run == 'edit':
+            with open(src_path, 'a') as f:
+                f.write('\n@block incremental_test_block\n// unused block\n@end\n')
+        outputs = []
+        for mode in ['regular', 'incremental']:
+            output = f'{incr_path}/{mode}.h'
+            args = [
+                '-i', src_path,
+                '-o', output,
+                '-l', 'glsl300es:glsl430:hlsl4:metal_macos:metal_ios:metal_sim:wgsl',
+                '-b',
+            ]
+            if mode == 'incremental':
+                args += [ '--incremental' ]
+            exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args, cwd)
+            if exit_code != 0:
+                sys.exit(exit_code)
+            outputs.append(output)
+        manifest_path = f'{incr_path}/incremental.h.shdc-manifest'
+        payload_dir = f'{incr_path}/incremental.h.shdc-cache'
+        if not os.path.isfile(manifest_path) or not os.path.isdir(payload_dir):
+            log.error(f'incremental manifest or cache directory missing for {shader_filename}')
+        elif os.path.getsize(manifest_path) >= sum(os.path.getsize(f'{payload_dir}/{f}') for f in os.listdir(payload_dir)):
+            log.error(f'incremental manifest contains compilation results for {shader_filename}')
+        if load_output(outputs[0]) != load_output(outputs[1]):
+            log.error(f'incremental output mismatch for {shader_filename} ({run})')
+
+# compile a shader with @include files twice and check the depfile, the
+# second run must not touch the output file since its content doesn't change
+def run_depfile_test(fips_dir, proj_dir, cfg_name, out_path, shader_filename):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    output = f'{out_path}/{shader_filename}.dep.h'
+    depfile = f'{out_path}/{shader_filename}.d'
+    log.info(f'==> {shader_filename} (depfile):')
+    mtimes = []
+    for _ in range(2):
+        args = [
+            '-i', shader_filename,
+            '-o', output,
+            '-l', 'glsl430:hlsl5:metal_macos',
+            '--depfile', depfile,
+        ]
+        exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args, cwd)
+        if exit_code != 0:
+            sys.exit(exit_code)
+        mtimes.append(os.stat(output).st_mtime_ns)
+    if mtimes[0] != mtimes[1]:
+        log.error(f'unchanged output was rewritten for {shader_filename}')
+    with open(depfile, 'r') as f:
+        deps = f.read().replace('\\\n', ' ').split()
+    if deps[0] != f'{output}:' or deps[1] != shader_filename or not any(dep.endswith('include_test_inc.glsl') for dep in deps[2:]):
+        log.error(f'unexpected depfile content for {shader_filename}: {deps}')
+
+# generate several output formats from a single compilation, the output must be
+# identical to separate invocations with a single output format each
+def run_multi_format_test(fips_dir, proj_dir, cfg_name, out_path, shader_filename):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    log.info(f'==> {shader_filename} (multiple output formats):')
+    formats = [ ('sokol', 'h'), ('sokol_zig', 'zig'), ('bare_yaml', 'bare') ]
+    base_args = [ '-i', shader_filename, '-l', 'glsl430:hlsl5:metal_macos' ]
+    multi_args = base_args + [ '-o', f'{out_path}/{shader_filename}.multi.h' ]
+    for fmt, ext in formats[1:]:
+        multi_args += [ '-f', f'{fmt}={out_path}/{shader_filename}.multi.{ext}' ]
+    exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', multi_args, cwd)
+    if exit_code != 0:
+        sys.exit(exit_code)
+    for fmt, ext in formats:
+        args = base_args + [ '-o', f'{out_path}/{shader_filename}.single.{ext}', '-f', fmt ]
+        exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args, cwd)
+        if exit_code != 0:
+            sys.exit(exit_code)
+        # the bare_yaml format writes the reflection info next to the output path
+        suffix = '_reflection.yaml' if fmt == 'bare_yaml' else ''
+        multi_output = [line.replace('.multi.', '.single.') for line in load_output(f'{out_path}/{shader_filename}.multi.{ext}{suffix}')]
+        if multi_output != load_output(f'{out_path}/{shader_filename}.single.{ext}{suffix}'):
+            log.error(f'output mismatch for {shader_filename} ({fmt})')
+
+# compile a shader with --programs, only the selected programs and the snippets
+# they use must end up in the output
+def run_programs_test(fips_dir, proj_dir, cfg_name, out_path, shader_filename):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    output = f'{out_path}/{shader_filename}.programs.h'
+    log.info(f'==> {shader_filename} (--programs):')
+    args = [ '-i', shader_filename, '-o', output, '-l', 'glsl430:hlsl5:metal_macos', '--programs', 'prog_a' ]
+    exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args, cwd)
+    if exit_code != 0:
+        sys.exit(exit_code)
+    with open(output, 'r') as f:
+        content = f.read()
+    if 'prog_a_shader_desc' not in content or 'prog_b_shader_desc' in content or 'fs_params' in content:
+        log.error(f'unexpected programs in {output}')
+
+# save the intermediate SPIRV of a shader, and compile it again from the saved SPIRV files,
+# once via @spirv tags which replace the GLSL code, and once with --load-intermediate-spirv,
+# the output must be identical to the regular compilation
+def run_spirv_input_test(fips_dir, proj_dir, cfg_name, out_path, shader_filename):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    spirv_path = f'{out_path}/spirv'
+    if os.path.isdir(spirv_path):
+        shutil.rmtree(spirv_path)
+    os.makedirs(spirv_path)
+    log.info(f'==> {shader_filename} (SPIRV input):')
+    base_name = os.path.basename(shader_filename)
+    base_args = [ '-l', 'glsl430', '-t', spirv_path ]
+    runs = [
+        ('regular', [ '-i', shader_filename, '--save-intermediate-spirv' ]),
+        ('resume', [ '-i', shader_filename, '--load-intermediate-spirv' ]),
+        ('precompiled', [ '-i', f'{spirv_path}/{base_name}' ]),
+    ]
+    # replace the code of all @vs and @fs blocks with a @spirv tag
+    with open(f'{cwd}/{shader_filename}', 'r') as f:
+        src_lines = f.read().splitlines()
+    with open(f'{spirv_path}/{base_name}', 'w') as f:
+        in_snippet = False
+        for line in src_lines:
+            tokens = line.split()
+            if len(tokens) == 2 and tokens[0] in ['@vs', '@fs']:
+                f.write(f'{line}\n@spirv {base_name}_glsl430_{tokens[1]}.spv\n')
+                in_snippet = True
+            elif in_snippet and tokens[:1] == ['@end']:
+                in_snippet = False
+            if not in_snippet:
+                f.write(f'{line}\n')
+    for run, args in runs:
+        exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args + base_args + [ '-o', f'{spirv_path}/{run}.h' ], cwd)
+        if exit_code != 0:
+            sys.exit(exit_code)
+    for run, _ in runs[1:]:
+        if load_output(f'{spirv_path}/regular.h') != load_output(f'{spirv_path}/{run}.h'):
+            log.error(f'SPIRV input output mismatch for {shader_filename} ({run})')
+
+# compile a shader from stdin to stdout, and from an input bundle (with its @include
+# files) to an output bundle, the output must be identical to the regular output
+def run_stream_test(fips_dir, proj_dir, cfg_name, out_path, shader_filename, include_filenames):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    log.info(f'==> {shader_filename} (stdin/stdout and bundles):')
+    slang_args = [ '-l', 'glsl300es:glsl430:hlsl4:metal_macos:metal_ios:metal_sim' ]
+    exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', [ '-i', shader_filename, '-o', f'{out_path}/{shader_filename}.stream.h' ] + slang_args, cwd)
+    if exit_code != 0:
+        sys.exit(exit_code)
+    expected = load_output(f'{out_path}/{shader_filename}.stream.h')
+    with open(f'{cwd}/{shader_filename}', 'rb') as f:
+        src = f.read()
+    res = subprocess.run([exe_path, '--input=-', '--output=-'] + slang_args, cwd=cwd, input=src, stdout=subprocess.PIPE)
+    if res.returncode != 0 or [line for line in res.stdout.decode().splitlines() if 'sokol-shdc -i' not in line] != expected:
+        log.error(f'stdin/stdout output mismatch for {shader_filename}')
+    bundle = b'sokol-shdc-bundle 1\n'
+    for filename in [shader_filename] + include_filenames:
+        with open(f'{cwd}/{filename}', 'rb') as f:
+            content = f.read()
+        bundle += f'file {len(content)} {filename}\n'.encode() + content + b'\n'
+    output = f'{out_path}/{shader_filename}.bundle.h'
+    res = subprocess.run([exe_path, '--input-bundle=-', '--output-bundle=-', '-o', output] + slang_args, cwd=out_path, input=bundle, stdout=subprocess.PIPE)
+    header, _, rest = res.stdout.partition(b'\n')
+    entry, _, content = rest.partition(b'\n')
+    if res.returncode != 0 or header != b'sokol-shdc-bundle 1' or entry.decode() != f'file {len(content) - 1} {output}':
+        log.error(f'unexpected output bundle for {shader_filename}')
+    elif [line for line in content.decode().splitlines() if 'sokol-shdc -i' not in line] != expected:
+        log.error(f'bundle output mismatch for {shader_filename}')
+    if os.path.isfile(output):
+        log.error(f'output file was written in bundle mode for {shader_filename}')
+
+# run the check-only mode on all shaders, this must succeed without writing an output file
+def run_check_test(fips_dir, proj_dir, cfg_name, shader_filename):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    log.info(f'==> {shader_filename} (check):')
+    exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', [ '-i', shader_filename, '--check' ], cwd)
+    if exit_code != 0:
+        log.error(f'--check failed for {shader_filename}')
+
+# compile a shader with --jobs 1 and --jobs 8, the generated output, the exit code
+# and the message text on stdout and stderr must be identical
+def run_jobs_test(fips_dir, proj_dir, cfg_name, out_path, shader_filename):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    log.info(f'==> {shader_filename} (--jobs 1 vs --jobs 8):')
+    results = []
+    for num_jobs in [1, 8]:
+        output = f'{out_path}/{shader_filename.replace("/", "_")}.jobs{num_jobs}.h'
+        if os.path.exists(output):
+            os.remove(output)
+        args = [ exe_path, '-i', shader_filename, '-o', output, '-l', 'glsl300es:glsl430:hlsl4:metal_macos:metal_ios:metal_sim:wgsl', '--jobs', str(num_jobs) ]
+        res = subprocess.run(args, cwd=cwd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+        results.append((res.returncode, res.stdout, res.stderr, load_output(output) if os.path.exists(output) else None))
+    if results[0] != results[1]:
+        log.error(f'--jobs 1 and --jobs 8 differ for {shader_filename}')
+
+# a shader with errors in several snippets, for comparing the error text of serial and parallel compilation
+def write_jobs_error_shader(path):
+    with open(path, 'w') as f:
+        for i in range(8):
+            f.write(f'@vs vs_{i}\nin vec4 position;\nvoid main() {{\n    gl_Position = position * undefined_{i};\n}}\n@end\n\n')
+            f.write(f'@fs fs_{i}\nout vec4 frag_color;\nvoid main() {{\n    frag_color = vec4({i}.0);\n}}\n@end\n\n')
+            f.write(f'@program prog_{i} vs_{i} fs_{i}\n\n')
+
+# compile all shaders in a single sokol-shdc process via a batch manifest,
+# the output must be identical to the output of separate invocations
+def run_batch_test(fips_dir, proj_dir, cfg_name, out_path):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    batch_path = f'{out_path}/batch'
+    if not os.path.isdir(f'{batch_path}/sapp'):
+        os.makedirs(f'{batch_path}/sapp')
+    manifest_path = f'{batch_path}/manifest.txt'
+    with open(manifest_path, 'w') as f:
+        f.write('# generated by fips run_tests\n')
+        for shader in shaders:
+            f.write(f'-i "{shader}" -o "{batch_path}/{shader}.h" -l glsl300es:glsl430:hlsl4:metal_macos:metal_ios:metal_sim -b\n')
+    log.info(f'==> batch mode ({len(shaders)} jobs):')
+    exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', [ '--batch', manifest_path ], cwd)
+    if exit_code != 0:
+        sys.exit(exit_code)
+    for shader in shaders:
+        if load_output(f'{out_path}/{shader}.h') != load_output(f'{batch_path}/{shader}.h'):
+            log.error(f'batch output mismatch for {shader}')
+
+# compile all shaders through a stdio compile server (--server stdio),
+# the output must be identical to the regular command line output
+def run_server_test(fips_dir, proj_dir, cfg_name, out_path):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    server_path = f'{out_path}/server'
+    if not os.path.isdir(f'{server_path}/sapp'):
+        os.makedirs(f'{server_path}/sapp')
+    log.info(f'==> server mode ({len(shaders)} requests):')
+    server = subprocess.Popen([exe_path, '--server', 'stdio'], cwd=cwd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, text=True)
+    for i, shader in enumerate(shaders):
+        args = [ '-i', shader, '-o', f'{server_path}/{shader}.h', '-l', 'glsl300es:glsl430:hlsl4:metal_macos:metal_ios:metal_sim', '-b' ]
+        server.stdin.write(json.dumps({ 'jsonrpc': '2.0', 'id': i, 'method': 'compile', 'params': { 'cwd': cwd, 'args': args }}) + '\n')
+    server.stdin.write(json.dumps({ 'jsonrpc': '2.0', 'id': len(shaders), 'method': 'shutdown' }) + '\n')
+    server.stdin.close()
+    responses = [json.loads(line) for line in server.stdout if line.strip()]
+    server.wait()
+    if len(responses) != len(shaders) + 1 or responses[-1]['id'] != len(shaders):
+        log.error('unexpected number of server responses')
+    for res in responses[:-1]:
+        if 'result' not in res or res['result']['exit_code'] != 0:
+            log.error(f'server request for {shaders[res["id"]]} failed')
+    for shader in shaders:
+        if load_output(f'{out_path}/{shader}.h') != load_output(f'{server_path}/{shader}.h'):
+            log.error(f'server output mismatch for {shader}')
+
+# the highest number of tracks (threads) with a trace event at the same time in a --timings
+# trace, nested events on the same track count once
+def max_busy_tracks(trace_path):
+    with open(trace_path, 'r') as f:
+        events = [ev for ev in json.load(f)['traceEvents'] if ev['ph'] == 'X']
+    intervals = {}
+    for ev in sorted(events, key=lambda ev: ev['ts']):
+        track = intervals.setdefault(ev['tid'], [])
+        start, end = ev['ts'], ev['ts'] + ev['dur']
+        if track and start <= track[-1][1]:
+            track[-1][1] = max(track[-1][1], end)
+        else:
+            track.append([start, end])
+    # at the same time stamp, ends come before starts
+    edges = sorted([(start, 1) for track in intervals.values() for start, _ in track] + [(end, -1) for track in intervals.values() for _, end in track])
+    busy = 0
+    max_busy = 0
+    for _, delta in edges:
+        busy += delta
+        max_busy = max(max_busy, busy)
+    return max_busy
+
+# run the batch manifest under a fake GNU make jobserver (a fifo with a few distinct tokens),
+# every token which was taken must be written back exactly once, and the --timings trace
+# must never show more threads working at the same time than the tokens plus the implicit
+# token of the process (without tokens in the fifo, all work must happen on one thread)
+jobserver_token_counts = [0, 2]
+def run_jobserver_test(fips_dir, proj_dir, cfg_name, out_path):
+    if sys.platform == 'win32':
+        return
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    for num_tokens in jobserver_token_counts:
+        log.info(f'==> jobserver ({num_tokens} tokens):')
+        fifo_path = f'{out_path}/jobserver.fifo'
+        trace_path = f'{out_path}/jobserver_{num_tokens}.json'
+        if os.path.exists(fifo_path):
+            os.remove(fifo_path)
+        os.mkfifo(fifo_path)
+        read_fd = os.open(fifo_path, os.O_RDONLY | os.O_NONBLOCK)
+        write_fd = os.open(fifo_path, os.O_WRONLY)
+        tokens = bytes(ord('a') + i for i in range(num_tokens))
+        os.write(write_fd, tokens)
+        env = dict(os.environ, MAKEFLAGS=f' -j{num_tokens + 1} --jobserver-auth=fifo:{fifo_path}')
+        args = [exe_path, '--batch', f'{out_path}/batch/manifest.txt', '--jobs', '8', '--dump', '--timings', trace_path]
+        res = subprocess.run(args, cwd=cwd, env=env, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+        returned = b''
+        while True:
+            try:
+                data = os.read(read_fd, 64)
+            except BlockingIOError:
+                break
+            if not data:
+                break
+            returned += data
+        os.close(read_fd)
+        os.close(write_fd)
+        os.remove(fifo_path)
+        if res.returncode != 0 or 'jobserver: true' not in res.stderr:
+            log.error('jobserver was not used')
+            continue
+        if sorted(returned) != sorted(tokens):
+            log.error(f'jobserver: tokens {tokens} in the fifo before, {returned} after the run')
+        busy = max_busy_tracks(trace_path)
+        if busy > num_tokens + 1:
+            log.error(f'jobserver: {busy} threads working at the same time with {num_tokens} tokens')
+
+# compile a shader with --timings, the trace file must contain the main pipeline
+# stages and thread name metadata for each track
+timings_stages = ['load_and_preprocess', 'parse', 'glslang_parse', 'spirv_optimize', 'to_glsl', 'to_wgsl', 'reflection_build', 'gen_shader_arrays', 'write_file']
+def run_timings_test(fips_dir, proj_dir, cfg_name, out_path, shader_filename):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    trace_path = f'{out_path}/{shader_filename}.trace.json'
+    log.info(f'==> {shader_filename} (timings):')
+    args = [ '-i', shader_filename, '-o', f'{out_path}/{shader_filename}.timings.h', '-l', 'glsl430:wgsl', '--timings', trace_path ]
+    exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args, cwd)
+    if exit_code != 0:
+        sys.exit(exit_code)
+    with open(trace_path, 'r') as f:
+        events = json.load(f)['traceEvents']
+    names = set(ev['name'] for ev in events if ev['ph'] == 'X')
+    for stage in timings_stages:
+        if stage not in names:
+            log.error(f'timings: stage {stage} missing in {trace_path}')
+    tracks = set(ev['tid'] for ev in events if ev['ph'] == 'X')
+    named_tracks = set(ev['tid'] for ev in events if ev['ph'] == 'M' and ev['name'] == 'thread_name')
+    if not tracks.issubset(named_tracks):
+        log.error(f'timings: unnamed tracks in {trace_path}')
+
+# profile the SPIRV optimizer for all batch jobs, the report must contain one entry
+# per optimizer pass, with the runs of all profiled snippets, each snippet must be
+# profiled for every target language of the batch manifest, also with a warm cache
+spirv_opt_profile_slangs = [ 'glsl300es', 'glsl430', 'hlsl4', 'metal_macos', 'metal_ios', 'metal_sim' ]
+def run_spirv_opt_profile_test(fips_dir, proj_dir, cfg_name, out_path):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    cache_dir = f'{out_path}/spirv_opt_profile_cache'
+    if os.path.isdir(cache_dir):
+        shutil.rmtree(cache_dir)
+    log.info('==> spirv optimizer profile:')
+    reports = []
+    for run in ['cold', 'warm']:
+        report_path = f'{out_path}/spirv_opt_profile.{run}.json'
+        exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', [ '--batch', f'{out_path}/batch/manifest.txt', '--cache-dir', cache_dir, '--spirv-opt-profile', report_path ], cwd)
+        if exit_code != 0:
+            sys.exit(exit_code)
+        with open(report_path, 'r') as f:
+            report = json.load(f)
+        reports.append(report)
+        if len(report['modules']) == 0 or len(report['passes']) == 0:
+            log.error(f'spirv optimizer profile: empty report {report_path}')
+        for module in report['modules']:
+            if [run['name'] for run in module['passes']] != [p['name'] for p in report['passes']]:
+                log.error(f'spirv optimizer profile: unexpected passes for {module["snippet"]} in {module["file"]}')
+        for p in report['passes']:
+            if p['runs'] != len(report['modules']):
+                log.error(f'spirv optimizer profile: pass {p["name"]} ran {p["runs"]} times for {len(report["modules"])} modules')
+        slangs = {}
+        for module in report['modules']:
+            slangs.setdefault((module['file'], module['snippet']), []).append(module['slang'])
+        for (file, snippet), snippet_slangs in slangs.items():
+            if sorted(snippet_slangs) != sorted(spirv_opt_profile_slangs):
+                log.error(f'spirv optimizer profile: {snippet} in {file} profiled for {snippet_slangs}')
+    if len(reports[0]['modules']) != len(reports[1]['modules']):
+        log.error(f'spirv optimizer profile: {len(reports[0]["modules"])} modules without cache, {len(reports[1]["modules"])} with a warm cache')
+
+# the synthetic shader module generator in scripts/gen-synthetic-module.py
+def load_synthetic_module_generator(proj_dir):
+    spec = importlib.util.spec_from_file_location('gen_synthetic_module', f'{proj_dir}/scripts/gen-synthetic-module.py')
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+# compile a small and a large synthetic module with --mem-stats, the growth of the heap
+# size between the small and large module is compared against the growth of the SPIRV
+# bytecode (the .spv files written by --save-intermediate-spirv in a separate run):
+# - compile_glsl may only leave the SPIRV blobs behind (no merged sources, no spare
+#   vector capacity, no per-task garbage)
+# - the SPIRV blobs must be released between translation and reflection merging, so
+#   that they are not alive anymore during code generation
+# the constant heap usage (glslang tables, input buffers) cancels out in the difference
+peak_memory_slangs = 'glsl430:glsl300es:hlsl5:metal_macos:metal_ios:metal_sim:wgsl'
+peak_memory_max_retained_factor = 1.3
+peak_memory_min_released_factor = 0.9
+def run_peak_memory_test(fips_dir, proj_dir, cfg_name, out_path):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    synthetic = load_synthetic_module_generator(proj_dir)
+    def measure(num_pairs):
+        shader_path = f'{out_path}/peak_memory_{num_pairs}.glsl'
+        spirv_dir = f'{out_path}/peak_memory_{num_pairs}_spirv'
+        report_path = f'{shader_path}.json'
+        synthetic.write_module(shader_path, num_pairs)
+        if os.path.isdir(spirv_dir):
+            shutil.rmtree(spirv_dir)
+        os.makedirs(spirv_dir)
+        args = [ '-i', shader_path, '-o', f'{shader_path}.h', '-l', peak_memory_slangs, '--jobs', '1' ]
+        exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args + [ '-t', spirv_dir, '--save-intermediate-spirv' ], cwd)
+        if exit_code == 0:
+            exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args + [ '--mem-stats', report_path ], cwd)
+        if exit_code != 0:
+            sys.exit(exit_code)
+        spirv_bytes = sum(os.path.getsize(f'{spirv_dir}/{name}') for name in os.listdir(spirv_dir) if name.endswith('.spv'))
+        with open(report_path, 'r') as f:
+            stages = { stage['name']: stage for stage in json.load(f)['stages'] }
+        retained = stages['translate']['entry_bytes'] - stages['compile_glsl']['entry_bytes']
+        released = stages['translate']['exit_bytes'] - stages['reflection']['entry_bytes']
+        return spirv_bytes, retained, released
+    log.info('==> peak memory:')
+    small_spirv, small_retained, small_released = measure(32)
+    big_spirv, big_retained, big_released = measure(256)
+    spirv = big_spirv - small_spirv
+    retained = big_retained - small_retained
+    released = big_released - small_released
+    log.info(f'    {spirv // 1024} KB more SPIRV: {retained // 1024} KB more retained after compile_glsl, {released // 1024} KB more released before reflection')
+    if retained > peak_memory_max_retained_factor * spirv:
+        log.error(f'peak memory: compile_glsl retains {retained // 1024} KB more for {spirv // 1024} KB more SPIRV')
+    if released < peak_memory_min_released_factor * spirv:
+        log.error(f'peak memory: only {released // 1024} KB more released before reflection for {spirv // 1024} KB more SPIRV')
+
+# compile synthetic modules at a small and an 8x larger size along one parameter at a
+# time, the time of the input parsing, bindings merging, error checking and code
+# generation stages (from the --timings trace) may only grow by a constant factor
+# of the size growth, stages below the noise floor are not checked
+scaling_base = { 'num_pairs': 64, 'num_uniform_blocks': 16, 'num_images': 16, 'num_includes': 4 }
+scaling_sweeps = [
+    ('snippets', 'num_pairs', 64, 512),
+    ('uniform blocks', 'num_uniform_blocks', 8, 64),
+    ('images', 'num_images', 16, 128),
+    ('includes', 'num_includes', 4, 32),
+]
+scaling_stages = {
+    'input': [ 'load_and_preprocess', 'parse' ],
+    'merge_bindings': [ 'merge_bindings' ],
+    'check_errors': [ 'check_errors' ],
+    'generate': [ 'generate' ],
+}
+scaling_tolerance = 3
+scaling_min_us = 2000
+def run_scaling_test(fips_dir, proj_dir, cfg_name, out_path):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    scaling_path = f'{out_path}/scaling'
+    if not os.path.isdir(scaling_path):
+        os.makedirs(scaling_path)
+    synthetic = load_synthetic_module_generator(proj_dir)
+    def measure(name, params):
+        shader_path = f'{scaling_path}/{name}.glsl'
+        trace_path = f'{scaling_path}/{name}.trace.json'
+        synthetic.write_module(shader_path, **params)
+        args = [ '-i', shader_path, '-o', f'{shader_path}.h', '-l', 'glsl430', '-r', '--timings', trace_path ]
+        for fmt in [ 'sokol', 'sokol_impl', 'sokol_zig', 'sokol_nim', 'sokol_odin', 'sokol_rust', 'sokol_d', 'sokol_jai', 'bare', 'bare_yaml' ]:
+            args += [ '-f', fmt if fmt == 'sokol' else f'{fmt}={scaling_path}/{name}.{fmt}' ]
+        exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args, cwd)
+        if exit_code != 0:
+            sys.exit(exit_code)
+        with open(trace_path, 'r') as f:
+            events = json.load(f)['traceEvents']
+        return { stage: sum(ev['dur'] for ev in events if ev['ph'] == 'X' and ev['name'] in names) for stage, names in scaling_stages.items() }
+    log.info('==> scaling:')
+    for sweep, param, small, big in scaling_sweeps:
+        small_params = dict(scaling_base, **{ param: small })
+        big_params = dict(scaling_base, **{ param: big })
+        small_us = measure(f'{param}_{small}', small_params)
+        big_us = measure(f'{param}_{big}', big_params)
+        growth = big / small
+        for stage in scaling_stages:
+            log.info(f'    {sweep} {small} => {big}: {stage} {small_us[stage] / 1000.0:.2f} ms => {big_us[stage] / 1000.0:.2f} ms')
+            if big_us[stage] >= scaling_min_us and big_us[stage] > scaling_tolerance * growth * max(small_us[stage], 1):
+                log.error(f'{stage} grows superlinearly with {sweep}: {small_us[stage]} us => {big_us[stage]} us for {growth}x {sweep}')
+
+# count heap allocations per pipeline stage on a synthetic module, all stages of a
+# compilation must show up, and input parsing must not allocate per source line
+mem_stats_stages = [ 'input', 'compile_glsl', 'translate', 'reflection', 'generate' ]
+mem_stats_max_input_allocs_per_line = 1
+def run_mem_stats_test(fips_dir, proj_dir, cfg_name, out_path):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    shader_path = f'{out_path}/mem_stats.glsl'
+    report_path = f'{out_path}/mem_stats.json'
+    synthetic = load_synthetic_module_generator(proj_dir)
+    num_lines = 0
+    for path in synthetic.write_module(shader_path, 64, num_uniform_blocks=16, num_images=16, num_includes=4):
+        with open(path, 'r') as f:
+            num_lines += len(f.read().splitlines())
+    log.info('==> mem stats:')
+    args = [ '-i', shader_path, '-o', f'{shader_path}.h', '-l', 'glsl430', '--mem-stats', report_path ]
+    exit_code = project.run(fips_dir, proj_dir, cfg_name, 'sokol-shdc', args, cwd)
+    if exit_code != 0:
+        sys.exit(exit_code)
+    with open(report_path, 'r') as f:
+        stages = { stage['name']: stage for stage in json.load(f)['stages'] }
+    for name in mem_stats_stages:
+        if name not in stages or stages[name]['allocs'] == 0:
+            log.error(f'mem stats: no allocations in stage {name}')
+    input_allocs = stages['input']['allocs'] if 'input' in stages else 0
+    log.info(f'    input: {input_allocs} allocations for {num_lines} lines')
+    if input_allocs > mem_stats_max_input_allocs_per_line * num_lines:
+        log.error(f'mem stats: {input_allocs} allocations for parsing {num_lines} lines')
+
+# open a shader with a compile error in language server mode, the error must be
+# published as a diagnostic and disappear after the offending line is removed
+def run_lsp_test(fips_dir, proj_dir, cfg_name, shader_filename):
+    cfg_name, cwd, exe_path = test_setup(fips_dir, proj_dir, cfg_name)
+    log.info(f'==> {shader_filename} (lsp):')
+    server = subprocess.Popen([exe_path, '--lsp'], cwd=cwd, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+    def send(msg):
+        body = json.dumps(msg).encode()
+        server.stdin.write(f'Content-Length: {len(body)}\r\n\r\n'.encode() + body)
+        server.stdin.flush()
+    def receive():
+        length = 0
+        while True:
+            line = server.stdout.readline().decode().strip()
+            if line.lower().startswith('content-length:'):
+                length = int(line.split(':')[1])
+            elif line == '' and length > 0:
+                return json.loads(server.stdout.read(length))
+    path = os.path.abspath(f'{cwd}/{shader_filename}')
+    uri = 'file://' + ('/' if not path.startswith('/') else '') + path.replace('\\', '/')
+    with open(path, 'r') as f:
+        lines = f.read().split('\n')
+    fs_line = lines.index('@fs fs') + 1
+    send({ 'jsonrpc': '2.0', 'id': 0, 'method': 'initialize', 'params': {} })
+    receive()
+    send({ 'jsonrpc': '2.0', 'method': 'textDocument/didOpen', 'params': { 'textDocument': { 'uri': uri, 'version': 1, 'text': '\n'.join(lines) }}})
+    if len(receive()['params']['diagnostics']) != 0:
+        log.error(f'unexpected lsp diagnostics for {shader_filename}')
+    edit = { 'range': { 'start': { 'line': fs_line, 'character': 0 }, 'end': { 'line': fs_line, 'character': 0 }}, 'text': 'this is an error;\n' }
+    send({ 'jsonrpc': '2.0', 'method': 'textDocument/didChange', 'params': { 'textDocument': { 'uri': uri, 'version': 2 }, 'contentChanges': [ edit ]}})
+    diags = receive()['params']['diagnostics']
+    if len(diags) == 0 or diags[0]['range']['start']['line'] != fs_line:
+        log.error(f'expected lsp diagnostic in line {fs_line + 1} of {shader_filename}')
+    edit = { 'range': { 'start': { 'line': fs_line, 'character': 0 }, 'end': { 'line': fs_line + 1, 'character': 0 }}, 'text': '' }
+    send({ 'jsonrpc': '2.0', 'method': 'textDocument/didChange', 'params': { 'textDocument': { 'uri': uri, 'version': 3 }, 'contentChanges': [ edit ]}})
+    if len(receive()['params']['diagnostics']) != 0:
+        log.error(f'lsp diagnostics not cleared for {shader_filename}')
+    send({ 'jsonrpc': '2.0', 'id': 1, 'method': 'shutdown' })
+    receive()
+    send({ 'jsonrpc': '2.0', 'method': 'exit' })
+    server.stdin.close()
+    if server.wait() != 0:
+        log.error('language server did not exit cleanly')
+
 def run(fips_dir, proj_dir, args):
+    # 'update-reflection-refs' only records the reflection reference files
+    update_reflection_refs = 'update-reflection-refs' in args
+    args = [arg for arg in args if arg != 'update-reflection-refs']
     cfg_name = None
     if len(args) > 0:
         cfg_name = args[0]
@@ -90,6 +763,33 @@ def run(fips_dir, proj_dir, args):
         os.makedirs(f'{out_path}/sapp')
     for shader in shaders:
         run_sokol_shdc(fips_dir, proj_dir, cfg_name, out_path, shader)
+    for shader in reflection_shaders:
+        run_reflection_test(fips_dir, proj_dir, cfg_name, out_path, shader, update_reflection_refs)
+    if update_reflection_refs:
+        return
+    for shader in cache_shaders:
+        run_cache_test(fips_dir, proj_dir, cfg_name, out_path, shader)
+        run_incremental_test(fips_dir, proj_dir, cfg_name, out_path, shader)
+    for shader in shaders:
+        run_check_test(fips_dir, proj_dir, cfg_name, shader)
+    write_jobs_error_shader(f'{out_path}/jobs_errors.glsl')
+    for shader in shaders + [ 'out/jobs_errors.glsl' ]:
+        run_jobs_test(fips_dir, proj_dir, cfg_name, out_path, shader)
+    run_depfile_test(fips_dir, proj_dir, cfg_name, out_path, 'include_test.glsl')
+    run_multi_format_test(fips_dir, proj_dir, cfg_name, out_path, 'include_test.glsl')
+    run_programs_test(fips_dir, proj_dir, cfg_name, out_path, 'unused_snippets.glsl')
+    run_spirv_input_test(fips_dir, proj_dir, cfg_name, out_path, 'sapp/cube-sapp.glsl')
+    run_stream_test(fips_dir, proj_dir, cfg_name, out_path, 'include_test.glsl', [ 'include_test_inc.glsl' ])
+    run_timings_test(fips_dir, proj_dir, cfg_name, out_path, 'sapp/cube-sapp.glsl')
+    run_batch_test(fips_dir, proj_dir, cfg_name, out_path)
+    run_jobserver_test(fips_dir, proj_dir, cfg_name, out_path)
+    run_spirv_opt_profile_test(fips_dir, proj_dir, cfg_name, out_path)
+    run_server_test(fips_dir, proj_dir, cfg_name, out_path)
+    run_peak_memory_test(fips_dir, proj_dir, cfg_name, out_path)
+    run_scaling_test(fips_dir, proj_dir, cfg_name, out_path)
+    run_mem_stats_test(fips_dir, proj_dir, cfg_name, out_path)
+    run_lsp_test(fips_dir, proj_dir, cfg_name, 'include_test.glsl')
 
 def help():
-    log.info(log.YELLOW + 'fips run_tests [cfg]\n' + log.DEF + '    run shader compilation tests')
+    log.info(log.YELLOW + 'fips run_tests [cfg]\n' + log.DEF + '    run shader compilation tests\n' +
+             log.YELLOW + 'fips run_tests [cfg] update-reflection-refs\n' + log.DEF + '    record the reflection reference files in test/reflection')
@@ -0,0 +1,119 @@
+'''
+    Generate a synthetic annotated-GLSL shader module for stress tests
+    and benchmarks.
+
+    The module has a configurable number of @vs/@fs snippet pairs, @programs,
+    uniform blocks, textures and @include files:
+
+    - each vertex shader uses one of the uniform blocks, each fragment shader
+      samples one group of textures (so that a texture always has the same
+      bind slot), uniform blocks and texture groups are shared between snippets
+    - uniform blocks, texture groups, the sampler and a common helper function
+      are defined in @blocks and pulled into the snippets with @include_block
+    - with includes, the @blocks are distributed over @include files which
+      form a binary tree below the module file
+
+    Usage (NOTE: run with python3):
+
+        python3 gen-synthetic-module.py --pairs 256 --images 64 --includes 16 out/synthetic.glsl
+
+    Other scripts import the write_module() function.
+'''
+import argparse, os
+
+# write the module to 'path' (@include files are written next to it),
+# and return the paths of all written files
+def write_module(path, num_pairs, num_programs=None, num_uniform_blocks=None, num_images=0, images_per_snippet=4, num_includes=0):
+    if num_programs is None:
+        num_programs = num_pairs
+    if num_uniform_blocks is None:
+        num_uniform_blocks = num_pairs
+    num_uniform_blocks = max(1, min(num_uniform_blocks, num_pairs))
+    images_per_snippet = max(1, min(images_per_snippet, 12))
+    num_image_groups = (num_images + images_per_snippet - 1) // images_per_snippet
+
+    # the @block definitions
+    blocks = []
+    blocks.append(('common', [
+        'vec4 scale_color(vec4 c, float f) {',
+        '    return vec4(c.rgb * f, c.a);',
+        '}',
+    ]))
+    for i in range(num_uniform_blocks):
+        blocks.append((f'vs_params_{i}', [
+            f'uniform vs_params_{i} {{',
+            '    mat4 mvp;',
+            '    vec4 offset;',
+            '};',
+        ]))
+    if num_images > 0:
+        blocks.append(('sampler', [ 'uniform sampler smp;' ]))
+    image_groups = []
+    for g in range(num_image_groups):
+        images = [f'tex_{i}' for i in range(g * images_per_snippet, min((g + 1) * images_per_snippet, num_images))]
+        image_groups.append(images)
+        blocks.append((f'images_{g}', [f'uniform texture2D {img};' for img in images]))
+
+    # distribute the @blocks round-robin over the @include files
+    base, _ = os.path.splitext(path)
+    include_paths = [f'{base}_inc_{i}.glsl' for i in range(num_includes)]
+    file_blocks = [[] for _ in range(max(1, num_includes))]
+    for i, block in enumerate(blocks):
+        file_blocks[i % len(file_blocks)].append(block)
+
+    def write_blocks(f, blocks):
+        for name, lines in blocks:
+            f.write(f'@block {name}\n')
+            for line in lines:
+                f.write(f'{line}\n')
+            f.write('@end\n\n')
+
+    written = []
+    for i, include_path in enumerate(include_paths):
+        with open(include_path, 'w') as f:
+            for child in (2 * i + 1, 2 * i + 2):
+                if child < num_includes:
+                    f.write(f'@include {os.path.basename(include_paths[child])}\n')
+            f.write('\n')
+            write_blocks(f, file_blocks[i])
+        written.append(include_path)
+
+    with open(path, 'w') as f:
+        if num_includes > 0:
+            f.write(f'@include {os.path.basename(include_paths[0])}\n\n')
+        else:
+            write_blocks(f, file_blocks[0])
+        for i in range(num_pairs):
+            f.write(f'@vs vs_{i}\n')
+            f.write('@include_block common\n')
+            f.write(f'@include_block vs_params_{i % num_uniform_blocks}\n')
+            f.write('in vec4 position;\nin vec4 color0;\nout vec4 color;\n')
+            f.write(f'void main() {{\n    gl_Position = mvp * (position + offset * {i}.0);\n    color = scale_color(color0, 0.5);\n}}\n@end\n\n')
+            f.write(f'@fs fs_{i}\n')
+            f.write('@include_block common\n')
+            images = image_groups[i % num_image_groups] if num_image_groups > 0 else []
+            if images:
+                f.write('@include_block sampler\n')
+                f.write(f'@include_block images_{i % num_image_groups}\n')
+            f.write('in vec4 color;\nout vec4 frag_color;\n')
+            f.write(f'void main() {{\n    frag_color = scale_color(color, {i + 1}.0 / {num_pairs}.0);\n')
+            for img in images:
+                f.write(f'    frag_color += texture(sampler2D({img}, smp), color.xy);\n')
+            f.write('}\n@end\n\n')
+        for i in range(min(num_programs, num_pairs)):
+            f.write(f'@program prog_{i} vs_{i} fs_{i}\n')
+    written.append(path)
+    return written
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='generate a synthetic annotated-GLSL shader module')
+    parser.add_argument('output', help='path of the generated module file')
+    parser.add_argument('--pairs', type=int, default=64, help='number of @vs/@fs snippet pairs')
+    parser.add_argument('--programs', type=int, default=None, help='number of @programs (default: one per snippet pair)')
+    parser.add_argument('--uniform-blocks', type=int, default=None, help='number of distinct uniform blocks (default: one per snippet pair)')
+    parser.add_argument('--images', type=int, default=0, help='number of distinct textures')
+    parser.add_argument('--images-per-snippet', type=int, default=4, help='max number of textures per fragment shader (1..12)')
+    parser.add_argument('--includes', type=int, default=0, help='number of @include files')
+    args = parser.parse_args()
+    for path in write_module(args.output, args.pairs, args.programs, args.uniform_blocks, args.images, args.images_per_snippet, args.includes):
+        print(path)
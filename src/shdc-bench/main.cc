@@ -0,0 +1,533 @@
+/*
+    sokol-shdc-bench: end-to-end benchmark of the sokol-shdc pipeline.
+
+    Compiles every .glsl file in test/sapp and test in-process through
+    the libshdc compile API (see shdc.h) for all shader languages and output
+    formats, and reports per-file and aggregate throughput, the time spent
+    in each pipeline stage (see timings.h), the peak memory usage and the
+    heap allocations per file (see memstats.h).
+
+    The results are compared against a baseline JSON file: a file which got
+    slower, an aggregate throughput which dropped, or a peak memory usage
+    which grew by more than the configured thresholds is reported as a
+    regression and the exit code is non-zero. The machine-independent
+    results (snippets, generated bytes and allocations per file) are
+    compared even if the baseline has no timings: a changed number of
+    snippets or generated bytes, or an allocation count which grew by more
+    than the threshold is a regression too. A baseline without per-file
+    results is an error. Thresholds are read from the baseline file and can
+    be overridden on the command line, a new baseline is recorded with
+    --update-baseline.
+*/
+#include "shdc.h"
+#include "json.h"
+#include "output.h"
+#include "timings.h"
+#include "memstats.h"
+#include "memstats_new.h"
+#include "types/format.h"
+#include "fmt/format.h"
+#include "getopt/getopt.h"
+#include "pystring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <vector>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace shdc;
+namespace fs = std::filesystem;
+
+// shader languages which can't be combined in one compilation (hlsl4/hlsl5 and
+// glsl410/glsl430) are compiled in separate runs
+static const char* slang_groups[] = {
+    "glsl430:glsl300es:hlsl5:metal_macos:metal_ios:metal_sim:wgsl",
+    "glsl410:hlsl4",
+};
+static const int num_slang_groups = sizeof(slang_groups) / sizeof(slang_groups[0]);
+
+// regression thresholds in percent
+struct Thresholds {
+    double time = 10.0;         // per-file compile time increase
+    double throughput = 10.0;   // aggregate snippets/s and bytes/s decrease
+    double memory = 20.0;       // peak memory increase
+    double allocs = 10.0;       // per-file heap allocation count increase
+    double min_time_ms = 2.0;   // per-file time differences below this are noise
+};
+
+struct BenchArgs {
+    bool valid = true;
+    int exit_code = 10;
+    std::string dir = "test";
+    std::string baseline;       // default: [dir]/bench-baseline.json
+    std::string json;
+    bool update_baseline = false;
+    int iterations = 3;
+    int num_jobs = 1;
+    Thresholds thresholds;
+    bool time_threshold_set = false;
+    bool throughput_threshold_set = false;
+    bool memory_threshold_set = false;
+    bool allocs_threshold_set = false;
+};
+
+struct FileResult {
+    std::string name;           // path relative to the test directory
+    bool valid = false;
+    std::string error;
+    int num_snippets = 0;       // snippet x shader language compilations
+    uint64_t num_bytes = 0;     // generated bytes over all output formats
+    uint64_t num_allocs = 0;    // heap allocations of the last iteration (0 on WASI)
+    double time_ms = 0.0;       // best of all iterations
+};
+
+struct BenchResult {
+    std::vector<FileResult> files;
+    double time_ms = 0.0;
+    int num_snippets = 0;
+    uint64_t num_bytes = 0;
+    uint64_t num_allocs = 0;
+    double snippets_per_sec = 0.0;
+    double bytes_per_sec = 0.0;
+    uint64_t peak_memory = 0;
+    std::vector<Timings::Stage> stages;     // summed over all iterations
+};
+
+enum {
+    OPTION_HELP = 1,
+    OPTION_DIR,
+    OPTION_ITERATIONS,
+    OPTION_JOBS,
+    OPTION_BASELINE,
+    OPTION_UPDATE_BASELINE,
+    OPTION_JSON,
+    OPTION_TIME_THRESHOLD,
+    OPTION_THROUGHPUT_THRESHOLD,
+    OPTION_MEMORY_THRESHOLD,
+    OPTION_ALLOCS_THRESHOLD,
+};
+
+static const getopt_option_t option_list[] = {
+    { "help",                   'h', GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_HELP,         "print this help text", 0},
+    { "dir",                    'd', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_DIR,          "test directory with the .glsl files and a sapp/ subdirectory (default: test)", "[dir]" },
+    { "iterations",             'n', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_ITERATIONS,   "compile each file n times and keep the fastest run (default: 3)", "[int]" },
+    { "jobs",                   'j', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_JOBS,         "number of parallel compile jobs per file (default: 1)", "[int]" },
+    { "baseline",               0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_BASELINE,     "baseline results (default: [dir]/bench-baseline.json)", "[path]" },
+    { "update-baseline",        0,   GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_UPDATE_BASELINE, "write the results to the baseline file instead of comparing" },
+    { "json",                   0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_JSON,         "also write the results to a JSON file", "[path]" },
+    { "time-threshold",         0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_TIME_THRESHOLD, "max per-file compile time increase in percent", "[percent]" },
+    { "throughput-threshold",   0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_THROUGHPUT_THRESHOLD, "max aggregate throughput decrease in percent", "[percent]" },
+    { "memory-threshold",       0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_MEMORY_THRESHOLD, "max peak memory increase in percent", "[percent]" },
+    { "allocs-threshold",       0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_ALLOCS_THRESHOLD, "max per-file heap allocation count increase in percent", "[percent]" },
+    GETOPT_OPTIONS_END
+};
+
+static BenchArgs parse_args(int argc, const char** argv) {
+    BenchArgs args;
+    getopt_context_t ctx;
+    if (getopt_create_context(&ctx, argc, argv, option_list) < 0) {
+        fmt::print(stderr, "error in getopt_create_context()\n");
+        args.valid = false;
+        return args;
+    }
+    int opt = 0;
+    while ((opt = getopt_next(&ctx)) != -1) {
+        switch (opt) {
+            case '+':
+                fmt::print(stderr, "sokol-shdc-bench: got argument without flag: {}\n", ctx.current_opt_arg);
+                args.valid = false;
+                return args;
+            case '?':
+                fmt::print(stderr, "sokol-shdc-bench: unknown flag {}\n", ctx.current_opt_arg);
+                args.valid = false;
+                return args;
+            case '!':
+                fmt::print(stderr, "sokol-shdc-bench: invalid use of flag {}\n", ctx.current_opt_arg);
+                args.valid = false;
+                return args;
+            case OPTION_DIR:
+                args.dir = ctx.current_opt_arg;
+                break;
+            case OPTION_ITERATIONS:
+                args.iterations = std::max(1, atoi(ctx.current_opt_arg));
+                break;
+            case OPTION_JOBS:
+                args.num_jobs = std::max(0, atoi(ctx.current_opt_arg));
+                break;
+            case OPTION_BASELINE:
+                args.baseline = ctx.current_opt_arg;
+                break;
+            case OPTION_UPDATE_BASELINE:
+                args.update_baseline = true;
+                break;
+            case OPTION_JSON:
+                args.json = ctx.current_opt_arg;
+                break;
+            case OPTION_TIME_THRESHOLD:
+                args.thresholds.time = atof(ctx.current_opt_arg);
+                args.time_threshold_set = true;
+                break;
+            case OPTION_THROUGHPUT_THRESHOLD:
+                args.thresholds.throughput = atof(ctx.current_opt_arg);
+                args.throughput_threshold_set = true;
+                break;
+            case OPTION_MEMORY_THRESHOLD:
+                args.thresholds.memory = atof(ctx.current_opt_arg);
+                args.memory_threshold_set = true;
+                break;
+            case OPTION_ALLOCS_THRESHOLD:
+                args.thresholds.allocs = atof(ctx.current_opt_arg);
+                args.allocs_threshold_set = true;
+                break;
+            case OPTION_HELP: {
+                fmt::print(stderr,
+                    "End-to-end benchmark of the sokol-shdc pipeline over the test shaders\n\n"
+                    "Usage: sokol-shdc-bench [options]\n\n"
+                    "Compiles all [dir]/sapp/*.glsl and [dir]/*.glsl files in-process for all shader\n"
+                    "languages and output formats, and compares the results against a baseline.\n\n"
+                    "Options:\n\n");
+                char buf[4096];
+                fmt::print(stderr, "{}", getopt_create_help_string(&ctx, buf, sizeof(buf)));
+                args.valid = false;
+                args.exit_code = 0;
+                return args;
+            }
+            default:
+                break;
+        }
+    }
+    if (args.baseline.empty()) {
+        args.baseline = args.dir + "/bench-baseline.json";
+    }
+    return args;
+}
+
+static uint64_t peak_memory_bytes() {
+    #if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+    #else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // ru_maxrss is in bytes on macOS and in kilobytes everywhere else
+    #if defined(__APPLE__)
+    return (uint64_t)usage.ru_maxrss;
+    #else
+    return (uint64_t)usage.ru_maxrss * 1024;
+    #endif
+    #endif
+}
+
+// all .glsl files in [dir]/sapp and [dir], relative to dir, sorted by name
+static std::vector<std::string> find_shaders(const std::string& dir) {
+    std::vector<std::string> res;
+    for (const char* subdir: { "sapp/", "" }) {
+        std::vector<std::string> names;
+        std::error_code ec;
+        for (const fs::directory_entry& entry: fs::directory_iterator(dir + "/" + subdir, ec)) {
+            if (entry.is_regular_file() && (entry.path().extension() == ".glsl")) {
+                names.push_back(subdir + entry.path().filename().string());
+            }
+        }
+        std::sort(names.begin(), names.end());
+        res.insert(res.end(), names.begin(), names.end());
+    }
+    return res;
+}
+
+// compile one file for all shader languages and output formats
+static FileResult bench_file(const BenchArgs& args, const std::string& name) {
+    FileResult res;
+    res.name = name;
+    for (int iter = 0; iter < args.iterations; iter++) {
+        int num_snippets = 0;
+        uint64_t num_bytes = 0;
+        const uint64_t num_allocs = MemStats::total_allocs();
+        const auto start = std::chrono::steady_clock::now();
+        for (int group = 0; group < num_slang_groups; group++) {
+            CompileDesc desc;
+            desc.args = { "-i", args.dir + "/" + name, "-o", "bench.h", "-l", slang_groups[group], "-r", "--jobs", fmt::format("{}", args.num_jobs) };
+            for (int i = 0; i < Format::NUM; i++) {
+                const char* format = Format::to_str((Format::Enum)i);
+                desc.args.push_back("-f");
+                desc.args.push_back((i == 0) ? std::string(format) : fmt::format("{}=bench.{}", format, format));
+            }
+            const CompileResult compiled = Compiler::compile(desc);
+            if (compiled.exit_code != 0) {
+                res.error = compiled.messages.empty() ? std::string("compilation failed") : compiled.messages[0].as_string(compiled.error_format);
+                return res;
+            }
+            std::set<std::string> snippets;
+            for (const refl::ProgramReflection& prog: compiled.programs) {
+                snippets.insert(prog.vs_name());
+                snippets.insert(prog.fs_name());
+            }
+            int num_slangs = 1;
+            for (const char* c = slang_groups[group]; *c; c++) {
+                num_slangs += (*c == ':') ? 1 : 0;
+            }
+            num_snippets += (int)snippets.size() * num_slangs;
+            for (const OutputFile& file: compiled.files) {
+                num_bytes += file.content.size();
+            }
+        }
+        const double time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (!res.valid || (time_ms < res.time_ms)) {
+            res.time_ms = time_ms;
+        }
+        res.valid = true;
+        res.num_snippets = num_snippets;
+        res.num_bytes = num_bytes;
+        res.num_allocs = MemStats::total_allocs() - num_allocs;
+    }
+    return res;
+}
+
+static bool read_file(const std::string& path, std::string& out_data) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    const long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    bool res = false;
+    if (file_size > 0) {
+        out_data.resize((size_t)file_size);
+        res = (fread(&out_data[0], 1, (size_t)file_size, fp) == (size_t)file_size);
+    }
+    fclose(fp);
+    return res;
+}
+
+static double json_number(const Json* obj, const std::string& key, double default_val) {
+    const Json* val = obj ? obj->find(key) : nullptr;
+    return (val && val->is_number()) ? val->number : default_val;
+}
+
+static Json result_to_json(const BenchResult& res, const Thresholds& thresholds) {
+    Json out = Json::make_object();
+    Json& thr = out.set("thresholds", Json::make_object());
+    thr.set("time", Json::make_number(thresholds.time));
+    thr.set("throughput", Json::make_number(thresholds.throughput));
+    thr.set("memory", Json::make_number(thresholds.memory));
+    thr.set("allocs", Json::make_number(thresholds.allocs));
+    thr.set("min_time_ms", Json::make_number(thresholds.min_time_ms));
+    Json& total = out.set("total", Json::make_object());
+    total.set("time_ms", Json::make_number(res.time_ms));
+    total.set("snippets", Json::make_number(res.num_snippets));
+    total.set("bytes", Json::make_number((double)res.num_bytes));
+    total.set("allocs", Json::make_number((double)res.num_allocs));
+    total.set("snippets_per_sec", Json::make_number(res.snippets_per_sec));
+    total.set("bytes_per_sec", Json::make_number(res.bytes_per_sec));
+    total.set("peak_memory", Json::make_number((double)res.peak_memory));
+    Json& files = out.set("files", Json::make_object());
+    for (const FileResult& file: res.files) {
+        if (file.valid) {
+            Json& item = files.set(file.name, Json::make_object());
+            item.set("time_ms", Json::make_number(file.time_ms));
+            item.set("snippets", Json::make_number(file.num_snippets));
+            item.set("bytes", Json::make_number((double)file.num_bytes));
+            item.set("allocs", Json::make_number((double)file.num_allocs));
+        }
+    }
+    Json& stages = out.set("stages", Json::make_object());
+    for (const Timings::Stage& stage: res.stages) {
+        stages.set(stage.name, Json::make_number(stage.total_us / 1000.0));
+    }
+    return out;
+}
+
+// compare the results against a baseline, returns the number of regressions
+static int compare(const BenchResult& res, const Json& baseline, const Thresholds& thr) {
+    int num_regressions = 0;
+    const auto regression = [&num_regressions](const std::string& what, double base, double cur, const char* unit) {
+        fmt::print("  REGRESSION {}: {:.2f} {} => {:.2f} {} ({:+.1f}%)\n", what, base, unit, cur, unit, (cur - base) / base * 100.0);
+        num_regressions++;
+    };
+    const auto changed = [&num_regressions](const std::string& what, double base, double cur) {
+        fmt::print("  CHANGED {}: {:.0f} => {:.0f} (record a new baseline after an intended change)\n", what, base, cur);
+        num_regressions++;
+    };
+    // snippets, generated bytes and allocations don't depend on the machine
+    const Json* files = baseline.find("files");
+    for (const FileResult& file: res.files) {
+        if (!file.valid) {
+            continue;
+        }
+        const Json* base_file = files ? files->find(file.name) : nullptr;
+        if (!base_file) {
+            fmt::print("  MISSING {}: not in baseline (record a new baseline with --update-baseline)\n", file.name);
+            num_regressions++;
+            continue;
+        }
+        const double base_snippets = json_number(base_file, "snippets", 0.0);
+        if (base_snippets != file.num_snippets) {
+            changed(file.name + " snippets", base_snippets, file.num_snippets);
+        }
+        const double base_bytes = json_number(base_file, "bytes", 0.0);
+        if (base_bytes != (double)file.num_bytes) {
+            changed(file.name + " bytes", base_bytes, (double)file.num_bytes);
+        }
+        // allocations aren't counted on WASI
+        const double base_allocs = json_number(base_file, "allocs", 0.0);
+        if ((base_allocs > 0.0) && (file.num_allocs > 0) && (file.num_allocs > base_allocs * (1.0 + thr.allocs / 100.0))) {
+            regression(file.name + " allocs", base_allocs, (double)file.num_allocs, "allocs");
+        }
+        // timings are optional, e.g. in a baseline which was recorded on another machine
+        const double base_ms = json_number(base_file, "time_ms", 0.0);
+        if ((base_ms > 0.0) && ((file.time_ms - base_ms) > thr.min_time_ms) && (file.time_ms > base_ms * (1.0 + thr.time / 100.0))) {
+            regression(file.name, base_ms, file.time_ms, "ms");
+        }
+    }
+    const Json* total = baseline.find("total");
+    const double base_snippets_per_sec = json_number(total, "snippets_per_sec", 0.0);
+    if ((base_snippets_per_sec > 0.0) && (res.snippets_per_sec < base_snippets_per_sec * (1.0 - thr.throughput / 100.0))) {
+        regression("snippets/s", base_snippets_per_sec, res.snippets_per_sec, "snippets/s");
+    }
+    const double base_bytes_per_sec = json_number(total, "bytes_per_sec", 0.0);
+    if ((base_bytes_per_sec > 0.0) && (res.bytes_per_sec < base_bytes_per_sec * (1.0 - thr.throughput / 100.0))) {
+        regression("bytes/s", base_bytes_per_sec / 1024.0, res.bytes_per_sec / 1024.0, "KB/s");
+    }
+    const double base_peak_memory = json_number(total, "peak_memory", 0.0);
+    if ((base_peak_memory > 0.0) && (res.peak_memory > base_peak_memory * (1.0 + thr.memory / 100.0))) {
+        regression("peak memory", base_peak_memory / (1024.0 * 1024.0), res.peak_memory / (1024.0 * 1024.0), "MB");
+    }
+    return num_regressions;
+}
+
+int main(int argc, const char** argv) {
+    BenchArgs args = parse_args(argc, argv);
+    if (!args.valid) {
+        return args.exit_code;
+    }
+
+    // the baseline provides the default thresholds, cmdline args take precedence
+    Json baseline;
+    std::string baseline_data;
+    if (read_file(args.baseline, baseline_data)) {
+        std::string parse_error;
+        baseline = Json::parse(baseline_data, parse_error);
+        if (!parse_error.empty()) {
+            fmt::print(stderr, "sokol-shdc-bench: {}: {}\n", args.baseline, parse_error);
+            return 10;
+        }
+    }
+    const Json* thresholds = baseline.find("thresholds");
+    if (!args.time_threshold_set) {
+        args.thresholds.time = json_number(thresholds, "time", args.thresholds.time);
+    }
+    if (!args.throughput_threshold_set) {
+        args.thresholds.throughput = json_number(thresholds, "throughput", args.thresholds.throughput);
+    }
+    if (!args.memory_threshold_set) {
+        args.thresholds.memory = json_number(thresholds, "memory", args.thresholds.memory);
+    }
+    if (!args.allocs_threshold_set) {
+        args.thresholds.allocs = json_number(thresholds, "allocs", args.thresholds.allocs);
+    }
+    args.thresholds.min_time_ms = json_number(thresholds, "min_time_ms", args.thresholds.min_time_ms);
+
+    const std::vector<std::string> shaders = find_shaders(args.dir);
+    if (shaders.empty()) {
+        fmt::print(stderr, "sokol-shdc-bench: no .glsl files found in '{}'\n", args.dir);
+        return 10;
+    }
+
+    Compiler::setup();
+    Timings::enable();
+    MemStats::enable();
+    BenchResult res;
+    fmt::print("==> sokol-shdc-bench ({} files, best of {}, --jobs {}):\n", shaders.size(), args.iterations, args.num_jobs);
+    fmt::print("  {:<40} {:>10} {:>10} {:>10} {:>12} {:>12} {:>12}\n", "file", "snippets", "KB", "allocs", "ms", "snippets/s", "KB/s");
+    for (const std::string& shader: shaders) {
+        FileResult file = bench_file(args, shader);
+        if (file.valid) {
+            fmt::print("  {:<40} {:>10} {:>10.1f} {:>10} {:>12.2f} {:>12.0f} {:>12.0f}\n",
+                file.name,
+                file.num_snippets,
+                file.num_bytes / 1024.0,
+                file.num_allocs,
+                file.time_ms,
+                file.num_snippets / (file.time_ms / 1000.0),
+                file.num_bytes / 1024.0 / (file.time_ms / 1000.0));
+            res.time_ms += file.time_ms;
+            res.num_snippets += file.num_snippets;
+            res.num_bytes += file.num_bytes;
+            res.num_allocs += file.num_allocs;
+        } else {
+            // e.g. @include-only files, or shaders which are expected to fail
+            fmt::print("  {:<40} skipped: {}\n", file.name, pystring::strip(file.error));
+        }
+        res.files.push_back(std::move(file));
+    }
+    res.snippets_per_sec = (res.time_ms > 0.0) ? res.num_snippets / (res.time_ms / 1000.0) : 0.0;
+    res.bytes_per_sec = (res.time_ms > 0.0) ? res.num_bytes / (res.time_ms / 1000.0) : 0.0;
+    res.peak_memory = peak_memory_bytes();
+    res.stages = Timings::stage_totals();
+    Compiler::shutdown();
+
+    fmt::print("  {:<40} {:>10} {:>10.1f} {:>10} {:>12.2f} {:>12.0f} {:>12.0f}\n",
+        "total",
+        res.num_snippets,
+        res.num_bytes / 1024.0,
+        res.num_allocs,
+        res.time_ms,
+        res.snippets_per_sec,
+        res.bytes_per_sec / 1024.0);
+    fmt::print("  peak memory: {:.1f} MB\n\n", res.peak_memory / (1024.0 * 1024.0));
+
+    // nested stages are included in their parent stage (e.g. glslang_parse in compile_glsl)
+    fmt::print("==> stages (all iterations):\n");
+    fmt::print("  {:<40} {:>10} {:>12}\n", "stage", "count", "ms");
+    for (const Timings::Stage& stage: res.stages) {
+        fmt::print("  {:<40} {:>10} {:>12.2f}\n", stage.name, stage.count, stage.total_us / 1000.0);
+    }
+    fmt::print("\n");
+
+    const Json results = result_to_json(res, args.thresholds);
+    if (!args.json.empty() && !Output::write_atomic(args.json, results.dump() + "\n")) {
+        fmt::print(stderr, "sokol-shdc-bench: failed to write '{}'\n", args.json);
+        return 10;
+    }
+    if (args.update_baseline) {
+        if (!Output::write_atomic(args.baseline, results.dump() + "\n")) {
+            fmt::print(stderr, "sokol-shdc-bench: failed to write '{}'\n", args.baseline);
+            return 10;
+        }
+        fmt::print("==> baseline written to {}\n", args.baseline);
+        return 0;
+    }
+    // a baseline without results would silently pass, treat it as an error
+    if (!baseline.find("files")) {
+        fmt::print(stderr, "sokol-shdc-bench: ERROR: no baseline results in '{}', record them with --update-baseline\n", args.baseline);
+        return 10;
+    }
+    fmt::print("==> comparing against {} (time: +{}%, throughput: -{}%, memory: +{}%, allocs: +{}%):\n",
+        args.baseline, args.thresholds.time, args.thresholds.throughput, args.thresholds.memory, args.thresholds.allocs);
+    if (!baseline.find("total") || (json_number(baseline.find("total"), "time_ms", 0.0) <= 0.0)) {
+        fmt::print("  no timings in baseline, only comparing snippets, bytes and allocations\n");
+    }
+    const int num_regressions = compare(res, baseline, args.thresholds);
+    if (num_regressions > 0) {
+        fmt::print("==> {} regression(s)\n", num_regressions);
+        return 1;
+    }
+    fmt::print("==> no regressions\n");
+    return 0;
+}
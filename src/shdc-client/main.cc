@@ -0,0 +1,115 @@
+/*
+    sokol-shdc-client: a thin client for the sokol-shdc compile server.
+
+    Takes the same command line args as sokol-shdc, and forwards them to a
+    server started with 'sokol-shdc --server [path]'. The socket path is taken
+    from the SOKOL_SHDC_SOCKET environment variable (default: /tmp/sokol-shdc.sock).
+*/
+#include "args.h"
+#include "json.h"
+#include "fmt/format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <filesystem>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace shdc;
+
+static const char* default_socket_path = "/tmp/sokol-shdc.sock";
+
+static int connect_to_server(const std::string& path) {
+    sockaddr_un addr = { };
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, const char** argv) {
+    // parse args locally so that arg errors and help output work exactly like sokol-shdc
+    const Args args = Args::parse(argc, argv);
+    if (!args.valid) {
+        return args.exit_code;
+    }
+    if (!args.batch.empty() || !args.server.empty()) {
+        fmt::print(stderr, "sokol-shdc-client: --batch and --server are not supported\n");
+        return 10;
+    }
+    const char* env_path = getenv("SOKOL_SHDC_SOCKET");
+    const std::string path = env_path ? env_path : default_socket_path;
+    int fd = connect_to_server(path);
+    if (fd < 0) {
+        fmt::print(stderr, "sokol-shdc-client: failed to connect to sokol-shdc server at '{}'\n", path);
+        return 10;
+    }
+
+    Json cmd_args = Json::make_array();
+    for (int i = 1; i < argc; i++) {
+        cmd_args.push(Json::make_string(argv[i]));
+    }
+    Json params = Json::make_object();
+    params.set("cwd", Json::make_string(std::filesystem::current_path().string()));
+    params.set("args", std::move(cmd_args));
+    Json req = Json::make_object();
+    req.set("jsonrpc", Json::make_string("2.0"));
+    req.set("id", Json::make_number(1));
+    req.set("method", Json::make_string("compile"));
+    req.set("params", std::move(params));
+    const std::string req_str = req.dump() + "\n";
+    size_t pos = 0;
+    while (pos < req_str.size()) {
+        const ssize_t num_bytes = send(fd, req_str.data() + pos, req_str.size() - pos, 0);
+        if (num_bytes <= 0) {
+            fmt::print(stderr, "sokol-shdc-client: failed to send request to '{}'\n", path);
+            close(fd);
+            return 10;
+        }
+        pos += (size_t)num_bytes;
+    }
+
+    // read the response line
+    std::string res_str;
+    char chunk[4096];
+    ssize_t num_bytes;
+    while ((res_str.find('\n') == std::string::npos) && ((num_bytes = recv(fd, chunk, sizeof(chunk), 0)) > 0)) {
+        res_str.append(chunk, (size_t)num_bytes);
+    }
+    close(fd);
+    std::string parse_error;
+    const Json res = Json::parse(res_str.substr(0, res_str.find('\n')), parse_error);
+    if (!parse_error.empty()) {
+        fmt::print(stderr, "sokol-shdc-client: invalid response from server: {}\n", parse_error);
+        return 10;
+    }
+    const Json* error = res.find("error");
+    const Json* result = res.find("result");
+    if (error || !result) {
+        const Json* msg = error ? error->find("message") : nullptr;
+        fmt::print(stderr, "sokol-shdc-client: server error: {}\n", msg ? msg->as_string("") : "unknown");
+        return 10;
+    }
+    const Json* messages = result->find("messages");
+    if (messages) {
+        for (const Json& msg: messages->items) {
+            const Json* text = msg.find("text");
+            if (text) {
+                fmt::print(stderr, "{}\n", text->as_string(""));
+            }
+        }
+    }
+    const Json* exit_code = result->find("exit_code");
+    return exit_code ? exit_code->as_int(10) : 10;
+}
@@ -11,8 +11,10 @@
 
 namespace shdc {
 
+// option values start above the ASCII range, getopt_next() returns '!', '+' and '?'
+// for invalid flags and arguments without flag
 enum {
-    OPTION_HELP = 1,
+    OPTION_HELP = 256,
     OPTION_INPUT,
     OPTION_OUTPUT,
     OPTION_SLANG,
@@ -28,18 +30,38 @@ enum {
     OPTION_NOIFDEF,
     OPTION_REFLECTION,
     OPTION_SAVE_INTERMEDIATE_SPIRV,
+    OPTION_LOAD_INTERMEDIATE_SPIRV,
+    OPTION_JOBS,
+    OPTION_CACHE_DIR,
+    OPTION_CACHE_SIZE,
+    OPTION_BATCH,
+    OPTION_SERVER,
+    OPTION_WATCH,
+    OPTION_INCREMENTAL,
+    OPTION_DEPFILE,
+    OPTION_CHECK,
+    OPTION_LSP,
+    OPTION_PROGRAMS,
+    OPTION_INPUT_BUNDLE,
+    OPTION_OUTPUT_BUNDLE,
+    OPTION_TIMINGS,
+    OPTION_SPIRV_OPT_PROFILE,
+    OPTION_MEM_STATS,
 };
 
 static const getopt_option_t option_list[] = {
     { "help",               'h', GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_HELP,         "print this help text", 0},
-    { "input",              'i', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_INPUT,        "input source file", "GLSL file" },
-    { "output",             'o', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_OUTPUT,       "output source file", "C header" },
+    { "input",              'i', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_INPUT,        "input source file ('-' for stdin)", "GLSL file" },
+    { "output",             'o', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_OUTPUT,       "output source file ('-' for stdout)", "C header" },
+    { "input-bundle",       0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_INPUT_BUNDLE, "read the input file and all @include files from a bundle file ('-' for stdin)", "[path]" },
+    { "output-bundle",      0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_OUTPUT_BUNDLE, "write all generated files into a single bundle file ('-' for stdout)", "[path]" },
     { "slang",              'l', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_SLANG,        "output shader language(s), see above for list", "glsl430:glsl300es..." },
     { "defines",            0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_DEFINES,      "optional preprocessor defines", "define1:define2..." },
+    { "programs",           0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_PROGRAMS,     "only compile the listed @programs (default: all)", "prog1:prog2..." },
     { "module",             'm', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_MODULE,       "optional @module name override" },
     { "reflection",         'r', GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_REFLECTION,   "generate runtime reflection functions" },
     { "bytecode",           'b', GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_BYTECODE,     "output bytecode (HLSL and Metal)"},
-    { "format",             'f', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_FORMAT,       "output format (default: sokol)", "[sokol|sokol_impl|sokol_zig|sokol_nim|sokol_odin|sokol_rust|sokol_d|sokol_jai|bare|bare_yaml]" },
+    { "format",             'f', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_FORMAT,       "output format (default: sokol), can be repeated with an output path per additional format", "[sokol|sokol_impl|sokol_zig|sokol_nim|sokol_odin|sokol_rust|sokol_d|sokol_jai|bare|bare_yaml][=path]" },
     { "errfmt",             'e', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_ERRFMT,       "error message format (default: gcc)", "[gcc|msvc]"},
     { "dump",               'd', GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_DUMP,         "dump debugging information to stderr"},
     { "genver",             'g', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_GENVER,       "version-stamp for code-generation", "[int]"},
@@ -47,6 +69,20 @@ static const getopt_option_t option_list[] = {
     { "ifdef",              0,   GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_IFDEF,        "wrap backend-specific generated code in #ifdef/#endif"},
     { "noifdef",            'n', GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_NOIFDEF,      "obsolete, superseded by --ifdef"},
     { "save-intermediate-spirv", 0, GETOPT_OPTION_TYPE_NO_ARG,  0, OPTION_SAVE_INTERMEDIATE_SPIRV, "save intermediate SPIRV bytecode (for debug inspection)"},
+    { "load-intermediate-spirv", 0, GETOPT_OPTION_TYPE_NO_ARG,  0, OPTION_LOAD_INTERMEDIATE_SPIRV, "load up-to-date SPIRV bytecode saved with --save-intermediate-spirv instead of compiling"},
+    { "jobs",               'j', GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_JOBS,         "number of parallel compile jobs (default: number of CPU cores)", "[int]"},
+    { "cache-dir",          0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_CACHE_DIR,    "directory for caching compilation results between runs", "[dir]"},
+    { "cache-size",         0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_CACHE_SIZE,   "max size of the cache directory in MBytes (default: 256)", "[int]"},
+    { "batch",              0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_BATCH,        "compile all jobs in a manifest file (one sokol-shdc cmdline per line)", "[file]"},
+    { "server",             0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_SERVER,       "run as compile server, reading JSON-RPC requests from stdin or a unix socket", "[stdio|socket path]"},
+    { "watch",              0,   GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_WATCH,        "keep running and recompile when the input file or one of its @include files changes"},
+    { "check",              0,   GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_CHECK,        "only check for errors (no output file, no cross-compilation)"},
+    { "lsp",                0,   GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_LSP,          "run as language server (Language Server Protocol on stdin/stdout)"},
+    { "depfile",            0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_DEPFILE,      "write a Make/Ninja-compatible depfile with all input and @include files", "[path]"},
+    { "incremental",        0,   GETOPT_OPTION_TYPE_NO_ARG,     0, OPTION_INCREMENTAL,  "reuse compilation results of unchanged snippets from a manifest file next to the output"},
+    { "timings",            0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_TIMINGS,      "write per-stage timings as Chrome trace-event JSON and print a summary table", "[path]"},
+    { "spirv-opt-profile",  0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_SPIRV_OPT_PROFILE, "profile the SPIRV optimizer pass by pass, write a JSON report and print a summary table", "[path]"},
+    { "mem-stats",          0,   GETOPT_OPTION_TYPE_REQUIRED,   0, OPTION_MEM_STATS,    "count heap allocations and peak heap size per pipeline stage, write a JSON report and print a summary table", "[path]"},
     GETOPT_OPTIONS_END
 };
 
@@ -54,7 +90,10 @@ static void print_help_string(getopt_context_t& ctx) {
     fmt::print(stderr,
         "Shader compiler / code generator for sokol_gfx.h based on GLslang + SPIRV-Cross\n"
         "https://github.com/floooh/sokol-tools\n\n"
-        "Usage: sokol-shdc -i input [-o output] [options]\n\n"
+        "Usage: sokol-shdc -i input [-o output] [options]\n"
+        "       sokol-shdc --batch manifest [options]\n"
+        "       sokol-shdc --server [stdio|socket path] [options]\n"
+        "       sokol-shdc --lsp [options]\n\n"
         "Where [input] is exactly one .glsl file in Vulkan syntax (separate texture and sampler uniforms),\n"
         "and [output] is a C header with embedded shader source code and/or byte code and\n"
         "code-generated uniform-block and shader-description C structs ready for use with sokol_gfx.h\n\n"
@@ -82,10 +121,42 @@ static void print_help_string(getopt_context_t& ctx) {
         "  - bare           raw output of SPIRV-Cross compiler, in text or binary format\n"
         "  - bare_yaml      like bare, but with reflection file in YAML format\n\n"
         "Options:\n\n");
-    char buf[4096];
+    char buf[8192];
     fmt::print(stderr, "{}", getopt_create_help_string(&ctx, buf, sizeof(buf)));
 }
 
+/* parse a --format arg of the form 'format' or 'format=path', the first --format
+   sets the primary output format, every further --format needs its own output path
+*/
+static bool parse_format(Args& args, const std::string& str, int format_index, std::string& out_path) {
+    std::string name = str;
+    std::string path;
+    const size_t eq = str.find('=');
+    if (eq != std::string::npos) {
+        name = str.substr(0, eq);
+        path = str.substr(eq + 1);
+    }
+    const Format::Enum format = Format::from_str(name);
+    if (format == Format::INVALID) {
+        fmt::print(stderr, "sokol-shdc: unknown output format {}, must be [sokol|sokol_impl|sokol_zig|sokol_nim|sokol_odin|sokol_rust|sokol_jai|bare|base_yaml]\n", name);
+        args.valid = false;
+        args.exit_code = 10;
+        return false;
+    }
+    if (format_index == 0) {
+        args.output_format = format;
+        out_path = path;
+    } else if (path.empty()) {
+        fmt::print(stderr, "sokol-shdc: additional output format {} needs an output path (--format {}=[path])\n", name, name);
+        args.valid = false;
+        args.exit_code = 10;
+        return false;
+    } else {
+        args.extra_outputs.push_back({ format, path });
+    }
+    return true;
+}
+
 /* parse string of format 'hlsl4|...' args.slang bitmask */
 static bool parse_slang(Args& args, const char* str) {
 
@@ -129,18 +200,60 @@ static bool parse_slang(Args& args, const char* str) {
 
 static void validate(Args& args) {
     bool err = false;
-    if (args.input.empty()) {
+    if (args.watch && !args.server.empty()) {
+        fmt::print(stderr, "sokol-shdc: --watch can't be combined with --server\n");
+        args.valid = false;
+        args.exit_code = 10;
+        return;
+    }
+    if (args.lsp && (args.watch || !args.server.empty() || !args.batch.empty())) {
+        fmt::print(stderr, "sokol-shdc: --lsp can't be combined with --watch, --server or --batch\n");
+        args.valid = false;
+        args.exit_code = 10;
+        return;
+    }
+    if (!args.batch.empty() || !args.server.empty() || args.lsp) {
+        // input, output and shader languages are defined per batch job or server request,
+        // or by the documents opened in the editor
+        args.valid = true;
+        args.exit_code = 0;
+        return;
+    }
+    if (args.input.empty() && args.input_bundle.empty()) {
         fmt::print(stderr, "sokol-shdc: no input file (--input [path])\n");
         err = true;
     }
-    if (args.output.empty()) {
+    if ((args.input == "-") && (args.input_bundle == "-")) {
+        fmt::print(stderr, "sokol-shdc: --input and --input-bundle can't both be read from stdin\n");
+        err = true;
+    }
+    if ((args.output == "-") && (args.output_bundle == "-")) {
+        fmt::print(stderr, "sokol-shdc: --output and --output-bundle can't both be written to stdout\n");
+        err = true;
+    }
+    if (args.watch && ((args.input == "-") || !args.input_bundle.empty())) {
+        fmt::print(stderr, "sokol-shdc: --watch can't be combined with stdin input or --input-bundle\n");
+        err = true;
+    }
+    if (args.output.empty() && !args.check) {
         fmt::print(stderr, "sokol-shdc: no output file (--output [path])\n");
         err = true;
     }
-    if (args.slang == 0) {
+    if ((args.slang == 0) && !args.check) {
         fmt::print(stderr, "sokol-shdc: no shader languages (--slang ...)\n");
         err = true;
     }
+    for (size_t i = 0; i < args.extra_outputs.size(); i++) {
+        const std::string& path = args.extra_outputs[i].path;
+        bool duplicate = (path == args.output);
+        for (size_t j = 0; j < i; j++) {
+            duplicate |= (path == args.extra_outputs[j].path);
+        }
+        if (duplicate) {
+            fmt::print(stderr, "sokol-shdc: output path '{}' is used by more than one output format\n", path);
+            err = true;
+        }
+    }
     if (args.tmpdir.empty()) {
         std::string tail;
         pystring::os::path::split(args.tmpdir, tail, args.output);
@@ -171,6 +284,8 @@ Args Args::parse(int argc, const char** argv) {
         args.cmdline.append(argv[i]);
     }
 
+    int num_formats = 0;
+    std::string format_path;
     getopt_context_t ctx;
     if (getopt_create_context(&ctx, argc, argv, option_list) < 0) {
         fmt::print(stderr, "error in getopt_create_context()\n");
@@ -196,6 +311,12 @@ Args Args::parse(int argc, const char** argv) {
                 case OPTION_OUTPUT:
                     args.output = ctx.current_opt_arg;
                     break;
+                case OPTION_INPUT_BUNDLE:
+                    args.input_bundle = ctx.current_opt_arg;
+                    break;
+                case OPTION_OUTPUT_BUNDLE:
+                    args.output_bundle = ctx.current_opt_arg;
+                    break;
                 case OPTION_TMPDIR:
                     args.tmpdir = ctx.current_opt_arg;
                     break;
@@ -205,6 +326,9 @@ Args Args::parse(int argc, const char** argv) {
                 case OPTION_DEFINES:
                     pystring::split(ctx.current_opt_arg, args.defines, ":");
                     break;
+                case OPTION_PROGRAMS:
+                    pystring::split(ctx.current_opt_arg, args.programs, ":");
+                    break;
                 case OPTION_MODULE:
                     args.module = ctx.current_opt_arg;
                     break;
@@ -212,11 +336,7 @@ Args Args::parse(int argc, const char** argv) {
                     args.reflection = true;
                     break;
                 case OPTION_FORMAT:
-                    args.output_format = Format::from_str(ctx.current_opt_arg);
-                    if (args.output_format == Format::INVALID) {
-                        fmt::print(stderr, "sokol-shdc: unknown output format {}, must be [sokol|sokol_impl|sokol_zig|sokol_nim|sokol_odin|sokol_rust|sokol_jai|bare|base_yaml]\n", ctx.current_opt_arg);
-                        args.valid = false;
-                        args.exit_code = 10;
+                    if (!parse_format(args, ctx.current_opt_arg, num_formats++, format_path)) {
                         return args;
                     }
                     break;
@@ -226,6 +346,9 @@ Args Args::parse(int argc, const char** argv) {
                 case OPTION_SAVE_INTERMEDIATE_SPIRV:
                     args.save_intermediate_spirv = true;
                     break;
+                case OPTION_LOAD_INTERMEDIATE_SPIRV:
+                    args.load_intermediate_spirv = true;
+                    break;
                 case OPTION_SLANG:
                     if (!parse_slang(args, ctx.current_opt_arg)) {
                         /* error details have been filled by parse_slang() */
@@ -247,6 +370,57 @@ Args Args::parse(int argc, const char** argv) {
                 case OPTION_GENVER:
                     args.gen_version = atoi(ctx.current_opt_arg);
                     break;
+                case OPTION_JOBS:
+                    args.num_jobs = atoi(ctx.current_opt_arg);
+                    if (args.num_jobs < 1) {
+                        fmt::print(stderr, "sokol-shdc: --jobs must be at least 1\n");
+                        args.valid = false;
+                        args.exit_code = 10;
+                        return args;
+                    }
+                    break;
+                case OPTION_BATCH:
+                    args.batch = ctx.current_opt_arg;
+                    break;
+                case OPTION_SERVER:
+                    args.server = ctx.current_opt_arg;
+                    break;
+                case OPTION_CHECK:
+                    args.check = true;
+                    break;
+                case OPTION_LSP:
+                    args.lsp = true;
+                    break;
+                case OPTION_DEPFILE:
+                    args.depfile = ctx.current_opt_arg;
+                    break;
+                case OPTION_INCREMENTAL:
+                    args.incremental = true;
+                    break;
+                case OPTION_TIMINGS:
+                    args.timings = ctx.current_opt_arg;
+                    break;
+                case OPTION_SPIRV_OPT_PROFILE:
+                    args.spirv_opt_profile = ctx.current_opt_arg;
+                    break;
+                case OPTION_MEM_STATS:
+                    args.mem_stats = ctx.current_opt_arg;
+                    break;
+                case OPTION_WATCH:
+                    args.watch = true;
+                    break;
+                case OPTION_CACHE_DIR:
+                    args.cache_dir = ctx.current_opt_arg;
+                    break;
+                case OPTION_CACHE_SIZE:
+                    if (atoi(ctx.current_opt_arg) < 1) {
+                        fmt::print(stderr, "sokol-shdc: --cache-size must be at least 1\n");
+                        args.valid = false;
+                        args.exit_code = 10;
+                        return args;
+                    }
+                    args.cache_size = (uint64_t)atoi(ctx.current_opt_arg) * 1024 * 1024;
+                    break;
                 case OPTION_IFDEF:
                     args.ifdef = true;
                     break;
@@ -264,6 +438,16 @@ Args Args::parse(int argc, const char** argv) {
             }
         }
     }
+    // the output path of the first --format is an alternative to --output
+    if (!format_path.empty()) {
+        if (!args.output.empty() && (args.output != format_path)) {
+            fmt::print(stderr, "sokol-shdc: conflicting output paths '{}' and '{}'\n", args.output, format_path);
+            args.valid = false;
+            args.exit_code = 10;
+            return args;
+        }
+        args.output = format_path;
+    }
     validate(args);
     return args;
 }
@@ -274,15 +458,36 @@ void Args::dump_debug() const {
     fmt::print(stderr, "  exit_code: {}\n", exit_code);
     fmt::print(stderr, "  input: '{}'\n", input);
     fmt::print(stderr, "  output: '{}'\n", output);
+    fmt::print(stderr, "  input_bundle: '{}'\n", input_bundle);
+    fmt::print(stderr, "  output_bundle: '{}'\n", output_bundle);
     fmt::print(stderr, "  tmpdir: '{}'\n", tmpdir);
     fmt::print(stderr, "  slang: '{}'\n", Slang::bits_to_str(slang, ":"));
     fmt::print(stderr, "  byte_code: {}\n", byte_code);
     fmt::print(stderr, "  module: '{}'\n", module);
     fmt::print(stderr, "  defines: '{}'\n", pystring::join(":", defines));
+    fmt::print(stderr, "  programs: '{}'\n", pystring::join(":", programs));
     fmt::print(stderr, "  output_format: '{}'\n", Format::to_str(output_format));
+    for (const ExtraOutput& extra: extra_outputs) {
+        fmt::print(stderr, "  extra_output: '{}' => '{}'\n", Format::to_str(extra.format), extra.path);
+    }
     fmt::print(stderr, "  debug_dump: {}\n", debug_dump);
+    fmt::print(stderr, "  save_intermediate_spirv: {}\n", save_intermediate_spirv);
+    fmt::print(stderr, "  load_intermediate_spirv: {}\n", load_intermediate_spirv);
     fmt::print(stderr, "  ifdef: {}\n", ifdef);
     fmt::print(stderr, "  gen_version: {}\n", gen_version);
+    fmt::print(stderr, "  num_jobs: {}\n", num_jobs);
+    fmt::print(stderr, "  cache_dir: '{}'\n", cache_dir);
+    fmt::print(stderr, "  cache_size: {}\n", cache_size);
+    fmt::print(stderr, "  batch: '{}'\n", batch);
+    fmt::print(stderr, "  server: '{}'\n", server);
+    fmt::print(stderr, "  watch: {}\n", watch);
+    fmt::print(stderr, "  incremental: {}\n", incremental);
+    fmt::print(stderr, "  depfile: '{}'\n", depfile);
+    fmt::print(stderr, "  timings: '{}'\n", timings);
+    fmt::print(stderr, "  spirv_opt_profile: '{}'\n", spirv_opt_profile);
+    fmt::print(stderr, "  mem_stats: '{}'\n", mem_stats);
+    fmt::print(stderr, "  check: {}\n", check);
+    fmt::print(stderr, "  lsp: {}\n", lsp);
     fmt::print(stderr, "  error_format: {}\n", ErrMsg::format_to_str(error_format));
     fmt::print(stderr, "\n");
 }
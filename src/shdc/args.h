@@ -9,22 +9,46 @@ namespace shdc {
 
 // result of command-line-args parsing
 struct Args {
+    // an additional output format with its own output file path (--format [format]=[path])
+    struct ExtraOutput {
+        Format::Enum format = Format::INVALID;
+        std::string path;
+    };
+
     bool valid = false;
     std::string cmdline;
     int exit_code = 10;
-    std::string input;                  // input file path
-    std::string output;                 // output file path
+    std::string input;                  // input file path ("-": stdin)
+    std::string output;                 // output file path ("-": stdout)
+    std::string input_bundle;           // optional bundle with the input and @include files ("-": stdin)
+    std::string output_bundle;          // optional bundle for all generated files ("-": stdout)
     std::string tmpdir;                 // directory for temporary files
     std::string module;                 // optional @module name override
     std::vector<std::string> defines;   // additional preprocessor defines
+    std::vector<std::string> programs;  // optional subset of @programs to compile (default: all)
     uint32_t slang = 0;                 // combined Slang bits
     bool byte_code = false;             // output byte code (for HLSL and MetalSL)
     bool reflection = false;            // if true, generate runtime reflection functions
     Format::Enum output_format = Format::SOKOL; // output format
+    std::vector<ExtraOutput> extra_outputs;     // additional output formats generated from the same compilation
     bool debug_dump = false;            // print debug-dump info
     bool ifdef = false;                 // wrap backend specific shaders into #ifdefs (SOKOL_D3D11 etc...)
     bool save_intermediate_spirv = false;   // save intermediate SPIRV bytecode (glslangvalidator output)
+    bool load_intermediate_spirv = false;   // load saved intermediate SPIRV bytecode instead of compiling
     int gen_version = 1;                // generator-version stamp
+    int num_jobs = 0;                   // number of worker threads (0: number of CPU cores)
+    std::string cache_dir;              // optional artifact cache directory
+    uint64_t cache_size = 256 * 1024 * 1024; // max size of the artifact cache in bytes
+    std::string batch;                  // optional batch manifest file path
+    std::string server;                 // server mode: "stdio" or a unix socket path
+    bool watch = false;                 // keep running and recompile on file changes
+    bool incremental = false;           // reuse unchanged snippets via a manifest next to the output
+    std::string depfile;                // optional Make/Ninja depfile path
+    std::string timings;                // optional Chrome trace-event JSON output path for per-stage timings
+    std::string spirv_opt_profile;      // optional JSON report path for the SPIRV optimizer pass profiler
+    std::string mem_stats;              // optional JSON report path for per-stage heap allocation statistics
+    bool check = false;                 // only check for errors, don't generate output
+    bool lsp = false;                   // run as language server on stdin/stdout
     ErrMsg::Format error_format = ErrMsg::GCC;  // format for error messages
 
     static Args parse(int argc, const char** argv);
@@ -0,0 +1,140 @@
+/*
+    Batch mode: run the compilation pipeline for all jobs of a manifest
+    file in one process.
+
+    Manifest files contain one job per line, each job is a regular sokol-shdc
+    cmdline without the executable name, for instance:
+
+        # comment
+        -i shd/triangle.glsl -o shd/triangle.glsl.h -l glsl430:hlsl5:metal_macos
+        -i shd/cube.glsl -o shd/cube.glsl.h -l glsl430:hlsl5:metal_macos --defines "A:B"
+
+    Jobs run in parallel on the worker pool, the per-snippet compilation
+    inside each job runs on the same pool, the messages of each job are printed in manifest order after
+    all jobs have finished, a failed job doesn't stop the other jobs.
+*/
+#include "batch.h"
+#include "jobs.h"
+#include "pipeline.h"
+#include "fmt/format.h"
+#include "pystring.h"
+#include <stdio.h>
+#include <vector>
+
+namespace shdc {
+
+struct BatchJob {
+    Args args;
+    Pipeline result;
+};
+
+static bool load_manifest(const std::string& path, std::string& out_content) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+    char buf[4096];
+    size_t num_bytes;
+    while ((num_bytes = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        out_content.append(buf, num_bytes);
+    }
+    fclose(fp);
+    return true;
+}
+
+// split a manifest line into cmdline args, double quotes group args with spaces
+static std::vector<std::string> split_cmdline(const std::string& line) {
+    std::vector<std::string> tokens;
+    std::string token;
+    bool in_token = false;
+    bool in_quotes = false;
+    for (const char c: line) {
+        if (c == '"') {
+            in_quotes = !in_quotes;
+            in_token = true;
+        } else if (!in_quotes && ((c == ' ') || (c == '\t'))) {
+            if (in_token) {
+                tokens.push_back(token);
+                token.clear();
+                in_token = false;
+            }
+        } else {
+            token += c;
+            in_token = true;
+        }
+    }
+    if (in_token) {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+bool Batch::load_jobs(const Args& args, std::vector<Args>& out_jobs, int& out_num_invalid) {
+    out_num_invalid = 0;
+    std::string content;
+    if (!load_manifest(args.batch, content)) {
+        ErrMsg::error(args.batch, 0, "failed to open batch manifest file").print(args.error_format);
+        return false;
+    }
+    std::vector<std::string> lines;
+    pystring::splitlines(content, lines);
+    for (int line_index = 0; line_index < (int)lines.size(); line_index++) {
+        const std::string line = pystring::strip(lines[line_index]);
+        if (line.empty() || pystring::startswith(line, "#")) {
+            continue;
+        }
+        std::vector<std::string> tokens = split_cmdline(line);
+        std::vector<const char*> argv = { "sokol-shdc" };
+        for (const std::string& token: tokens) {
+            argv.push_back(token.c_str());
+        }
+        Args job_args = Args::parse((int)argv.size(), argv.data());
+        if (job_args.valid && (!job_args.batch.empty() || job_args.watch)) {
+            job_args.valid = false;
+            job_args.exit_code = 10;
+            fmt::print(stderr, "sokol-shdc: --batch and --watch are not allowed in batch jobs\n");
+        }
+        if (!job_args.valid) {
+            ErrMsg::error(args.batch, line_index, "invalid batch job").print(args.error_format);
+            out_num_invalid++;
+            continue;
+        }
+        out_jobs.push_back(std::move(job_args));
+    }
+    return true;
+}
+
+int Batch::run(const Args& args, const Cache& cache) {
+    // parse all job cmdlines
+    std::vector<Args> job_args;
+    int num_invalid = 0;
+    if (!load_jobs(args, job_args, num_invalid)) {
+        return 10;
+    }
+    std::vector<BatchJob> jobs(job_args.size());
+    for (size_t i = 0; i < job_args.size(); i++) {
+        jobs[i].args = std::move(job_args[i]);
+    }
+
+    // run all jobs on the worker pool, idle threads help with the snippets of the running jobs
+    Jobs::run(args.num_jobs, (int)jobs.size(), [&jobs, &cache](int job_index) {
+        BatchJob& job = jobs[job_index];
+        job.result = Pipeline::run(job.args, cache);
+    });
+
+    // report messages in manifest order
+    int num_failed = num_invalid;
+    for (const BatchJob& job: jobs) {
+        job.result.print(job.args.error_format);
+        if (job.result.exit_code != 0) {
+            num_failed++;
+        }
+    }
+    if (num_failed > 0) {
+        fmt::print(stderr, "sokol-shdc: {} of {} batch jobs failed\n", num_failed, (int)jobs.size() + num_invalid);
+        return 10;
+    }
+    return 0;
+}
+
+} // namespace shdc
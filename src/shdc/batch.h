@@ -0,0 +1,17 @@
+#pragma once
+#include <vector>
+#include "args.h"
+#include "cache.h"
+
+namespace shdc {
+
+// batch mode (--batch manifest), compiles all jobs in a manifest file in a
+// single process, the manifest contains one sokol-shdc cmdline per line
+struct Batch {
+    static int run(const Args& args, const Cache& cache);
+    // load and parse the manifest file, invalid jobs are reported and skipped, returns false
+    // if the manifest file can't be loaded
+    static bool load_jobs(const Args& args, std::vector<Args>& out_jobs, int& out_num_invalid);
+};
+
+} // namespace shdc
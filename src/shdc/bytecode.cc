@@ -10,9 +10,14 @@
     shaders are compiled at runtime from source code.
 */
 #include "bytecode.h"
+#include "timings.h"
+#include "memstats.h"
 #include "fmt/format.h"
 #include "pystring.h"
 #include <stdio.h> // popen etc...
+#include <assert.h>
+#include <array>
+#include <mutex>
 #if defined(_WIN32)
 #include <d3dcompiler.h>
 #include <d3dcommon.h>
@@ -143,6 +148,13 @@ static int xcrun(const std::string& cmdline, std::string& output, Slang::Enum sl
     return exit_code;
 }
 
+// the version of the Metal compiler in the SDK, part of the bytecode cache keys
+static std::string mtl_compiler_identity(Slang::Enum slang) {
+    std::string output;
+    xcrun("metal --version", output, slang);
+    return output;
+}
+
 // run the metal compiler pass
 static bool mtl_cc(const std::string& src_path, const std::string& out_dia, const std::string& out_air, Slang::Enum slang, std::string& output) {
     std::string cmdline;
@@ -166,7 +178,7 @@ static bool mtl_link(const std::string& lib_path, const std::string& bin_path, S
     return 0 == xcrun(cmdline, dummy_output, slang);
 }
 
-static Bytecode mtl_compile(const Args& args, const Input& inp, const Spirvcross& spirvcross, Slang::Enum slang) {
+static Bytecode mtl_compile(const Args& args, const Input& inp, const std::vector<const SpirvcrossSource*>& sources, Slang::Enum slang) {
     Bytecode bytecode;
     std::string base_dir;
     std::string base_filename;
@@ -175,7 +187,8 @@ static Bytecode mtl_compile(const Args& args, const Input& inp, const Spirvcross
     std::string src_path, dia_path, air_path, lib_path, bin_path;
 
     // for each vertex/fragment shader source generated by SPIRV-Cross:
-    for (const SpirvcrossSource& src: spirvcross.sources) {
+    for (const SpirvcrossSource* src_ptr: sources) {
+        const SpirvcrossSource& src = *src_ptr;
         std::string output;
         const Snippet& snippet = inp.snippets[src.snippet_index];
         src_path = fmt::format("{}{}.metal", base_path, snippet.name);
@@ -222,15 +235,34 @@ static HINSTANCE d3dcompiler_dll = 0;
 static pD3DCompile d3dcompile_func = 0;
 
 static bool load_d3dcompiler_dll(void) {
-    if (0 == d3dcompiler_dll) {
+    // NOTE: batch jobs may compile concurrently, the DLL is loaded exactly once
+    static std::once_flag once;
+    std::call_once(once, []() {
         d3dcompiler_dll = LoadLibraryA("d3dcompiler_47.dll");
         if (0 != d3dcompiler_dll) {
             d3dcompile_func = (pD3DCompile) GetProcAddress(d3dcompiler_dll, "D3DCompile");
         }
-    }
+    });
     return 0 != d3dcompile_func;
 }
 
+// the path, size and modification time of the loaded d3dcompiler DLL (which has no
+// version query API), part of the bytecode cache keys
+static std::string d3d_compiler_identity(void) {
+    if (!load_d3dcompiler_dll()) {
+        return std::string();
+    }
+    char path[MAX_PATH] = { };
+    GetModuleFileNameA(d3dcompiler_dll, path, MAX_PATH);
+    WIN32_FILE_ATTRIBUTE_DATA attrs = { };
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attrs)) {
+        return path;
+    }
+    return fmt::format("{}:{}:{}:{}:{}", path,
+        attrs.nFileSizeHigh, attrs.nFileSizeLow,
+        attrs.ftLastWriteTime.dwHighDateTime, attrs.ftLastWriteTime.dwLowDateTime);
+}
+
 static void d3d_parse_errors(const std::string& output, const Input& inp, int snippet_index, std::vector<ErrMsg>& out_errors) {
     /*
         format for errors/warnings is:
@@ -278,13 +310,14 @@ static void d3d_parse_errors(const std::string& output, const Input& inp, int sn
     }
 }
 
-static Bytecode d3d_compile(const Input& inp, const Spirvcross& spirvcross, Slang::Enum slang) {
+static Bytecode d3d_compile(const Input& inp, const std::vector<const SpirvcrossSource*>& sources, Slang::Enum slang) {
     Bytecode bytecode;
     if (!load_d3dcompiler_dll()) {
         bytecode.errors.push_back(ErrMsg::warning(inp.base_path, 0, fmt::format("failed to load d3dcompiler_47.dll!")));
         return bytecode;
     }
-    for (const SpirvcrossSource& src: spirvcross.sources) {
+    for (const SpirvcrossSource* src_ptr: sources) {
+        const SpirvcrossSource& src = *src_ptr;
         const Snippet& snippet = inp.snippets[src.snippet_index];
         ID3DBlob* output = NULL;
         ID3DBlob* errors = NULL;
@@ -338,19 +371,82 @@ static Bytecode d3d_compile(const Input& inp, const Spirvcross& spirvcross, Slan
 }
 #endif
 
-Bytecode Bytecode::compile(const Args& args, const Input& inp, const Spirvcross& spirvcross, Slang::Enum slang) {
-    Bytecode bytecode;
+// check if bytecode can be compiled for a shader language on the current platform
+static bool has_bytecode_compiler(Slang::Enum slang) {
     #if defined(__APPLE__)
     // NOTE: for the iOS simulator case, don't compile bytecode but use source code
-    if ((slang == Slang::METAL_MACOS) || (slang == Slang::METAL_IOS)) {
-        bytecode = mtl_compile(args, inp, spirvcross, slang);
+    return (slang == Slang::METAL_MACOS) || (slang == Slang::METAL_IOS);
+    #elif defined(_WIN32)
+    return (slang == Slang::HLSL4) || (slang == Slang::HLSL5);
+    #else
+    return false;
+    #endif
+}
+
+// identifies the external bytecode compiler, so that cached bytecode isn't reused
+// after an SDK or DLL update, only queried once per shader language
+static std::string compiler_identity(Slang::Enum slang) {
+    static std::mutex mutex;
+    static std::array<std::string,Slang::Num> identities;
+    static std::array<bool,Slang::Num> valid = { };
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!valid[slang]) {
+        #if defined(__APPLE__)
+        identities[slang] = mtl_compiler_identity(slang);
+        #elif defined(_WIN32)
+        identities[slang] = d3d_compiler_identity();
+        #endif
+        valid[slang] = true;
+    }
+    return identities[slang];
+}
+
+static std::string bytecode_cache_key(const Input& inp, const SpirvcrossSource& src, Slang::Enum slang) {
+    const Snippet& snippet = inp.snippets[src.snippet_index];
+    return Cache::key(fmt::format("bc:{}:{}:{}:{}:{}", compiler_identity(slang), Slang::to_str(slang), Snippet::type_to_str(snippet.type), src.stage_refl.entry_point, src.source_code));
+}
+
+Bytecode Bytecode::compile(const Args& args, const Input& inp, const Spirvcross& spirvcross, Slang::Enum slang, const Cache& cache) {
+    Bytecode bytecode;
+    if (!has_bytecode_compiler(slang)) {
+        return bytecode;
+    }
+    Timings::Scope timing("bytecode_compile", Slang::to_str(slang));
+    MemStats::Scope mem_stage(MemStats::BYTECODE);
+    // lookup cached bytecode, only the remaining sources are compiled (without
+    // copying the sources, which may be large)
+    std::vector<const SpirvcrossSource*> uncached;
+    for (const SpirvcrossSource& src: spirvcross.sources) {
+        BytecodeBlob blob;
+        blob.snippet_index = src.snippet_index;
+        if (cache.enabled() && cache.load_bytecode(bytecode_cache_key(inp, src, slang), blob)) {
+            bytecode.blobs.push_back(std::move(blob));
+        } else {
+            uncached.push_back(&src);
+        }
+    }
+    if (uncached.empty()) {
+        return bytecode;
     }
+    Bytecode compiled;
+    #if defined(__APPLE__)
+    compiled = mtl_compile(args, inp, uncached, slang);
     #endif
     #if defined(_WIN32)
-    if ((slang == Slang::HLSL4) || (slang == Slang::HLSL5)) {
-        bytecode = d3d_compile(inp, spirvcross, slang);
-    }
+    compiled = d3d_compile(inp, uncached, slang);
     #endif
+    // only cache bytecode when there were no errors or warnings
+    if (cache.enabled() && compiled.errors.empty()) {
+        for (const BytecodeBlob& blob: compiled.blobs) {
+            const SpirvcrossSource* src = spirvcross.find_source_by_snippet_index(blob.snippet_index);
+            assert(src);
+            cache.store_bytecode(bytecode_cache_key(inp, *src, slang), blob);
+        }
+    }
+    for (BytecodeBlob& blob: compiled.blobs) {
+        bytecode.blobs.push_back(std::move(blob));
+    }
+    bytecode.errors = std::move(compiled.errors);
     return bytecode;
 }
 
@@ -0,0 +1,791 @@
+/*
+    Content-addressed on-disk cache for SPIRV blobs, SPIRVCross output
+    (including stage reflection info) and HLSL/Metal bytecode.
+
+    Cache files are named after a hash of all inputs which affect the
+    artifact, with the artifact type as extension (.spv, .src or .bc).
+    They are kept in a 'sokol-shdc' subdirectory of --cache-dir, which is
+    tagged with a CACHEDIR.TAG marker file. Only files with a cache file
+    name are ever evicted, and only from a directory with the marker, so
+    that unrelated files are never deleted.
+    Files are first written to a uniquely named temporary file and then
+    renamed into place, so readers never see a partially written file.
+    Eviction is least-recently-used, based on file modification time,
+    which is refreshed on each cache hit.
+
+    Long-running processes (server mode) can additionally keep cache
+    entries in memory, with a separate LRU list bounded by the same
+    max size, this also works without a cache directory.
+
+    With --incremental, the names and content hashes of the entries used
+    for one output file are kept in a manifest file next to the output.
+    Without --cache-dir, the entries themselves go into a private cache
+    directory next to the output, so that unchanged snippets are reused by
+    the next run without a shared cache directory. Entries which were not
+    used by the last successful run are removed from the private directory,
+    and entries whose content doesn't match the manifest hash are ignored.
+*/
+#include "cache.h"
+#include "output.h"
+#include "fmt/format.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+#include <map>
+#if !defined(__wasi__)
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#endif
+
+namespace fs = std::filesystem;
+
+// set by the build system, builds without git only depend on Cache::Version
+#ifndef SHDC_BUILD_VERSION
+#define SHDC_BUILD_VERSION "unknown"
+#endif
+
+namespace shdc {
+
+using namespace refl;
+
+static const uint32_t cache_magic = 0x43444853;    // 'SHDC'
+static const uint32_t manifest_magic = 0x4d444853;  // 'SHDM'
+
+enum CacheType: uint32_t {
+    CACHE_SPIRV = 1,
+    CACHE_SOURCE = 2,
+    CACHE_BYTECODE = 3,
+};
+
+static const char* cache_type_ext(CacheType type) {
+    switch (type) {
+        case CACHE_SPIRV:    return "spv";
+        case CACHE_SOURCE:   return "src";
+        case CACHE_BYTECODE: return "bc";
+        default:             return "bin";
+    }
+}
+
+// simple binary serialization helpers
+struct CacheWriter {
+    std::string data;
+
+    void u32(uint32_t val) {
+        data.append((const char*)&val, sizeof(val));
+    }
+    void i32(int val) {
+        u32((uint32_t)val);
+    }
+    void str(const std::string& val) {
+        u32((uint32_t)val.size());
+        data.append(val);
+    }
+    void bytes(const void* ptr, size_t num_bytes) {
+        u32((uint32_t)num_bytes);
+        data.append((const char*)ptr, num_bytes);
+    }
+};
+
+struct CacheReader {
+    const std::string& data;
+    size_t pos = 0;
+    bool ok = true;
+
+    CacheReader(const std::string& d): data(d) { };
+    uint32_t u32() {
+        uint32_t val = 0;
+        if (ok && ((pos + sizeof(val)) <= data.size())) {
+            memcpy(&val, data.data() + pos, sizeof(val));
+            pos += sizeof(val);
+        } else {
+            ok = false;
+        }
+        return val;
+    }
+    int i32() {
+        return (int)u32();
+    }
+    std::string str() {
+        const size_t len = u32();
+        if (ok && ((pos + len) <= data.size())) {
+            std::string val = data.substr(pos, len);
+            pos += len;
+            return val;
+        }
+        ok = false;
+        return std::string();
+    }
+    template<typename T> std::vector<T> bytes() {
+        const size_t num_bytes = u32();
+        std::vector<T> val;
+        if (ok && ((num_bytes % sizeof(T)) == 0) && ((pos + num_bytes) <= data.size())) {
+            val.resize(num_bytes / sizeof(T));
+            memcpy(val.data(), data.data() + pos, num_bytes);
+            pos += num_bytes;
+        } else {
+            ok = false;
+        }
+        return val;
+    }
+    bool done() const {
+        return ok && (pos == data.size());
+    }
+};
+
+static void write_type(CacheWriter& w, const Type& type) {
+    w.str(type.name);
+    w.str(type.struct_typename);
+    w.u32(type.type);
+    w.u32(type.is_matrix);
+    w.u32(type.is_array);
+    w.i32(type.offset);
+    w.i32(type.size);
+    w.i32(type.align);
+    w.i32(type.matrix_stride);
+    w.i32(type.array_count);
+    w.i32(type.array_stride);
+    w.u32((uint32_t)type.struct_items.size());
+    for (const Type& item: type.struct_items) {
+        write_type(w, item);
+    }
+}
+
+static Type read_type(CacheReader& r) {
+    Type type;
+    type.name = r.str();
+    type.struct_typename = r.str();
+    type.type = (Type::Enum)r.u32();
+    type.is_matrix = r.u32() != 0;
+    type.is_array = r.u32() != 0;
+    type.offset = r.i32();
+    type.size = r.i32();
+    type.align = r.i32();
+    type.matrix_stride = r.i32();
+    type.array_count = r.i32();
+    type.array_stride = r.i32();
+    const uint32_t num_items = r.u32();
+    for (uint32_t i = 0; r.ok && (i < num_items); i++) {
+        type.struct_items.push_back(read_type(r));
+    }
+    return type;
+}
+
+static void write_attr(CacheWriter& w, const StageAttr& attr) {
+    w.i32(attr.slot);
+    w.str(attr.name);
+    w.str(attr.sem_name);
+    w.i32(attr.sem_index);
+    w.str(attr.snippet_name);
+    write_type(w, attr.type_info);
+}
+
+static StageAttr read_attr(CacheReader& r) {
+    StageAttr attr;
+    attr.slot = r.i32();
+    attr.name = r.str();
+    attr.sem_name = r.str();
+    attr.sem_index = r.i32();
+    attr.snippet_name = r.str();
+    attr.type_info = read_type(r);
+    return attr;
+}
+
+static void write_bindings(CacheWriter& w, const Bindings& bindings) {
+    w.u32((uint32_t)bindings.uniform_blocks.size());
+    for (const UniformBlock& ub: bindings.uniform_blocks) {
+        w.u32(ub.stage);
+        w.i32(ub.slot);
+        w.str(ub.inst_name);
+        w.u32(ub.flattened);
+        write_type(w, ub.struct_info);
+    }
+    w.u32((uint32_t)bindings.storage_buffers.size());
+    for (const StorageBuffer& sbuf: bindings.storage_buffers) {
+        w.u32(sbuf.stage);
+        w.i32(sbuf.slot);
+        w.str(sbuf.inst_name);
+        w.u32(sbuf.readonly);
+        write_type(w, sbuf.struct_info);
+    }
+    w.u32((uint32_t)bindings.images.size());
+    for (const Image& img: bindings.images) {
+        w.u32(img.stage);
+        w.i32(img.slot);
+        w.str(img.name);
+        w.u32(img.type);
+        w.u32(img.sample_type);
+        w.u32(img.multisampled);
+    }
+    w.u32((uint32_t)bindings.samplers.size());
+    for (const Sampler& smp: bindings.samplers) {
+        w.u32(smp.stage);
+        w.i32(smp.slot);
+        w.str(smp.name);
+        w.u32(smp.type);
+    }
+    w.u32((uint32_t)bindings.image_samplers.size());
+    for (const ImageSampler& img_smp: bindings.image_samplers) {
+        w.u32(img_smp.stage);
+        w.i32(img_smp.slot);
+        w.str(img_smp.name);
+        w.str(img_smp.image_name);
+        w.str(img_smp.sampler_name);
+    }
+}
+
+static Bindings read_bindings(CacheReader& r) {
+    Bindings bindings;
+    uint32_t num = r.u32();
+    for (uint32_t i = 0; r.ok && (i < num); i++) {
+        UniformBlock ub;
+        ub.stage = (ShaderStage::Enum)r.u32();
+        ub.slot = r.i32();
+        ub.inst_name = r.str();
+        ub.flattened = r.u32() != 0;
+        ub.struct_info = read_type(r);
+        bindings.uniform_blocks.push_back(ub);
+    }
+    num = r.u32();
+    for (uint32_t i = 0; r.ok && (i < num); i++) {
+        StorageBuffer sbuf;
+        sbuf.stage = (ShaderStage::Enum)r.u32();
+        sbuf.slot = r.i32();
+        sbuf.inst_name = r.str();
+        sbuf.readonly = r.u32() != 0;
+        sbuf.struct_info = read_type(r);
+        bindings.storage_buffers.push_back(sbuf);
+    }
+    num = r.u32();
+    for (uint32_t i = 0; r.ok && (i < num); i++) {
+        Image img;
+        img.stage = (ShaderStage::Enum)r.u32();
+        img.slot = r.i32();
+        img.name = r.str();
+        img.type = (ImageType::Enum)r.u32();
+        img.sample_type = (ImageSampleType::Enum)r.u32();
+        img.multisampled = r.u32() != 0;
+        bindings.images.push_back(img);
+    }
+    num = r.u32();
+    for (uint32_t i = 0; r.ok && (i < num); i++) {
+        Sampler smp;
+        smp.stage = (ShaderStage::Enum)r.u32();
+        smp.slot = r.i32();
+        smp.name = r.str();
+        smp.type = (SamplerType::Enum)r.u32();
+        bindings.samplers.push_back(smp);
+    }
+    num = r.u32();
+    for (uint32_t i = 0; r.ok && (i < num); i++) {
+        ImageSampler img_smp;
+        img_smp.stage = (ShaderStage::Enum)r.u32();
+        img_smp.slot = r.i32();
+        img_smp.name = r.str();
+        img_smp.image_name = r.str();
+        img_smp.sampler_name = r.str();
+        bindings.image_samplers.push_back(img_smp);
+    }
+    return bindings;
+}
+
+static void write_stage_refl(CacheWriter& w, const StageReflection& refl) {
+    w.str(refl.snippet_name);
+    w.u32(refl.stage);
+    w.str(refl.stage_name);
+    w.str(refl.entry_point);
+    for (const StageAttr& attr: refl.inputs) {
+        write_attr(w, attr);
+    }
+    for (const StageAttr& attr: refl.outputs) {
+        write_attr(w, attr);
+    }
+    write_bindings(w, refl.bindings);
+}
+
+static StageReflection read_stage_refl(CacheReader& r) {
+    StageReflection refl;
+    refl.snippet_name = r.str();
+    refl.stage = (ShaderStage::Enum)r.u32();
+    refl.stage_name = r.str();
+    refl.entry_point = r.str();
+    for (StageAttr& attr: refl.inputs) {
+        attr = read_attr(r);
+    }
+    for (StageAttr& attr: refl.outputs) {
+        attr = read_attr(r);
+    }
+    refl.bindings = read_bindings(r);
+    return refl;
+}
+
+// the murmur3 64-bit finalizer, used to spread the bits of the FNV hashes below
+static uint64_t fmix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+struct KeyHash {
+    uint64_t h0 = 0xcbf29ce484222325ULL;
+    uint64_t h1 = 0x84222325cbf29ce4ULL;
+
+    void add(const std::string& str) {
+        const uint64_t prime = 0x100000001b3ULL;
+        for (const char c: str) {
+            h0 = (h0 ^ (uint8_t)c) * prime;
+            h1 = ((h1 ^ (uint8_t)c) * prime) ^ (h1 >> 29);
+        }
+    }
+};
+
+// content hash of a cache entry, as 128-bit hex string (see --incremental)
+static std::string content_hash(const std::string& data) {
+    KeyHash hash;
+    hash.add(data);
+    return fmt::format("{:016x}{:016x}", fmix64(hash.h0), fmix64(hash.h1 ^ hash.h0));
+}
+
+static std::string cache_filename(const std::string& key, CacheType type) {
+    return fmt::format("{}.{}", key, cache_type_ext(type));
+}
+
+static std::string cache_path(const std::string& dir, const std::string& key, CacheType type) {
+    return fmt::format("{}/{}", dir, cache_filename(key, type));
+}
+
+// true for the file names written by store(): a 32 hex digit key (see Cache::key())
+// with the extension of one of the cache types
+static bool is_cache_filename(const std::string& name) {
+    const size_t key_len = 32;
+    if ((name.size() <= (key_len + 1)) || (name[key_len] != '.')) {
+        return false;
+    }
+    for (size_t i = 0; i < key_len; i++) {
+        const char c = name[i];
+        if (!(((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'f')))) {
+            return false;
+        }
+    }
+    const std::string ext = name.substr(key_len + 1);
+    for (CacheType type: { CACHE_SPIRV, CACHE_SOURCE, CACHE_BYTECODE }) {
+        if (ext == cache_type_ext(type)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// the marker file of a directory which is owned by the cache (see https://bford.info/cachedir/)
+static const char* cache_marker_filename = "CACHEDIR.TAG";
+
+static bool has_cache_marker(const std::string& dir) {
+    std::error_code ec;
+    return fs::is_regular_file(fmt::format("{}/{}", dir, cache_marker_filename), ec);
+}
+
+// create a cache directory and its marker file
+static bool create_cache_dir(const std::string& dir, std::error_code& ec) {
+    fs::create_directories(dir, ec);
+    if (ec || !fs::is_directory(dir, ec)) {
+        return false;
+    }
+    if (!has_cache_marker(dir)) {
+        Output::write_atomic(fmt::format("{}/{}", dir, cache_marker_filename),
+            "Signature: 8a477f597d28d172789f06886806bc55\n"
+            "# This file is a cache directory tag created by sokol-shdc.\n");
+    }
+    return has_cache_marker(dir);
+}
+
+static bool read_file(const std::string& path, std::string& out_data) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    const long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    bool res = false;
+    if (file_size > 0) {
+        out_data.resize((size_t)file_size);
+        res = (fread(&out_data[0], 1, (size_t)file_size, fp) == (size_t)file_size);
+    }
+    fclose(fp);
+    return res;
+}
+
+#if !defined(__wasi__)
+// the in-memory cache layer, shared by all copies of a Cache object
+struct CacheMemory {
+    struct Entry {
+        std::string data;
+        std::list<std::string>::iterator lru_it;
+    };
+    std::mutex mutex;
+    std::list<std::string> lru;     // most recently used entry first
+    std::unordered_map<std::string, Entry> entries;
+    uint64_t size = 0;
+    uint64_t max_size = 0;
+
+    bool load(const std::string& key, std::string& out_data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            return false;
+        }
+        lru.splice(lru.begin(), lru, it->second.lru_it);
+        out_data = it->second.data;
+        return true;
+    }
+    void store(const std::string& key, const std::string& data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            size -= it->second.data.size();
+            lru.erase(it->second.lru_it);
+            entries.erase(it);
+        }
+        lru.push_front(key);
+        entries[key] = Entry{ data, lru.begin() };
+        size += data.size();
+        while ((size > max_size) && (lru.size() > 1)) {
+            auto oldest = entries.find(lru.back());
+            size -= oldest->second.data.size();
+            entries.erase(oldest);
+            lru.pop_back();
+        }
+    }
+};
+#else
+// no in-memory layer on WASI (no server mode)
+struct CacheMemory {
+    uint64_t max_size = 0;
+    bool load(const std::string& key, std::string& out_data) { return false; }
+    void store(const std::string& key, const std::string& data) { }
+};
+#endif
+
+// the per-output manifest (--incremental), the names and content hashes of
+// the cache entries used by the last successful run, the entries are stored
+// in the cache directory
+struct CacheManifest {
+    #if !defined(__wasi__)
+    std::mutex mutex;
+    #endif
+    std::string path;
+    std::string private_dir;    // the cache directory next to the output, if there's no --cache-dir
+    std::string content;        // original manifest file content
+    std::map<std::string, std::string> entries; // entry name => content hash, loaded from the manifest file
+    std::map<std::string, std::string> used;    // entry name => content hash, of this run
+
+    void parse() {
+        CacheReader r(content);
+        if ((r.u32() != manifest_magic) || (r.u32() != Cache::Version)) {
+            return;
+        }
+        const uint32_t num_entries = r.u32();
+        for (uint32_t i = 0; r.ok && (i < num_entries); i++) {
+            std::string name = r.str();
+            std::string hash = r.str();
+            if (r.ok) {
+                entries[std::move(name)] = std::move(hash);
+            }
+        }
+        if (!r.done()) {
+            entries.clear();
+        }
+    }
+    // returns false if the entry content doesn't match the hash from the manifest file
+    bool verify(const std::string& name, const std::string& data) {
+        std::string hash = content_hash(data);
+        #if !defined(__wasi__)
+        std::lock_guard<std::mutex> lock(mutex);
+        #endif
+        auto it = entries.find(name);
+        if ((it != entries.end()) && (it->second != hash)) {
+            return false;
+        }
+        used[name] = std::move(hash);
+        return true;
+    }
+    void store(const std::string& name, const std::string& data) {
+        std::string hash = content_hash(data);
+        #if !defined(__wasi__)
+        std::lock_guard<std::mutex> lock(mutex);
+        #endif
+        used[name] = std::move(hash);
+    }
+};
+
+static bool load(const Cache& cache, const std::string& key, CacheType type, std::string& out_data) {
+    if (!cache.enabled()) {
+        return false;
+    }
+    const std::string path = cache_path(cache.dir, key, type);
+    if (cache.memory && cache.memory->load(path, out_data)) {
+        return !cache.manifest || cache.manifest->verify(cache_filename(key, type), out_data);
+    }
+    if (cache.dir.empty() || !read_file(path, out_data)) {
+        return false;
+    }
+    if (cache.manifest && !cache.manifest->verify(cache_filename(key, type), out_data)) {
+        return false;
+    }
+    // refresh the access time for LRU eviction
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    if (cache.memory) {
+        cache.memory->store(path, out_data);
+    }
+    return true;
+}
+
+static void store(const Cache& cache, const std::string& key, CacheType type, const std::string& data) {
+    if (!cache.enabled()) {
+        return;
+    }
+    const std::string path = cache_path(cache.dir, key, type);
+    if (cache.memory) {
+        cache.memory->store(path, data);
+    }
+    if (cache.manifest) {
+        cache.manifest->store(cache_filename(key, type), data);
+    }
+    if (cache.dir.empty()) {
+        return;
+    }
+    Output::write_atomic(path, data);
+}
+
+static void write_header(CacheWriter& w, CacheType type) {
+    w.u32(cache_magic);
+    w.u32(Cache::Version);
+    w.u32(type);
+}
+
+static bool read_header(CacheReader& r, CacheType type) {
+    return (r.u32() == cache_magic) && (r.u32() == Cache::Version) && (r.u32() == type);
+}
+
+Cache Cache::open(const std::string& dir, uint64_t max_size, bool in_memory) {
+    Cache cache;
+    cache.max_size = max_size;
+    if (in_memory) {
+        cache.memory = std::make_shared<CacheMemory>();
+        cache.memory->max_size = max_size;
+    }
+    if (dir.empty()) {
+        return cache;
+    }
+    // the cache files go into a subdirectory owned by sokol-shdc, so that a --cache-dir
+    // which also contains other files (e.g. the project directory) can be used
+    const std::string cache_dir = fmt::format("{}/sokol-shdc", dir);
+    std::error_code ec;
+    if (!create_cache_dir(cache_dir, ec)) {
+        cache.error = ErrMsg::error(dir, 0, fmt::format("failed to create cache directory ({})", ec ? ec.message() : std::string("can't write marker file")));
+        return cache;
+    }
+    cache.dir = cache_dir;
+    return cache;
+}
+
+Cache Cache::with_manifest(const std::string& path, const std::string& private_dir) const {
+    Cache cache = *this;
+    cache.manifest = std::make_shared<CacheManifest>();
+    cache.manifest->path = path;
+    if (read_file(path, cache.manifest->content)) {
+        cache.manifest->parse();
+    }
+    if (cache.dir.empty()) {
+        // without a cache directory, the manifest entries are kept in a private
+        // directory, if it can't be created, all manifest entries are cache misses
+        std::error_code ec;
+        if (create_cache_dir(private_dir, ec)) {
+            cache.dir = private_dir;
+            cache.manifest->private_dir = private_dir;
+        }
+    }
+    return cache;
+}
+
+void Cache::save_manifest() const {
+    if (!manifest) {
+        return;
+    }
+    CacheWriter w;
+    w.u32(manifest_magic);
+    w.u32(Cache::Version);
+    w.u32((uint32_t)manifest->used.size());
+    for (const auto& item: manifest->used) {
+        w.str(item.first);
+        w.str(item.second);
+    }
+    if (w.data != manifest->content) {
+        Output::write_atomic(manifest->path, w.data);
+    }
+    // remove the entries of snippets which have changed from the private cache directory
+    if (!manifest->private_dir.empty()) {
+        std::error_code ec;
+        std::vector<fs::path> unused;
+        for (fs::directory_iterator it(manifest->private_dir, ec), end; !ec && (it != end); it.increment(ec)) {
+            std::error_code entry_ec;
+            const std::string name = it->path().filename().string();
+            if (it->is_regular_file(entry_ec) && is_cache_filename(name) && (manifest->used.count(name) == 0)) {
+                unused.push_back(it->path());
+            }
+        }
+        for (const fs::path& path: unused) {
+            fs::remove(path, ec);
+        }
+    }
+}
+
+bool Cache::enabled() const {
+    return !dir.empty() || memory || manifest;
+}
+
+// two 64-bit FNV-1a hashes with different offset bases, combined into a 128-bit hex string,
+// the cache version and the build version (the sokol-tools and dependency commit hashes,
+// see src/shdc/CMakeLists.txt and build.zig) are hashed once into the initial state
+std::string Cache::key(const std::string& inputs) {
+    static const KeyHash version_hash = []() {
+        KeyHash hash;
+        hash.add(fmt::format("{}:{}:", Cache::Version, SHDC_BUILD_VERSION));
+        return hash;
+    }();
+    KeyHash hash = version_hash;
+    hash.add(inputs);
+    return fmt::format("{:016x}{:016x}", fmix64(hash.h0), fmix64(hash.h1 ^ hash.h0));
+}
+
+bool Cache::load_spirv(const std::string& key, SpirvBlob& out_blob) const {
+    std::string data;
+    if (!load(*this, key, CACHE_SPIRV, data)) {
+        return false;
+    }
+    CacheReader r(data);
+    if (!read_header(r, CACHE_SPIRV)) {
+        return false;
+    }
+    std::vector<uint32_t> bytecode = r.bytes<uint32_t>();
+    if (!r.done()) {
+        return false;
+    }
+    out_blob.bytecode = std::move(bytecode);
+    return true;
+}
+
+bool Cache::load_source(const std::string& key, SpirvcrossSource& out_src) const {
+    std::string data;
+    if (!load(*this, key, CACHE_SOURCE, data)) {
+        return false;
+    }
+    CacheReader r(data);
+    if (!read_header(r, CACHE_SOURCE)) {
+        return false;
+    }
+    std::string source_code = r.str();
+    StageReflection stage_refl = read_stage_refl(r);
+    if (!r.done()) {
+        return false;
+    }
+    // snippet indices are not part of the cache key, these are patched by the caller
+    out_src.valid = true;
+    out_src.source_code = std::move(source_code);
+    out_src.stage_refl = std::move(stage_refl);
+    out_src.stage_refl.snippet_index = out_src.snippet_index;
+    return true;
+}
+
+bool Cache::load_bytecode(const std::string& key, BytecodeBlob& out_blob) const {
+    std::string data;
+    if (!load(*this, key, CACHE_BYTECODE, data)) {
+        return false;
+    }
+    CacheReader r(data);
+    if (!read_header(r, CACHE_BYTECODE)) {
+        return false;
+    }
+    std::vector<uint8_t> bytes = r.bytes<uint8_t>();
+    if (!r.done()) {
+        return false;
+    }
+    out_blob.valid = true;
+    out_blob.data = std::move(bytes);
+    return true;
+}
+
+void Cache::store_spirv(const std::string& key, const SpirvBlob& blob) const {
+    CacheWriter w;
+    write_header(w, CACHE_SPIRV);
+    w.bytes(blob.bytecode.data(), blob.bytecode.size() * sizeof(uint32_t));
+    store(*this, key, CACHE_SPIRV, w.data);
+}
+
+void Cache::store_source(const std::string& key, const SpirvcrossSource& src) const {
+    CacheWriter w;
+    write_header(w, CACHE_SOURCE);
+    w.str(src.source_code);
+    write_stage_refl(w, src.stage_refl);
+    store(*this, key, CACHE_SOURCE, w.data);
+}
+
+void Cache::store_bytecode(const std::string& key, const BytecodeBlob& blob) const {
+    CacheWriter w;
+    write_header(w, CACHE_BYTECODE);
+    w.bytes(blob.data.data(), blob.data.size());
+    store(*this, key, CACHE_BYTECODE, w.data);
+}
+
+void Cache::trim() const {
+    // never delete files from a directory which isn't owned by the cache
+    if (dir.empty() || !has_cache_marker(dir)) {
+        return;
+    }
+    struct Entry {
+        fs::path path;
+        fs::file_time_type time;
+        uint64_t size;
+    };
+    std::vector<Entry> entries;
+    uint64_t total_size = 0;
+    // NOTE: other processes may add or remove files at the same time, so all
+    // errors are ignored, and files which have disappeared are skipped
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && (it != end); it.increment(ec)) {
+        std::error_code entry_ec;
+        if (!it->is_regular_file(entry_ec) || !is_cache_filename(it->path().filename().string())) {
+            continue;
+        }
+        Entry entry;
+        entry.path = it->path();
+        entry.time = it->last_write_time(entry_ec);
+        entry.size = entry_ec ? 0 : it->file_size(entry_ec);
+        if (!entry_ec) {
+            total_size += entry.size;
+            entries.push_back(std::move(entry));
+        }
+    }
+    if (total_size <= max_size) {
+        return;
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.time < b.time;
+    });
+    for (const Entry& entry: entries) {
+        if (total_size <= max_size) {
+            break;
+        }
+        if (fs::remove(entry.path, ec)) {
+            total_size -= entry.size;
+        }
+    }
+}
+
+} // namespace shdc
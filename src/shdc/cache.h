@@ -0,0 +1,58 @@
+#pragma once
+#include <assert.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include "types/errmsg.h"
+#include "types/slang.h"
+#include "types/spirv_blob.h"
+#include "types/spirvcross_source.h"
+#include "types/bytecode_blob.h"
+
+namespace shdc {
+
+struct CacheMemory;
+struct CacheManifest;
+
+// content-addressed on-disk cache for compilation artifacts (see --cache-dir),
+// cache files are written atomically so that concurrent sokol-shdc processes
+// can safely share the same cache directory
+struct Cache {
+    // bump when the cache file format or the code generation changes, the commit
+    // hashes of sokol-tools and the shader compiler dependencies are part of all
+    // cache keys in builds from a git checkout (see key())
+    static constexpr uint32_t Version = 1;
+
+    ErrMsg error;
+    std::string dir;            // cache directory (the sokol-shdc subdirectory of --cache-dir), empty if the on-disk cache is disabled
+    uint64_t max_size = 0;      // max size of all cache files in bytes
+    std::shared_ptr<CacheMemory> memory;    // optional in-memory cache layer
+    std::shared_ptr<CacheManifest> manifest;    // optional per-output manifest (see --incremental)
+
+    // the in-memory layer is used by long-running processes (server mode)
+    static Cache open(const std::string& dir, uint64_t max_size, bool in_memory = false);
+    // return a copy of the cache with a manifest loaded from path, which verifies the content
+    // of the cache entries, the entries are stored in private_dir if the cache has no directory
+    Cache with_manifest(const std::string& path, const std::string& private_dir) const;
+    // write the names and content hashes of all entries used since with_manifest() (only if
+    // the manifest has changed), and remove all other entries from the private directory
+    void save_manifest() const;
+    bool enabled() const;
+    // build a cache key from a description of all inputs which affect an artifact,
+    // and the cache and build version
+    static std::string key(const std::string& inputs);
+
+    // lookup functions return false on cache miss, and update the access time on hit
+    bool load_spirv(const std::string& key, SpirvBlob& out_blob) const;
+    bool load_source(const std::string& key, SpirvcrossSource& out_src) const;
+    bool load_bytecode(const std::string& key, BytecodeBlob& out_blob) const;
+    // store functions silently ignore errors, the cache is only an optimization
+    void store_spirv(const std::string& key, const SpirvBlob& blob) const;
+    void store_source(const std::string& key, const SpirvcrossSource& src) const;
+    void store_bytecode(const std::string& key, const BytecodeBlob& blob) const;
+    // evict least recently used cache files until the on-disk cache is below max_size,
+    // only files with cache file names in a directory with the cache marker file are removed
+    void trim() const;
+};
+
+} // namespace shdc
@@ -10,27 +10,17 @@ namespace shdc::gen {
 
 using namespace refl;
 
-static ErrMsg write_file(const std::string& file_path, const SpirvcrossSource* src, const BytecodeBlob* blob) {
-    FILE* f = fopen(file_path.c_str(), "wb");
-    if (f == nullptr) {
-        return ErrMsg::error(file_path, 0, fmt::format("failed to open output file '{}'", file_path));
-    }
-    const void* write_data;
-    size_t write_count;
+ErrMsg BareGenerator::write_file(const GenInput& gen, const std::string& file_path, const SpirvcrossSource* src, const BytecodeBlob* blob) {
+    std::string data;
     if (blob) {
-        write_data = blob->data.data();
-        write_count = blob->data.size();
+        data.assign((const char*)blob->data.data(), blob->data.size());
     } else {
         assert(src);
-        write_data = src->source_code.data();
-        write_count = src->source_code.length();
+        data = src->source_code;
     }
-    size_t written = fwrite(write_data, 1, write_count, f);
-    if (written != write_count) {
-        fclose(f);
+    if (!write_output(gen, file_path, data, false)) {
         return ErrMsg::error(file_path, 0, fmt::format("failed to write output file '{}'", file_path));
     }
-    fclose(f);
     return ErrMsg();
 }
 
@@ -52,7 +42,7 @@ ErrMsg BareGenerator::generate(const GenInput& gen) {
                     const SpirvcrossSource* src = spirvcross.find_source_by_snippet_index(refl.snippet_index);
                     const BytecodeBlob* blob = bytecode.find_blob_by_snippet_index(refl.snippet_index);
                     const std::string file_path = shader_file_path(gen, prog.name, refl.stage_name, slang, blob != nullptr);
-                    err = write_file(file_path, src, blob);
+                    err = write_file(gen, file_path, src, blob);
                     if (err.valid()) {
                         return err;
                     }
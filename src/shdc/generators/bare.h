@@ -11,6 +11,7 @@ protected:
     std::string shader_file_path(const GenInput& gen, const std::string& prog_name, const std::string& stage_name, Slang::Enum slang, bool is_blob);
 private:
     ErrMsg gen_shader_sources_and_blobs(const GenInput& gen, Slang::Enum slang);
+    ErrMsg write_file(const GenInput& gen, const std::string& file_path, const SpirvcrossSource* src, const BytecodeBlob* blob);
 };
 
 } // namespace
@@ -12,7 +12,11 @@
 #include "sokold.h"
 #include "sokoljai.h"
 #include "yaml.h"
+#include "jobs.h"
+#include "timings.h"
+#include "memstats.h"
 #include <memory>
+#include <vector>
 
 namespace shdc::gen {
 
@@ -43,4 +47,38 @@ ErrMsg generate(Format::Enum format, const GenInput& gen_input) {
     return make_generator(format)->generate(gen_input);
 }
 
+ErrMsg generate_all(const GenInput& gen_input) {
+    Timings::Scope timing("generate");
+    MemStats::Scope mem_stage(MemStats::GENERATE);
+    // each generator gets a copy of the args with its own output format and path,
+    // everything else in GenInput is shared and only read by the generators
+    const Args& args = gen_input.args;
+    std::vector<Args> format_args(1 + args.extra_outputs.size(), args);
+    for (size_t i = 0; i < args.extra_outputs.size(); i++) {
+        format_args[i + 1].output_format = args.extra_outputs[i].format;
+        format_args[i + 1].output = args.extra_outputs[i].path;
+    }
+    std::vector<std::vector<OutputFile>> output_files(format_args.size());
+    std::vector<ErrMsg> errors(format_args.size());
+    Jobs::run(args.num_jobs, (int)format_args.size(), [&gen_input, &format_args, &output_files, &errors](int i) {
+        GenInput gen(format_args[i], gen_input.inp, gen_input.spirvcross, gen_input.bytecode, gen_input.refl);
+        if (gen_input.output_files) {
+            gen.output_files = &output_files[i];
+        }
+        errors[i] = generate(format_args[i].output_format, gen);
+    });
+    // in-memory files and errors are returned in --format order
+    if (gen_input.output_files) {
+        for (const std::vector<OutputFile>& files: output_files) {
+            gen_input.output_files->insert(gen_input.output_files->end(), files.begin(), files.end());
+        }
+    }
+    for (const ErrMsg& err: errors) {
+        if (err.valid()) {
+            return err;
+        }
+    }
+    return ErrMsg();
+}
+
 } // namespace
\ No newline at end of file
@@ -6,5 +6,8 @@
 namespace shdc::gen {
 
 ErrMsg generate(Format::Enum format, const GenInput& gen_input);
+// run the code generators for the output format and all extra output formats
+// of gen_input.args in parallel over the same compilation results
+ErrMsg generate_all(const GenInput& gen_input);
 
 }
@@ -2,6 +2,8 @@
     Generator base class implementation.
 */
 #include "generator.h"
+#include "output.h"
+#include "timings.h"
 #include "pystring.h"
 
 using namespace shdc::refl;
@@ -9,26 +11,36 @@ using namespace shdc::refl;
 namespace shdc::gen {
 
 ErrMsg Generator::generate(const GenInput& gen) {
+    // each generator step is a separate --timings stage
+    const char* format_name = Format::to_str(gen.args.output_format);
+    const auto step = [this, &gen, format_name](const char* name, void (Generator::*step_func)(const GenInput&)) {
+        Timings::Scope timing(name, format_name);
+        (this->*step_func)(gen);
+    };
     ErrMsg err;
-    err = begin(gen);
+    {
+        Timings::Scope timing("gen_begin", format_name);
+        err = begin(gen);
+    }
     if (err.valid()) {
         return err;
     }
-    gen_prolog(gen);
-    gen_header(gen);
-    gen_prerequisites(gen);
-    gen_vertex_attr_consts(gen);
-    gen_bind_slot_consts(gen);
-    gen_uniform_block_decls(gen);
-    gen_storage_buffer_decls(gen);
-    gen_stb_impl_start(gen);
-    gen_shader_arrays(gen);
-    gen_shader_desc_funcs(gen);
+    step("gen_prolog", &Generator::gen_prolog);
+    step("gen_header", &Generator::gen_header);
+    step("gen_prerequisites", &Generator::gen_prerequisites);
+    step("gen_vertex_attr_consts", &Generator::gen_vertex_attr_consts);
+    step("gen_bind_slot_consts", &Generator::gen_bind_slot_consts);
+    step("gen_uniform_block_decls", &Generator::gen_uniform_block_decls);
+    step("gen_storage_buffer_decls", &Generator::gen_storage_buffer_decls);
+    step("gen_stb_impl_start", &Generator::gen_stb_impl_start);
+    step("gen_shader_arrays", &Generator::gen_shader_arrays);
+    step("gen_shader_desc_funcs", &Generator::gen_shader_desc_funcs);
     if (gen.args.reflection) {
-        gen_reflection_funcs(gen);
+        step("gen_reflection_funcs", &Generator::gen_reflection_funcs);
     }
-    gen_epilog(gen);
-    gen_stb_impl_end(gen);
+    step("gen_epilog", &Generator::gen_epilog);
+    step("gen_stb_impl_end", &Generator::gen_stb_impl_end);
+    Timings::Scope timing("gen_end", format_name);
     err = end(gen);
     return err;
 }
@@ -186,7 +198,7 @@ void Generator::gen_shader_arrays(const GenInput& gen) {
             const Bytecode& bytecode = gen.bytecode[slang];
             for (int snippet_index = 0; snippet_index < (int)gen.inp.snippets.size(); snippet_index++) {
                 const Snippet& snippet = gen.inp.snippets[snippet_index];
-                if ((snippet.type != Snippet::VS) && (snippet.type != Snippet::FS)) {
+                if (!snippet.reachable || ((snippet.type != Snippet::VS) && (snippet.type != Snippet::FS))) {
                     continue;
                 }
                 const SpirvcrossSource* src = spirvcross.find_source_by_snippet_index(snippet_index);
@@ -254,34 +266,43 @@ void Generator::gen_reflection_funcs(const GenInput& gen) {
     }
 }
 
-// default behaviour of end() is to write the output file
+bool Generator::write_output(const GenInput& gen, const std::string& path, const std::string& data, bool text) {
+    if (gen.output_files) {
+        gen.output_files->push_back({ path, data, text });
+        return true;
+    }
+    return Output::write_if_changed(path, data, text);
+}
+
+// default behaviour of end() is to write the output file (only if the content has changed)
 ErrMsg Generator::end(const GenInput& gen) {
-    FILE* f = fopen(gen.args.output.c_str(), "w");
-    if (!f) {
-        return ErrMsg::error(gen.inp.base_path, 0, fmt::format("failed to open output file '{}'", gen.args.output));
+    if (!write_output(gen, gen.args.output, content, true)) {
+        return ErrMsg::error(gen.inp.base_path, 0, fmt::format("failed to write output file '{}'", gen.args.output));
     }
-    fwrite(content.c_str(), content.length(), 1, f);
-    fclose(f);
     return ErrMsg();
 }
 
 // check that each input shader has a vs and fs source
 ErrMsg Generator::check_errors(const GenInput& gen) {
+    Timings::Scope timing("check_errors");
     for (int i = 0; i < Slang::Num; i++) {
         Slang::Enum slang = Slang::from_index(i);
         if (gen.args.slang & Slang::bit(slang)) {
+            // one pass over the sources instead of a source lookup per program
+            std::vector<bool> has_source(gen.inp.snippets.size(), false);
+            for (const SpirvcrossSource& src: gen.spirvcross[i].sources) {
+                has_source[src.snippet_index] = true;
+            }
             for (const auto& item: gen.inp.programs) {
                 const Program& prog = item.second;
                 int vs_snippet_index = gen.inp.snippet_map.at(prog.vs_name);
                 int fs_snippet_index = gen.inp.snippet_map.at(prog.fs_name);
-                const SpirvcrossSource* vs_src = gen.spirvcross[i].find_source_by_snippet_index(vs_snippet_index);
-                const SpirvcrossSource* fs_src = gen.spirvcross[i].find_source_by_snippet_index(fs_snippet_index);
-                if (vs_src == nullptr) {
+                if (!has_source[vs_snippet_index]) {
                     return gen.inp.error(gen.inp.snippets[vs_snippet_index].lines[0],
                         fmt::format("no generated '{}' source for vertex shader '{}' in program '{}'",
                         Slang::to_str(slang), prog.vs_name, prog.name));
                 }
-                if (fs_src == nullptr) {
+                if (!has_source[fs_snippet_index]) {
                     return gen.inp.error(gen.inp.snippets[vs_snippet_index].lines[0],
                         fmt::format("no generated '{}' source for fragment shader '{}' in program '{}'",
                         Slang::to_str(slang), prog.fs_name, prog.name));
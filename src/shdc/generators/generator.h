@@ -12,6 +12,9 @@ public:
     virtual ErrMsg generate(const GenInput& gen);
 
 protected:
+    // write an output file, or add it to GenInput::output_files
+    static bool write_output(const GenInput& gen, const std::string& path, const std::string& data, bool text);
+
     // called directly by generate() in this order
     virtual ErrMsg begin(const GenInput& gen);
     virtual void gen_prolog(const GenInput& gen);
@@ -20,7 +20,7 @@ void SokolNimGenerator::gen_shader_arrays(const GenInput& gen) {
             const Bytecode& bytecode = gen.bytecode[slang];
             for (int snippet_index = 0; snippet_index < (int)gen.inp.snippets.size(); snippet_index++) {
                 const Snippet& snippet = gen.inp.snippets[snippet_index];
-                if ((snippet.type != Snippet::VS) && (snippet.type != Snippet::FS)) {
+                if (!snippet.reachable || ((snippet.type != Snippet::VS) && (snippet.type != Snippet::FS))) {
                     continue;
                 }
                 const SpirvcrossSource* src = spirvcross.find_source_by_snippet_index(snippet_index);
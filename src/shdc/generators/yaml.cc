@@ -103,12 +103,9 @@ ErrMsg YamlGenerator::generate(const GenInput& gen) {
 
     // write result into output file
     const std::string file_path = fmt::format("{}_{}reflection.yaml", gen.args.output, mod_prefix);
-    FILE* f = fopen(file_path.c_str(), "w");
-    if (!f) {
-        return ErrMsg::error(gen.inp.base_path, 0, fmt::format("failed to open output file '{}'", file_path));
+    if (!write_output(gen, file_path, content, true)) {
+        return ErrMsg::error(gen.inp.base_path, 0, fmt::format("failed to write output file '{}'", file_path));
     }
-    fwrite(content.c_str(), content.length(), 1, f);
-    fclose(f);
     return ErrMsg();
 }
 
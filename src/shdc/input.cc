@@ -4,9 +4,14 @@
 #include "input.h"
 #include "types/reflection/type.h"
 #include "types/option.h"
+#include "timings.h"
+#include "memstats.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include <assert.h>
+#include <algorithm>
 #include "fmt/format.h"
 #include "pystring.h"
 
@@ -22,14 +27,56 @@ static std::string load_file_into_str(const std::string& path) {
     fseek(f, 0, SEEK_END);
     const size_t file_size = ftell(f);
     fseek(f, 0, SEEK_SET);
-    char* buf = (char*) malloc(file_size + 1);
-    fread((void*)buf, file_size, 1, f);
-    buf[file_size] = 0;
-    std::string str(buf);
-    free((void*)buf);
+    // NOTE: also used for binary @spirv files, so don't stop at the first zero byte
+    std::string str(file_size, 0);
+    if (file_size > 0) {
+        fread(&str[0], file_size, 1, f);
+    }
+    fclose(f);
     return str;
 }
 
+// split a string into lines like pystring::splitlines(), but without copying
+static void split_lines(std::string_view str, std::vector<std::string_view>& out_lines) {
+    out_lines.clear();
+    size_t pos = 0;
+    while (pos < str.size()) {
+        size_t end = pos;
+        while ((end < str.size()) && (str[end] != '\n') && (str[end] != '\r')) {
+            end++;
+        }
+        out_lines.push_back(str.substr(pos, end - pos));
+        if ((end + 1 < str.size()) && (str[end] == '\r') && (str[end + 1] == '\n')) {
+            end++;
+        }
+        pos = end + 1;
+    }
+}
+
+// split a line at whitespace like pystring::split(), the token strings are
+// reused so that tokenizing line after line doesn't allocate
+static void split_tokens(std::string_view line, std::vector<std::string>& out_tokens) {
+    size_t num_tokens = 0;
+    size_t pos = 0;
+    while (pos < line.size()) {
+        while ((pos < line.size()) && isspace((unsigned char)line[pos])) {
+            pos++;
+        }
+        if (pos == line.size()) {
+            break;
+        }
+        const size_t start = pos;
+        while ((pos < line.size()) && !isspace((unsigned char)line[pos])) {
+            pos++;
+        }
+        if (num_tokens == out_tokens.size()) {
+            out_tokens.emplace_back();
+        }
+        out_tokens[num_tokens++].assign(line.data() + start, pos - start);
+    }
+    out_tokens.resize(num_tokens);
+}
+
 /* removes comments from string
     - FIXME: doesn't detect block-comment in block-comment bugs
     - also removes comments in string literals (no problem for shader langs)
@@ -110,8 +157,9 @@ static const std::string msl_options_tag = "@msl_options";
 static const std::string include_tag = "@include";
 static const std::string image_sample_type_tag = "@image_sample_type";
 static const std::string sampler_type_tag = "@sampler_type";
+static const std::string spirv_tag = "@spirv";
 
-static bool normalize_pragma_sokol(std::vector<std::string>& toks, std::string &line, int line_index, Input& inp) {
+static bool normalize_pragma_sokol(std::vector<std::string>& toks, std::string_view& line, int line_index, Input& inp) {
     // Returns true if it saw no errors, even if it did nothing.
     // If it sees #pragma sokol, it modifies both `toks` and `line`
     // in-place so that they no longer contain them.
@@ -139,8 +187,8 @@ static bool normalize_pragma_sokol(std::vector<std::string>& toks, std::string &
     // We don't know where in the line itself this is, so just drop everything
     // before the first @.
     auto at_pos = line.find('@');
-    assert(at_pos != std::string::npos);
-    line.erase(line.begin(), line.begin() + at_pos);
+    assert(at_pos != std::string_view::npos);
+    line.remove_prefix(at_pos);
     return true;;
 }
 
@@ -348,6 +396,33 @@ static bool validate_sampler_type_tag(const std::vector<std::string>& tokens, co
 
 }
 
+static bool validate_spirv_tag(const std::vector<std::string>& tokens, const Snippet& cur_snippet, int line_index, Input& inp) {
+    if (tokens.size() != 2) {
+        inp.out_error = inp.error(line_index, "@spirv tag must have exactly one arg (@spirv path).");
+        return false;
+    }
+    if ((cur_snippet.type != Snippet::VS) && (cur_snippet.type != Snippet::FS)) {
+        inp.out_error = inp.error(line_index, "@spirv tag must be inside a @vs or @fs block");
+        return false;
+    }
+    if (!cur_snippet.spirv_path.empty()) {
+        inp.out_error = inp.error(line_index, "only one @spirv tag per @vs or @fs block allowed.");
+        return false;
+    }
+    return true;
+}
+
+// a @vs or @fs block with a @spirv tag must not contain any GLSL code
+static bool validate_spirv_snippet(const Snippet& snippet, Input& inp) {
+    for (int line_index : snippet.lines) {
+        if (inp.lines[line_index].line.find_first_not_of(" \t\r\n\v\f") != std::string_view::npos) {
+            inp.out_error = inp.error(line_index, fmt::format("@{} '{}' has a @spirv tag and can't contain GLSL code.", Snippet::type_to_str(snippet.type), snippet.name));
+            return false;
+        }
+    }
+    return true;
+}
+
 /* This parses the split input line array for custom tags (@vs, @fs, @block,
     @end and @program), and fills the respective members. If a parsing error
     happens, the inp.error object is setup accordingly.
@@ -356,12 +431,13 @@ static bool parse(Input& inp) {
     bool in_snippet = false;
     bool add_line = false;
     Snippet cur_snippet;
+    int spirv_line_index = -1;
     std::vector<std::string> tokens;
     int line_index = 0;
     for (const Line& line_info : inp.lines) {
-        const std::string& line = line_info.line;
+        const std::string_view line = line_info.line;
         add_line = in_snippet;
-        pystring::split(line, tokens);
+        split_tokens(line, tokens);
         if (tokens.size() > 0) {
             if (tokens[0] == module_tag) {
                 if (!validate_module_tag(tokens, in_snippet, line_index, inp)) {
@@ -442,14 +518,19 @@ static bool parse(Input& inp) {
                     return false;
                 }
                 const Snippet& src_snippet = inp.snippets[inp.snippet_map[tokens[1]]];
-                for (int line_index : src_snippet.lines) {
-                    cur_snippet.lines.push_back(line_index);
-                }
+                cur_snippet.lines.insert(cur_snippet.lines.end(), src_snippet.lines.begin(), src_snippet.lines.end());
                 add_line = false;
             } else if (tokens[0] == end_tag) {
                 if (!validate_end_tag(tokens, in_snippet, line_index, inp)) {
                     return false;
                 }
+                if (!cur_snippet.spirv_path.empty()) {
+                    if (!validate_spirv_snippet(cur_snippet, inp)) {
+                        return false;
+                    }
+                    // error messages for precompiled snippets point to the @spirv tag
+                    cur_snippet.lines = { spirv_line_index };
+                }
                 cur_snippet.index = (int)inp.snippets.size();
                 inp.snippet_map[cur_snippet.name] = cur_snippet.index;
                 switch (cur_snippet.type) {
@@ -486,6 +567,16 @@ static bool parse(Input& inp) {
                 }
                 cur_snippet.sampler_type_tags[tokens[1]] = SamplerTypeTag(tokens[1], SamplerType::from_str(tokens[2]), line_index);
                 add_line = false;
+            } else if (tokens[0] == spirv_tag) {
+                if (!validate_spirv_tag(tokens, cur_snippet, line_index, inp)) {
+                    return false;
+                }
+                // the path is relative to the file which contains the @spirv tag
+                std::string dir, filename;
+                pystring::os::path::split(dir, filename, inp.filenames[line_info.filename]);
+                cur_snippet.spirv_path = pystring::os::path::join(dir, tokens[1]);
+                spirv_line_index = line_index;
+                add_line = false;
             } else if (tokens[0][0] == '@') {
                 inp.out_error = inp.error(line_index, fmt::format("unknown meta tag: {}", tokens[0]));
                 return false;
@@ -511,15 +602,26 @@ static bool validate_include_tag(const std::vector<std::string>& tokens, int lin
     return true;
 }
 
+static std::string load_file(const std::string& path, const Input::FileLoader& loader) {
+    if (loader) {
+        std::string str;
+        if (!loader(path, str)) {
+            str.clear();
+        }
+        return str;
+    }
+    return load_file_into_str(path);
+}
+
 static bool load_and_preprocess(const std::string& path, const std::vector<std::string>& include_dirs,
-                                Input& inp, int parent_line_index) {
+                                Input& inp, int parent_line_index, const Input::FileLoader& loader) {
     std::string path_used = path;
-    std::string str = load_file_into_str(path_used);
+    std::string str = load_file(path_used, loader);
     if (str.empty()) {
         // check include directories
         for (const std::string& include_dir : include_dirs) {
             path_used = pystring::os::path::join(include_dir, path);
-            str = load_file_into_str(path_used);
+            str = load_file(path_used, loader);
             if (!str.empty()) {
                 break;
             }
@@ -550,16 +652,20 @@ static bool load_and_preprocess(const std::string& path, const std::vector<std::
         inp.out_error = ErrMsg::error(path_used, 0, fmt::format("(FIXME) Error during removing comments in '{}'", path_used));
     }
 
+    // the source is kept alive by the Input, lines are views into it
+    inp.sources.push_back(std::make_shared<const std::string>(std::move(str)));
+    const std::string& src = *inp.sources.back();
+
     // split source file into lines
     int line_index = 0;
-    std::vector<std::string> lines;
-    pystring::splitlines(str, lines);
+    std::vector<std::string_view> lines;
+    split_lines(src, lines);
 
     // preprocess
     std::vector<std::string> tokens;
-    for (std::string& line : lines) {
+    for (std::string_view line : lines) {
         // look for @include tags
-        pystring::split(line, tokens);
+        split_tokens(line, tokens);
         if (tokens.size() > 0) {
             if (!normalize_pragma_sokol(tokens, line, line_index, inp)) {
                 return false;
@@ -570,7 +676,7 @@ static bool load_and_preprocess(const std::string& path, const std::vector<std::
                 }
                 // insert included file
                 const std::string& include_filename = tokens[1];
-                if (!load_and_preprocess(include_filename, include_dirs, inp, line_index)) {
+                if (!load_and_preprocess(include_filename, include_dirs, inp, line_index, loader)) {
                     return false;
                 }
             } else {
@@ -588,10 +694,75 @@ static bool load_and_preprocess(const std::string& path, const std::vector<std::
     return true;
 }
 
+// check that a @spirv file is a SPIRV module with an entry point for the snippet's shader stage
+static bool validate_spirv_module(const Snippet& snippet, const std::vector<uint32_t>& words) {
+    const uint32_t spv_magic = 0x07230203;
+    const uint32_t spv_op_entry_point = 15;
+    const uint32_t exec_model = (snippet.type == Snippet::VS) ? 0 : 4;  // ExecutionModelVertex or ExecutionModelFragment
+    if ((words.size() < 5) || (words[0] != spv_magic)) {
+        return false;
+    }
+    size_t pos = 5;
+    while (pos < words.size()) {
+        const uint32_t opcode = words[pos] & 0xFFFF;
+        const uint32_t word_count = words[pos] >> 16;
+        if ((word_count == 0) || ((pos + word_count) > words.size())) {
+            return false;
+        }
+        if ((opcode == spv_op_entry_point) && (word_count > 1) && (words[pos + 1] == exec_model)) {
+            return true;
+        }
+        pos += word_count;
+    }
+    return false;
+}
+
+/* load the precompiled SPIRV modules of all @vs and @fs snippets with a @spirv tag,
+   the @spirv files are added to the input filenames (for depfiles and --watch)
+*/
+static bool load_spirv_modules(Input& inp, const Input::FileLoader& loader) {
+    for (Snippet& snippet : inp.snippets) {
+        if (snippet.spirv_path.empty()) {
+            continue;
+        }
+        const std::string data = load_file(snippet.spirv_path, loader);
+        if (data.empty()) {
+            inp.out_error = inp.error(snippet.lines[0], fmt::format("Failed to open @spirv file '{}'", snippet.spirv_path));
+            return false;
+        }
+        if ((data.size() % sizeof(uint32_t)) == 0) {
+            snippet.spirv.resize(data.size() / sizeof(uint32_t));
+            memcpy(snippet.spirv.data(), data.data(), data.size());
+        }
+        if (!validate_spirv_module(snippet, snippet.spirv)) {
+            inp.out_error = inp.error(snippet.lines[0], fmt::format("@spirv file '{}' is not a SPIRV module with a {} shader entry point", snippet.spirv_path, (snippet.type == Snippet::VS) ? "vertex" : "fragment"));
+            return false;
+        }
+        if (std::find(inp.filenames.begin(), inp.filenames.end(), snippet.spirv_path) == inp.filenames.end()) {
+            inp.filenames.push_back(snippet.spirv_path);
+        }
+    }
+    return true;
+}
+
+/* mark @vs and @fs snippets which are not used by any @program as unreachable,
+   these are skipped by compilation, translation and code generation
+*/
+static void mark_reachable_snippets(Input& inp) {
+    for (Snippet& snippet : inp.snippets) {
+        snippet.reachable = (snippet.type == Snippet::BLOCK);
+    }
+    for (const auto& item : inp.programs) {
+        inp.snippets[inp.vs_map.at(item.second.vs_name)].reachable = true;
+        inp.snippets[inp.fs_map.at(item.second.fs_name)].reachable = true;
+    }
+}
+
 /* load file and parse into an Input object,
    check valid and error fields in returned object
 */
-Input Input::load_and_parse(const std::string& path, const std::string& module_override) {
+Input Input::load_and_parse(const std::string& path, const std::string& module_override, const FileLoader& loader) {
+    MemStats::Scope mem_stage(MemStats::INPUT);
     std::string dir;
     std::string filename;
     pystring::os::path::split(dir, filename, path);
@@ -599,8 +770,16 @@ Input Input::load_and_parse(const std::string& path, const std::string& module_o
 
     Input inp;
     inp.base_path = path;
-    if (load_and_preprocess(path, include_dirs, inp, 0)) {
-        parse(inp);
+    bool loaded = false;
+    {
+        Timings::Scope timing("load_and_preprocess", path.c_str());
+        loaded = load_and_preprocess(path, include_dirs, inp, 0, loader);
+    }
+    if (loaded) {
+        Timings::Scope timing("parse", path.c_str());
+        if (parse(inp) && load_spirv_modules(inp, loader)) {
+            mark_reachable_snippets(inp);
+        }
     }
     if (!module_override.empty()) {
         inp.module = module_override;
@@ -608,6 +787,23 @@ Input Input::load_and_parse(const std::string& path, const std::string& module_o
     return inp;
 }
 
+ErrMsg Input::select_programs(const std::vector<std::string>& names) {
+    for (const std::string& name : names) {
+        if (programs.count(name) == 0) {
+            return ErrMsg::error(base_path, 0, fmt::format("@program '{}' not found (--programs)", name));
+        }
+    }
+    for (auto it = programs.begin(); it != programs.end();) {
+        if (std::find(names.begin(), names.end(), it->first) == names.end()) {
+            it = programs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    mark_reachable_snippets(*this);
+    return ErrMsg();
+}
+
 ErrMsg Input::error(int line_index, const std::string& msg) const {
     if (line_index < (int)lines.size()) {
         const Line& line = lines[line_index];
@@ -657,6 +853,10 @@ void Input::dump_debug(ErrMsg::Format err_fmt) const {
             fmt::print(stderr, "    snippet {}:\n", snippet_nr++);
             fmt::print(stderr, "      name: {}\n", snippet.name);
             fmt::print(stderr, "      type: {}\n", Snippet::type_to_str(snippet.type));
+            fmt::print(stderr, "      reachable: {}\n", snippet.reachable);
+            if (!snippet.spirv_path.empty()) {
+                fmt::print(stderr, "      spirv: {} ({} words)\n", snippet.spirv_path, snippet.spirv.size());
+            }
             fmt::print(stderr, "      image sample type tags:\n");
             for (const auto& [key, val]: snippet.image_sample_type_tags) {
                 fmt::print(stderr, "        {}: {} (line: {})\n", key, ImageSampleType::to_str(val.type), val.line_index);
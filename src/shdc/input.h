@@ -2,6 +2,8 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <functional>
+#include <memory>
 #include "types/errmsg.h"
 #include "types/line.h"
 #include "types/snippet.h"
@@ -11,11 +13,16 @@ namespace shdc {
 
 // pre-parsed GLSL source file, with content split into snippets
 struct Input {
+    // optional virtual file loader for the input file and @include files, gets
+    // called with each candidate path and returns false if the file doesn't exist
+    typedef std::function<bool(const std::string& path, std::string& out_content)> FileLoader;
+
     ErrMsg out_error;
     std::string base_path;              // path to base file
     std::string module;                 // optional module name
-    std::vector<std::string> filenames; // all source files, base is first entry
-    std::vector<Line> lines;          // input source files split into lines
+    std::vector<std::string> filenames; // all source files (and @spirv files), base is first entry
+    std::vector<std::shared_ptr<const std::string>> sources;    // comment-stripped source files, shared by copies of the Input
+    std::vector<Line> lines;          // input source files split into lines (views into sources)
     std::vector<Snippet> snippets;    // @block, @vs and @fs snippets
     std::map<std::string, std::string> ctype_map;    // @ctype uniform type definitions
     std::vector<std::string> headers;       // @header statements
@@ -25,7 +32,9 @@ struct Input {
     std::map<std::string, int> fs_map;      // name-index mapping for @fs snippets
     std::map<std::string, Program> programs;    // all @program definitions
 
-    static Input load_and_parse(const std::string& path, const std::string& module_override);
+    static Input load_and_parse(const std::string& path, const std::string& module_override, const FileLoader& loader = nullptr);
+    // only keep the named @programs, the @vs and @fs snippets of all other programs become unreachable (--programs)
+    ErrMsg select_programs(const std::vector<std::string>& names);
     ErrMsg error(int line_index, const std::string& msg) const;
     ErrMsg warning(int line_index, const std::string& msg) const;
     void dump_debug(ErrMsg::Format err_fmt) const;
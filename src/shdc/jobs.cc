@@ -0,0 +1,543 @@
+/*
+    A minimal worker pool, tasks are handed out to threads in order, the
+    calling thread participates as a worker.
+
+    A top-level Jobs::run() call starts the pool threads, nested calls from
+    inside a task (e.g. the per-snippet compilation inside a --batch job)
+    add their tasks as a new group to the same pool: the calling thread
+    works on its own group, idle pool threads help out (newest group first),
+    and more threads are started as long as the pool has less than --jobs
+    threads. This way a few big jobs still use all cores.
+
+    When running under GNU make with a jobserver (MAKEFLAGS contains
+    --jobserver-auth=fifo:PATH, --jobserver-auth=R,W or a Windows semaphore
+    name), the calling thread holds a token while it runs tasks, and each
+    pool thread must take a token from the jobserver before running a
+    task, the token is returned right after the task has finished. This
+    way a 'make -jN' build never runs more than N compile tasks at the same
+    time, across all processes.
+
+    The calling thread uses the implicit token of the process, unless
+    another thread holds it (e.g. concurrent server requests), then it
+    waits for a token from the jobserver like a pool thread. If the
+    jobserver can't be used (invalid file descriptors, or a shared blocking
+    pipe which can't be reopened as non-blocking), only the implicit token
+    is used, which means all tasks of the process run one at a time (this
+    is reported by --dump).
+
+    Threads which wait for a token block in poll() (or WaitForMultipleObjects()
+    on Windows) on the jobserver together with a wakeup pipe (or semaphore),
+    which is signalled when the last task of the pool has been taken, or
+    when the implicit token is released.
+
+    On platforms without thread support (WASI) all tasks run serially
+    on the calling thread.
+*/
+#include "jobs.h"
+#include "timings.h"
+#include "memstats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <string>
+#include <vector>
+#if !defined(__wasi__)
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif !defined(__wasi__)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace shdc {
+
+// number of threads running a task right now, and the highest number seen so far (tasks
+// which run serially on the calling thread, or nested inside a task, are not counted)
+static std::atomic<int> num_running_tasks(0);
+static std::atomic<int> max_running_tasks(0);
+static thread_local bool in_task = false;
+
+static void run_task(const std::function<void(int task_index)>& task_func, int task_index) {
+    if (in_task) {
+        task_func(task_index);
+        return;
+    }
+    in_task = true;
+    const int num_running = ++num_running_tasks;
+    int max_running = max_running_tasks.load();
+    while ((num_running > max_running) && !max_running_tasks.compare_exchange_weak(max_running, num_running)) { }
+    try {
+        task_func(task_index);
+    } catch (...) {
+        num_running_tasks--;
+        in_task = false;
+        throw;
+    }
+    num_running_tasks--;
+    in_task = false;
+}
+
+// wakes up threads which wait for a jobserver token in acquire_token(), each
+// signal() ends one wait, which must be followed by consume()
+struct Wakeup {
+    #if defined(_WIN32)
+    HANDLE semaphore = NULL;
+    #elif !defined(__wasi__)
+    int fds[2] = { -1, -1 };
+    #endif
+
+    void open() {
+        #if defined(_WIN32)
+        semaphore = CreateSemaphoreA(NULL, 0, LONG_MAX, NULL);
+        #elif !defined(__wasi__)
+        if (pipe(fds) == 0) {
+            for (int fd: fds) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+            }
+        }
+        #endif
+    }
+    void close() {
+        #if defined(_WIN32)
+        if (semaphore) {
+            CloseHandle(semaphore);
+            semaphore = NULL;
+        }
+        #elif !defined(__wasi__)
+        for (int& fd: fds) {
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        #endif
+    }
+    void signal() const {
+        #if defined(_WIN32)
+        ReleaseSemaphore(semaphore, 1, NULL);
+        #elif !defined(__wasi__)
+        const char c = '+';
+        while ((write(fds[1], &c, 1) < 0) && (errno == EINTR)) { }
+        #endif
+    }
+    void consume() const {
+        #if !defined(_WIN32) && !defined(__wasi__)
+        // another waiter may have consumed the signal already (EAGAIN)
+        char c = 0;
+        while ((read(fds[0], &c, 1) < 0) && (errno == EINTR)) { }
+        #endif
+    }
+};
+
+// the GNU make jobserver connection, opened on first use
+struct Jobserver {
+    bool present = false;   // MAKEFLAGS contains a jobserver
+    bool active = false;    // tokens can be taken from the jobserver
+    #if defined(_WIN32)
+    HANDLE semaphore = NULL;
+    #elif !defined(__wasi__)
+    int read_fd = -1;
+    int write_fd = -1;
+    #endif
+    Wakeup implicit_released;   // signalled when the implicit token is released while threads wait for it
+};
+
+// extract the value of the last --jobserver-auth (or older --jobserver-fds) option from MAKEFLAGS
+static std::string jobserver_auth(const char* makeflags) {
+    std::string auth;
+    if (!makeflags) {
+        return auth;
+    }
+    static const char* prefixes[] = { "--jobserver-auth=", "--jobserver-fds=" };
+    const std::string flags(makeflags);
+    size_t pos = 0;
+    while (pos < flags.size()) {
+        size_t end = flags.find(' ', pos);
+        if (end == std::string::npos) {
+            end = flags.size();
+        }
+        const std::string token = flags.substr(pos, end - pos);
+        for (const char* prefix: prefixes) {
+            if (token.compare(0, strlen(prefix), prefix) == 0) {
+                auth = token.substr(strlen(prefix));
+            }
+        }
+        pos = end + 1;
+    }
+    return auth;
+}
+
+// connect to the jobserver, on any error only the implicit token is used
+static Jobserver open_jobserver(const std::string& auth) {
+    Jobserver js;
+    if (auth.empty()) {
+        return js;
+    }
+    #if !defined(__wasi__)
+    js.present = true;
+    js.implicit_released.open();
+    #endif
+    #if defined(_WIN32)
+    js.semaphore = OpenSemaphoreA(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, auth.c_str());
+    js.active = (js.semaphore != NULL);
+    #elif !defined(__wasi__)
+    if (auth.compare(0, 5, "fifo:") == 0) {
+        // the read end is non-blocking so that waiting for a token can be cancelled
+        const std::string path = auth.substr(5);
+        js.read_fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        js.write_fd = (js.read_fd >= 0) ? open(path.c_str(), O_WRONLY | O_CLOEXEC) : -1;
+    } else {
+        int read_fd = -1;
+        int write_fd = -1;
+        if ((sscanf(auth.c_str(), "%d,%d", &read_fd, &write_fd) == 2) && (read_fd >= 0) && (write_fd >= 0) &&
+            (fcntl(read_fd, F_GETFD) != -1) && (fcntl(write_fd, F_GETFD) != -1))
+        {
+            // the pipe is shared with other processes, don't change its file status flags,
+            // instead try to get a private non-blocking open file description for reading,
+            // a blocking read could wait forever after another process took the token
+            // which poll() reported, so without one the jobserver isn't used
+            #if defined(__linux__)
+            const std::string proc_path = "/proc/self/fd/" + std::to_string(read_fd);
+            js.read_fd = open(proc_path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            #endif
+            js.write_fd = (js.read_fd >= 0) ? write_fd : -1;
+        }
+    }
+    js.active = (js.read_fd >= 0) && (js.write_fd >= 0);
+    #endif
+    return js;
+}
+
+static const Jobserver& jobserver() {
+    static const Jobserver js = open_jobserver(jobserver_auth(getenv("MAKEFLAGS")));
+    return js;
+}
+
+// block until a jobserver token was taken (returns true), or until the wakeup was signalled
+// (returns false), without an active jobserver this only waits for the wakeup
+static bool acquire_token(const Jobserver& js, char& out_token, const Wakeup& wakeup) {
+    #if defined(_WIN32)
+    const HANDLE handles[2] = { wakeup.semaphore, js.semaphore };
+    const DWORD res = WaitForMultipleObjects(js.active ? 2 : 1, handles, FALSE, INFINITE);
+    return res == (WAIT_OBJECT_0 + 1);
+    #elif !defined(__wasi__)
+    while (true) {
+        // a negative fd is ignored by poll(), without a wakeup pipe (if it couldn't be
+        // created) return after a timeout, so that the caller checks its state again
+        struct pollfd pfds[2] = { { wakeup.fds[0], POLLIN, 0 }, { js.active ? js.read_fd : -1, POLLIN, 0 } };
+        const int res = poll(pfds, 2, (wakeup.fds[0] >= 0) ? -1 : 10);
+        if (((res < 0) && (errno != EINTR)) || (res == 0)) {
+            return false;
+        }
+        if (pfds[0].revents != 0) {
+            return false;
+        }
+        // another process may have taken the token in the meantime (EAGAIN)
+        if ((pfds[1].revents != 0) && (read(js.read_fd, &out_token, 1) == 1)) {
+            return true;
+        }
+    }
+    #else
+    (void)js; (void)out_token; (void)wakeup;
+    return false;
+    #endif
+}
+
+static void release_token(const Jobserver& js, char token) {
+    #if defined(_WIN32)
+    ReleaseSemaphore(js.semaphore, 1, NULL);
+    #elif !defined(__wasi__)
+    while ((write(js.write_fd, &token, 1) < 0) && (errno == EINTR)) { }
+    #endif
+}
+
+#if !defined(__wasi__)
+// the tasks of one Jobs::run() call
+struct TaskGroup {
+    const std::function<void(int task_index)>* task_func = nullptr;
+    int num_tasks = 0;
+    int next_task = 0;              // guarded by the pool mutex, like the items below
+    int num_done = 0;
+    std::exception_ptr exception;   // only the first exception, rethrown by the calling thread
+    MemStats::Stage mem_stage = MemStats::OTHER;
+};
+
+// the threads of a top-level Jobs::run() call, and the task groups which have tasks left
+struct Pool {
+    std::mutex mutex;
+    std::condition_variable cond;   // a group was added, a group finished, or the pool finished
+    std::vector<TaskGroup*> groups;
+    std::vector<std::thread> threads;
+    int max_threads = 1;            // including the calling thread
+    int num_idle = 0;
+    int num_token_waiters = 0;
+    bool finished = false;
+    Wakeup all_taken;               // wakes up threads which wait for a token once no group has tasks left
+};
+
+// set while a thread runs tasks of a pool, nested Jobs::run() calls add their tasks to it
+static thread_local Pool* cur_pool = nullptr;
+
+// take the next task of a group, must be called with the pool mutex locked, returns -1 if
+// all tasks of the group have been taken
+static int take_task(Pool& pool, TaskGroup& group) {
+    if (group.next_task >= group.num_tasks) {
+        return -1;
+    }
+    const int task_index = group.next_task++;
+    if (group.next_task == group.num_tasks) {
+        pool.groups.erase(std::find(pool.groups.begin(), pool.groups.end(), &group));
+        if (pool.groups.empty()) {
+            for (int i = 0; i < pool.num_token_waiters; i++) {
+                pool.all_taken.signal();
+            }
+        }
+    }
+    return task_index;
+}
+
+static void run_group_task(Pool& pool, TaskGroup& group, int task_index) {
+    // the allocations of a task count in the --mem-stats stage of the thread which started its group
+    const MemStats::Stage prev_stage = MemStats::thread_stage();
+    MemStats::set_thread_stage(group.mem_stage);
+    std::exception_ptr exception;
+    try {
+        run_task(*group.task_func, task_index);
+    } catch (...) {
+        exception = std::current_exception();
+    }
+    MemStats::set_thread_stage(prev_stage);
+    // the group may be destroyed by its calling thread as soon as the mutex is unlocked
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    if (exception && !group.exception) {
+        group.exception = exception;
+    }
+    if (++group.num_done == group.num_tasks) {
+        pool.cond.notify_all();
+    }
+}
+
+// the loop of a pool thread: wait for a group with tasks left, take a jobserver token, run a task
+static void pool_thread(Pool& pool, const Jobserver& js) {
+    cur_pool = &pool;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(pool.mutex);
+            pool.num_idle++;
+            pool.cond.wait(lock, [&pool]() { return pool.finished || !pool.groups.empty(); });
+            pool.num_idle--;
+            if (pool.groups.empty()) {
+                break;
+            }
+            if (js.active) {
+                pool.num_token_waiters++;
+            }
+        }
+        char token = '+';
+        if (js.active) {
+            const bool acquired = acquire_token(js, token, pool.all_taken);
+            {
+                std::lock_guard<std::mutex> lock(pool.mutex);
+                pool.num_token_waiters--;
+            }
+            if (!acquired) {
+                pool.all_taken.consume();
+                continue;
+            }
+        }
+        TaskGroup* group = nullptr;
+        int task_index = -1;
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            if (!pool.groups.empty()) {
+                group = pool.groups.back();
+                task_index = take_task(pool, *group);
+            }
+        }
+        if (group) {
+            run_group_task(pool, *group, task_index);
+        }
+        if (js.active) {
+            release_token(js, token);
+        }
+    }
+    cur_pool = nullptr;
+}
+
+// start more pool threads for a new group if there aren't enough idle ones, must be
+// called with the pool mutex locked, each thread has its own --timings track
+static void start_threads(Pool& pool, const Jobserver& js, int num_tasks) {
+    int num_wanted = std::min(num_tasks - 1, pool.max_threads - 1 - (int)pool.threads.size()) - pool.num_idle;
+    while (num_wanted-- > 0) {
+        const int track = (int)pool.threads.size() + 1;
+        pool.threads.emplace_back([&pool, &js, track]() {
+            Timings::set_thread_track(track);
+            pool_thread(pool, js);
+        });
+    }
+}
+
+// add a group to the pool, the calling thread then runs the tasks of its group (it already
+// holds a token), and until the tasks taken by pool threads have finished, it helps with
+// the tasks of other groups
+static void run_group(Pool& pool, const Jobserver& js, TaskGroup& group) {
+    Pool* prev_pool = cur_pool;
+    cur_pool = &pool;
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.groups.push_back(&group);
+    start_threads(pool, js, group.num_tasks);
+    pool.cond.notify_all();
+    while (group.num_done < group.num_tasks) {
+        TaskGroup* next_group = &group;
+        if (group.next_task >= group.num_tasks) {
+            if (pool.groups.empty()) {
+                pool.cond.wait(lock);
+                continue;
+            }
+            next_group = pool.groups.back();
+        }
+        const int task_index = take_task(pool, *next_group);
+        lock.unlock();
+        run_group_task(pool, *next_group, task_index);
+        lock.lock();
+    }
+    cur_pool = prev_pool;
+}
+#endif
+
+// the implicit token of the process, and whether the current thread holds a
+// Jobs::Token (pool threads in run() hold a token per task, see cur_pool)
+static std::atomic<bool> implicit_token_taken(false);
+static std::atomic<int> num_implicit_waiters(0);
+static thread_local bool holds_token = false;
+
+Jobs::Token::Token() {
+    const Jobserver& js = jobserver();
+    #if !defined(__wasi__)
+    if (!js.present || holds_token || cur_pool) {
+        return;
+    }
+    // the waiter count is incremented before checking the implicit token, so that
+    // the destructor of its holder can't miss this thread
+    num_implicit_waiters++;
+    while (true) {
+        if (!implicit_token_taken.exchange(true)) {
+            implicit = true;
+            break;
+        }
+        // wait for a jobserver token, or until the implicit token is released
+        if (acquire_token(js, token, js.implicit_released)) {
+            break;
+        }
+        js.implicit_released.consume();
+    }
+    num_implicit_waiters--;
+    acquired = true;
+    holds_token = true;
+    #else
+    (void)js;
+    #endif
+}
+
+Jobs::Token::~Token() {
+    if (!acquired) {
+        return;
+    }
+    holds_token = false;
+    if (implicit) {
+        implicit_token_taken = false;
+        if (num_implicit_waiters.load() > 0) {
+            jobserver().implicit_released.signal();
+        }
+    } else {
+        release_token(jobserver(), token);
+    }
+}
+
+int Jobs::num_threads(int num_jobs) {
+    #if defined(__wasi__)
+    return 1;
+    #else
+    if (num_jobs <= 0) {
+        num_jobs = (int)std::thread::hardware_concurrency();
+    }
+    return (num_jobs > 0) ? num_jobs : 1;
+    #endif
+}
+
+void Jobs::run(int num_jobs, int num_tasks, const std::function<void(int task_index)>& task_func) {
+    if (num_tasks <= 0) {
+        return;
+    }
+    #if !defined(__wasi__)
+    const Jobserver& js = jobserver();
+    TaskGroup group;
+    group.task_func = &task_func;
+    group.num_tasks = num_tasks;
+    group.mem_stage = MemStats::thread_stage();
+    if (cur_pool) {
+        // a nested call from inside a task, use the threads of the running pool
+        run_group(*cur_pool, js, group);
+        if (group.exception) {
+            std::rethrow_exception(group.exception);
+        }
+        return;
+    }
+    #endif
+    const int max_threads = num_threads(num_jobs);
+    // the calling thread runs tasks with its own token (a no-op if it already holds one)
+    const Token token;
+    // a single task runs on the calling thread, nested calls inside it may still start a pool
+    if ((num_tasks == 1) || (max_threads <= 1) || (jobserver().present && !jobserver().active)) {
+        for (int i = 0; i < num_tasks; i++) {
+            task_func(i);
+        }
+        return;
+    }
+    #if !defined(__wasi__)
+    Pool pool;
+    pool.max_threads = max_threads;
+    if (js.active) {
+        pool.all_taken.open();
+    }
+    run_group(pool, js, group);
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.finished = true;
+    }
+    pool.cond.notify_all();
+    // no more threads are started once all tasks have finished
+    for (std::thread& thread: pool.threads) {
+        thread.join();
+    }
+    pool.all_taken.close();
+    if (group.exception) {
+        std::rethrow_exception(group.exception);
+    }
+    #endif
+}
+
+bool Jobs::jobserver_present() {
+    return jobserver().present;
+}
+
+bool Jobs::jobserver_active() {
+    return jobserver().active;
+}
+
+int Jobs::max_concurrent_tasks() {
+    return max_running_tasks.load();
+}
+
+} // namespace shdc
@@ -0,0 +1,37 @@
+#pragma once
+#include <functional>
+
+namespace shdc {
+
+// a minimal worker pool for running independent tasks in parallel, honours
+// the GNU make jobserver protocol when running under 'make -jN'
+struct Jobs {
+    // resolve the --jobs cmdline arg into a thread count (0 means 'number of cores')
+    static int num_threads(int num_jobs);
+    // call task_func(task_index) for each task index on up to num_jobs threads, returns
+    // when all tasks have finished, nested calls from inside a task share the threads
+    // (and the num_jobs limit) of the outermost call
+    static void run(int num_jobs, int num_tasks, const std::function<void(int task_index)>& task_func);
+    // holds a jobserver token on the calling thread for its lifetime (for long-running work
+    // outside of run(), e.g. a server request): the implicit token of the process if no other
+    // thread holds it, otherwise a token from the jobserver (waits until one is available),
+    // does nothing without a jobserver or if the thread already holds a token
+    struct Token {
+        Token();
+        ~Token();
+        Token(const Token&) = delete;
+        Token& operator=(const Token&) = delete;
+        bool acquired = false;
+        bool implicit = false;
+        char token = '+';
+    };
+    // true if MAKEFLAGS contains a GNU make jobserver (--jobserver-auth)
+    static bool jobserver_present();
+    // true if connected to the jobserver, if it is present but can't be used,
+    // all tasks run on a single thread
+    static bool jobserver_active();
+    // the highest number of tasks which ran at the same time (for --dump)
+    static int max_concurrent_tasks();
+};
+
+} // namespace shdc
@@ -0,0 +1,390 @@
+/*
+    Minimal JSON parser and writer, used by the server protocols.
+*/
+#include "json.h"
+#include "fmt/format.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace shdc {
+
+Json Json::make_bool(bool val) {
+    Json res;
+    res.type = BOOL;
+    res.boolean = val;
+    return res;
+}
+
+Json Json::make_number(double val) {
+    Json res;
+    res.type = NUMBER;
+    res.number = val;
+    return res;
+}
+
+Json Json::make_string(const std::string& val) {
+    Json res;
+    res.type = STRING;
+    res.string = val;
+    return res;
+}
+
+Json Json::make_array() {
+    Json res;
+    res.type = ARRAY;
+    return res;
+}
+
+Json Json::make_object() {
+    Json res;
+    res.type = OBJECT;
+    return res;
+}
+
+Json& Json::set(const std::string& key, Json val) {
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] == key) {
+            items[i] = std::move(val);
+            return items[i];
+        }
+    }
+    keys.push_back(key);
+    items.push_back(std::move(val));
+    return items.back();
+}
+
+Json& Json::push(Json val) {
+    items.push_back(std::move(val));
+    return items.back();
+}
+
+const Json* Json::find(const std::string& key) const {
+    if (type == OBJECT) {
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (keys[i] == key) {
+                return &items[i];
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool Json::is_null() const {
+    return type == NUL;
+}
+
+bool Json::is_string() const {
+    return type == STRING;
+}
+
+bool Json::is_number() const {
+    return type == NUMBER;
+}
+
+bool Json::is_array() const {
+    return type == ARRAY;
+}
+
+bool Json::is_object() const {
+    return type == OBJECT;
+}
+
+int Json::as_int(int default_val) const {
+    return (type == NUMBER) ? (int)number : default_val;
+}
+
+std::string Json::as_string(const std::string& default_val) const {
+    return (type == STRING) ? string : default_val;
+}
+
+static void dump_string(const std::string& str, std::string& out) {
+    out += '"';
+    for (const char c: str) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default:
+                if ((uint8_t)c < 0x20) {
+                    out += fmt::format("\\u{:04x}", (int)c);
+                } else {
+                    out += c;
+                }
+                break;
+        }
+    }
+    out += '"';
+}
+
+static void dump_value(const Json& val, std::string& out) {
+    switch (val.type) {
+        case Json::NUL:
+            out += "null";
+            break;
+        case Json::BOOL:
+            out += val.boolean ? "true" : "false";
+            break;
+        case Json::NUMBER:
+            if ((val.number == (double)(int64_t)val.number) && (val.number < 1e15) && (val.number > -1e15)) {
+                out += fmt::format("{}", (int64_t)val.number);
+            } else {
+                out += fmt::format("{}", val.number);
+            }
+            break;
+        case Json::STRING:
+            dump_string(val.string, out);
+            break;
+        case Json::ARRAY:
+            out += '[';
+            for (size_t i = 0; i < val.items.size(); i++) {
+                if (i > 0) {
+                    out += ',';
+                }
+                dump_value(val.items[i], out);
+            }
+            out += ']';
+            break;
+        case Json::OBJECT:
+            out += '{';
+            for (size_t i = 0; i < val.items.size(); i++) {
+                if (i > 0) {
+                    out += ',';
+                }
+                dump_string(val.keys[i], out);
+                out += ':';
+                dump_value(val.items[i], out);
+            }
+            out += '}';
+            break;
+    }
+}
+
+std::string Json::dump() const {
+    std::string out;
+    dump_value(*this, out);
+    return out;
+}
+
+// recursive descent parser
+struct JsonParser {
+    const std::string& src;
+    size_t pos = 0;
+    std::string error;
+
+    JsonParser(const std::string& s): src(s) { };
+
+    bool fail(const std::string& msg) {
+        if (error.empty()) {
+            error = fmt::format("JSON parse error at offset {}: {}", pos, msg);
+        }
+        return false;
+    }
+    void skip_ws() {
+        while ((pos < src.size()) && ((src[pos] == ' ') || (src[pos] == '\t') || (src[pos] == '\n') || (src[pos] == '\r'))) {
+            pos++;
+        }
+    }
+    bool match(const char* lit) {
+        size_t len = strlen(lit);
+        if (src.compare(pos, len, lit) == 0) {
+            pos += len;
+            return true;
+        }
+        return false;
+    }
+    void append_utf8(uint32_t cp, std::string& out) {
+        if (cp < 0x80) {
+            out += (char)cp;
+        } else if (cp < 0x800) {
+            out += (char)(0xC0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += (char)(0xE0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else {
+            out += (char)(0xF0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3F));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+    bool parse_hex4(uint32_t& out_cp) {
+        if ((pos + 4) > src.size()) {
+            return fail("truncated unicode escape");
+        }
+        out_cp = 0;
+        for (int i = 0; i < 4; i++) {
+            const char c = src[pos++];
+            out_cp <<= 4;
+            if ((c >= '0') && (c <= '9')) {
+                out_cp |= (uint32_t)(c - '0');
+            } else if ((c >= 'a') && (c <= 'f')) {
+                out_cp |= (uint32_t)(c - 'a' + 10);
+            } else if ((c >= 'A') && (c <= 'F')) {
+                out_cp |= (uint32_t)(c - 'A' + 10);
+            } else {
+                return fail("invalid unicode escape");
+            }
+        }
+        return true;
+    }
+    bool parse_string(std::string& out) {
+        // opening quote has already been checked
+        pos++;
+        while (pos < src.size()) {
+            const char c = src[pos++];
+            if (c == '"') {
+                return true;
+            } else if (c == '\\') {
+                if (pos >= src.size()) {
+                    break;
+                }
+                const char esc = src[pos++];
+                switch (esc) {
+                    case '"':  out += '"'; break;
+                    case '\\': out += '\\'; break;
+                    case '/':  out += '/'; break;
+                    case 'b':  out += '\b'; break;
+                    case 'f':  out += '\f'; break;
+                    case 'n':  out += '\n'; break;
+                    case 'r':  out += '\r'; break;
+                    case 't':  out += '\t'; break;
+                    case 'u': {
+                        uint32_t cp;
+                        if (!parse_hex4(cp)) {
+                            return false;
+                        }
+                        // surrogate pair
+                        if ((cp >= 0xD800) && (cp <= 0xDBFF) && match("\\u")) {
+                            uint32_t lo;
+                            if (!parse_hex4(lo)) {
+                                return false;
+                            }
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        }
+                        append_utf8(cp, out);
+                        break;
+                    }
+                    default:
+                        return fail("invalid escape sequence");
+                }
+            } else {
+                out += c;
+            }
+        }
+        return fail("unterminated string");
+    }
+    bool parse_value(Json& out, int depth) {
+        if (depth > 64) {
+            return fail("nesting too deep");
+        }
+        skip_ws();
+        if (pos >= src.size()) {
+            return fail("unexpected end of input");
+        }
+        const char c = src[pos];
+        if (c == '{') {
+            pos++;
+            out = Json::make_object();
+            skip_ws();
+            if ((pos < src.size()) && (src[pos] == '}')) {
+                pos++;
+                return true;
+            }
+            while (true) {
+                skip_ws();
+                if ((pos >= src.size()) || (src[pos] != '"')) {
+                    return fail("expected object key");
+                }
+                std::string key;
+                if (!parse_string(key)) {
+                    return false;
+                }
+                skip_ws();
+                if (!match(":")) {
+                    return fail("expected ':'");
+                }
+                Json val;
+                if (!parse_value(val, depth + 1)) {
+                    return false;
+                }
+                out.set(key, std::move(val));
+                skip_ws();
+                if (match(",")) {
+                    continue;
+                } else if (match("}")) {
+                    return true;
+                }
+                return fail("expected ',' or '}'");
+            }
+        } else if (c == '[') {
+            pos++;
+            out = Json::make_array();
+            skip_ws();
+            if ((pos < src.size()) && (src[pos] == ']')) {
+                pos++;
+                return true;
+            }
+            while (true) {
+                Json val;
+                if (!parse_value(val, depth + 1)) {
+                    return false;
+                }
+                out.push(std::move(val));
+                skip_ws();
+                if (match(",")) {
+                    continue;
+                } else if (match("]")) {
+                    return true;
+                }
+                return fail("expected ',' or ']'");
+            }
+        } else if (c == '"') {
+            out = Json::make_string("");
+            return parse_string(out.string);
+        } else if (match("true")) {
+            out = Json::make_bool(true);
+            return true;
+        } else if (match("false")) {
+            out = Json::make_bool(false);
+            return true;
+        } else if (match("null")) {
+            out = Json();
+            return true;
+        } else if ((c == '-') || ((c >= '0') && (c <= '9'))) {
+            const char* start = src.c_str() + pos;
+            char* end = nullptr;
+            const double val = strtod(start, &end);
+            if (end == start) {
+                return fail("invalid number");
+            }
+            pos += (size_t)(end - start);
+            out = Json::make_number(val);
+            return true;
+        }
+        return fail("unexpected character");
+    }
+};
+
+Json Json::parse(const std::string& src, std::string& out_error) {
+    JsonParser parser(src);
+    Json res;
+    if (parser.parse_value(res, 0)) {
+        parser.skip_ws();
+        if (parser.pos != src.size()) {
+            parser.fail("trailing characters");
+        }
+    }
+    out_error = parser.error;
+    if (!out_error.empty()) {
+        return Json();
+    }
+    return res;
+}
+
+} // namespace shdc
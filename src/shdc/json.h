@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace shdc {
+
+// a minimal JSON value type for the server protocols, objects keep
+// their keys in insertion order
+struct Json {
+    enum Type {
+        NUL,
+        BOOL,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT,
+    };
+    Type type = NUL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<Json> items;            // array items or object values
+    std::vector<std::string> keys;      // object keys, same order as items
+
+    static Json make_bool(bool val);
+    static Json make_number(double val);
+    static Json make_string(const std::string& val);
+    static Json make_array();
+    static Json make_object();
+
+    // parse a JSON string, returns a NUL value and sets out_error on failure
+    static Json parse(const std::string& src, std::string& out_error);
+    // serialize to a single-line JSON string
+    std::string dump() const;
+
+    // object and array helpers
+    Json& set(const std::string& key, Json val);
+    Json& push(Json val);
+    const Json* find(const std::string& key) const;
+    bool is_null() const;
+    bool is_string() const;
+    bool is_number() const;
+    bool is_array() const;
+    bool is_object() const;
+    int as_int(int default_val) const;
+    std::string as_string(const std::string& default_val) const;
+};
+
+} // namespace shdc
@@ -0,0 +1,790 @@
+/*
+    Language server mode.
+
+    Implements the subset of the Language Server Protocol which is useful for
+    annotated GLSL files, messages are JSON-RPC 2.0 objects with a
+    'Content-Length' header on stdin and stdout:
+
+    - textDocument/didOpen, didChange (full or incremental), didClose
+    - textDocument/publishDiagnostics with glslang and resource validation errors
+    - textDocument/definition for @include, @include_block and @program references
+    - textDocument/hover with reflection info for uniform blocks and their
+      members, storage buffers, images and samplers (bind slots and offsets)
+
+    Open documents are kept in memory as line tables, incremental edits only
+    replace the changed lines. After an edit the tags are parsed again from the
+    line tables (which is cheap), but only the vs and fs snippets whose resolved
+    source changed are compiled with glslang and reflected with SPIRV-Cross,
+    the results of all other snippets are reused from a table keyed by the
+    resolved snippet source, and their diagnostics are moved to the snippet's
+    current lines. When an @include file is edited, all open documents which
+    include it are validated again.
+
+    Character offsets are treated as byte offsets, this is identical to the
+    UTF-16 offsets of the protocol for ASCII source files.
+*/
+#include "lsp.h"
+#include "input.h"
+#include "spirv.h"
+#include "spirvcross.h"
+#include "jobs.h"
+#include "json.h"
+#include "timings.h"
+#include "fmt/format.h"
+#include "pystring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#elif !defined(__wasi__)
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace shdc {
+
+using namespace refl;
+
+// JSON-RPC error codes
+static const int rpc_parse_error = -32700;
+static const int rpc_method_not_found = -32601;
+
+// LSP diagnostic severities
+static const int lsp_severity_error = 1;
+static const int lsp_severity_warning = 2;
+
+// max number of memoized snippet results, results not used by the last validation are dropped
+static const size_t max_snippet_results = 1024;
+
+// an open document, the content is kept as a line table which is patched by edits
+struct LspDocument {
+    std::string uri;
+    std::string path;   // normalized file path
+    std::vector<std::string> lines;
+    // result of the last validation: parsed input, reflection of all vs and fs
+    // snippets, and diagnostics grouped by normalized file path
+    Input inp;
+    std::vector<StageReflection> refls;
+    std::map<std::string, std::vector<ErrMsg>> messages;
+};
+
+// memoized validation result of a single vs or fs snippet, message
+// lines are stored relative to the snippet
+struct LspSnippetResult {
+    struct Message {
+        int snippet_line = -1;  // index into Snippet::lines
+        ErrMsg msg;
+    };
+    std::vector<Message> messages;
+    bool reflected = false;
+    StageReflection refl;
+    uint64_t used = 0;          // validation counter when the result was last used
+};
+
+struct LspState {
+    Args args;
+    Slang::Enum slang = Slang::GLSL430;
+    FILE* out = nullptr;
+    std::map<std::string, LspDocument> docs;    // key is the normalized path
+    std::map<std::string, LspSnippetResult> snippet_results;
+    uint64_t validate_count = 0;
+    bool shutdown = false;
+};
+
+struct LspPosition {
+    int line = 0;
+    int character = 0;
+};
+
+static std::string normalize_path(const std::string& path) {
+    return fs::path(path).lexically_normal().generic_string();
+}
+
+static std::string uri_to_path(const std::string& uri) {
+    const std::string src = pystring::startswith(uri, "file://") ? uri.substr(7) : uri;
+    std::string path;
+    for (size_t i = 0; i < src.size(); i++) {
+        if ((src[i] == '%') && ((i + 2) < src.size())) {
+            path += (char)strtol(src.substr(i + 1, 2).c_str(), nullptr, 16);
+            i += 2;
+        } else {
+            path += src[i];
+        }
+    }
+    // Windows drive letter paths look like 'file:///C:/...'
+    if ((path.size() > 2) && (path[0] == '/') && (path[2] == ':')) {
+        path = path.substr(1);
+    }
+    return normalize_path(path);
+}
+
+static std::string path_to_uri(const std::string& path) {
+    const std::string norm = normalize_path(path);
+    std::string uri = "file://";
+    if (!pystring::startswith(norm, "/")) {
+        uri += "/";
+    }
+    for (const char c: norm) {
+        if (isalnum((unsigned char)c) || strchr("/-._~:", c)) {
+            uri += c;
+        } else {
+            uri += fmt::format("%{:02X}", (unsigned char)c);
+        }
+    }
+    return uri;
+}
+
+// use the client's URI for open documents
+static std::string uri_for_path(const LspState& state, const std::string& path) {
+    auto it = state.docs.find(path);
+    return (it != state.docs.end()) ? it->second.uri : path_to_uri(path);
+}
+
+// unlike pystring::splitlines this keeps a trailing empty line, so that
+// the line table matches the editor's line numbers
+static std::vector<std::string> split_lines(const std::string& text) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    while (true) {
+        const size_t end = text.find('\n', start);
+        std::string line = text.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+        if (!line.empty() && (line.back() == '\r')) {
+            line.pop_back();
+        }
+        lines.push_back(line);
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+    return lines;
+}
+
+static LspPosition get_position(const Json* pos) {
+    LspPosition res;
+    if (pos) {
+        const Json* line = pos->find("line");
+        const Json* character = pos->find("character");
+        res.line = line ? line->as_int(0) : 0;
+        res.character = character ? character->as_int(0) : 0;
+    }
+    return res;
+}
+
+// the identifier under the cursor
+static std::string word_at(const std::string& line, int character) {
+    const auto is_ident = [](char c) { return isalnum((unsigned char)c) || (c == '_'); };
+    const int len = (int)line.size();
+    int start = (character < len) ? character : len;
+    int end = start;
+    while ((start > 0) && is_ident(line[start - 1])) {
+        start--;
+    }
+    while ((end < len) && is_ident(line[end])) {
+        end++;
+    }
+    return line.substr(start, end - start);
+}
+
+// split a line into tokens with the optional '#pragma sokol' prefix removed
+static std::vector<std::string> tag_tokens(const std::string& line) {
+    std::vector<std::string> tokens;
+    pystring::split(line, tokens);
+    if ((tokens.size() > 2) && (tokens[0] == "#pragma") && (tokens[1] == "sokol")) {
+        tokens.erase(tokens.begin(), tokens.begin() + 2);
+    }
+    return tokens;
+}
+
+// apply a single content change, a change with a range only replaces the affected lines
+static void apply_change(LspDocument& doc, const Json& change) {
+    const Json* text = change.find("text");
+    const std::vector<std::string> new_lines = split_lines(text ? text->as_string("") : "");
+    const Json* range = change.find("range");
+    if (!range) {
+        doc.lines = new_lines;
+        return;
+    }
+    LspPosition start = get_position(range->find("start"));
+    LspPosition end = get_position(range->find("end"));
+    const int last_line = (int)doc.lines.size() - 1;
+    start.line = std::max(0, std::min(start.line, last_line));
+    end.line = std::max(start.line, std::min(end.line, last_line));
+    start.character = std::max(0, std::min(start.character, (int)doc.lines[start.line].size()));
+    end.character = std::max(0, std::min(end.character, (int)doc.lines[end.line].size()));
+
+    std::vector<std::string> lines = new_lines;
+    lines.front() = doc.lines[start.line].substr(0, start.character) + lines.front();
+    lines.back() += doc.lines[end.line].substr(end.character);
+    doc.lines.erase(doc.lines.begin() + start.line, doc.lines.begin() + end.line + 1);
+    doc.lines.insert(doc.lines.begin() + start.line, lines.begin(), lines.end());
+}
+
+// file loader for the input parser, open documents are read from memory
+static bool load_file(const LspState& state, const std::string& path, std::string& out_content) {
+    auto it = state.docs.find(normalize_path(path));
+    if (it != state.docs.end()) {
+        out_content = pystring::join("\n", it->second.lines);
+        return true;
+    }
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    out_content = ss.str();
+    return true;
+}
+
+// the key of a memoized snippet result covers the resolved source lines (or the
+// @spirv module), snippet type, target language and the image-sample-type and
+// sampler-type tags
+static std::string snippet_key(const LspState& state, const Input& inp, const Snippet& snippet) {
+    std::string key = fmt::format("{}:{}:", Slang::to_str(state.slang), Snippet::type_to_str(snippet.type));
+    for (const auto& item: snippet.image_sample_type_tags) {
+        key += fmt::format("img:{}={}:", item.first, ImageSampleType::to_str(item.second.type));
+    }
+    for (const auto& item: snippet.sampler_type_tags) {
+        key += fmt::format("smp:{}={}:", item.first, SamplerType::to_str(item.second.type));
+    }
+    key += "\n";
+    for (int line_index: snippet.lines) {
+        key += inp.lines[line_index].line;
+        key += "\n";
+    }
+    key.append((const char*)snippet.spirv.data(), snippet.spirv.size() * sizeof(uint32_t));
+    return key;
+}
+
+// compile and reflect a single snippet
+static LspSnippetResult check_snippet(const LspState& state, const Input& inp, const Snippet& snippet) {
+    LspSnippetResult res;
+    const Spirv spirv = Spirv::check_snippet(inp, snippet.index, state.slang, state.args.defines);
+    for (const ErrMsg& err: spirv.errors) {
+        // messages outside the snippet (e.g. in the generated #defines) are moved to its first line
+        LspSnippetResult::Message msg;
+        msg.msg = err;
+        msg.snippet_line = snippet.lines.empty() ? -1 : 0;
+        for (int i = 0; i < (int)snippet.lines.size(); i++) {
+            const Line& line = inp.lines[snippet.lines[i]];
+            if ((line.index == err.line_index) && (inp.filenames[line.filename] == err.file)) {
+                msg.snippet_line = i;
+                break;
+            }
+        }
+        res.messages.push_back(msg);
+    }
+    if (!spirv.blobs.empty()) {
+        // resource validation errors have no line information
+        const ErrMsg err = Spirvcross::reflect(inp, spirv.blobs[0], res.refl);
+        if (err.valid()) {
+            LspSnippetResult::Message msg;
+            msg.msg = err;
+            msg.snippet_line = snippet.lines.empty() ? -1 : 0;
+            res.messages.push_back(msg);
+        } else {
+            res.reflected = true;
+        }
+    }
+    return res;
+}
+
+static void add_message(LspDocument& doc, const ErrMsg& msg) {
+    doc.messages[normalize_path(msg.file)].push_back(msg);
+}
+
+// parse a document and validate all vs and fs snippets which haven't been validated before
+static void validate_document(LspState& state, LspDocument& doc) {
+    doc.inp = Input::load_and_parse(doc.path, state.args.module, [&state](const std::string& path, std::string& out_content) {
+        return load_file(state, path, out_content);
+    });
+    doc.refls.clear();
+    doc.messages.clear();
+    if (doc.inp.out_error.valid()) {
+        add_message(doc, doc.inp.out_error);
+        return;
+    }
+    const Input& inp = doc.inp;
+
+    // find snippets with a changed resolved source and compile them in parallel
+    std::vector<int> snippet_indices;
+    std::vector<std::string> keys;
+    std::vector<int> pending;
+    std::set<std::string> pending_keys;
+    for (const Snippet& snippet: inp.snippets) {
+        if ((snippet.type == Snippet::VS) || (snippet.type == Snippet::FS)) {
+            const std::string key = snippet_key(state, inp, snippet);
+            if ((state.snippet_results.count(key) == 0) && (pending_keys.count(key) == 0)) {
+                pending_keys.insert(key);
+                pending.push_back((int)snippet_indices.size());
+            }
+            snippet_indices.push_back(snippet.index);
+            keys.push_back(key);
+        }
+    }
+    std::vector<LspSnippetResult> results(pending.size());
+    Jobs::run(state.args.num_jobs, (int)pending.size(), [&state, &inp, &snippet_indices, &pending, &results](int i) {
+        results[i] = check_snippet(state, inp, inp.snippets[snippet_indices[pending[i]]]);
+    });
+    for (size_t i = 0; i < pending.size(); i++) {
+        state.snippet_results[keys[pending[i]]] = std::move(results[i]);
+    }
+
+    // gather diagnostics and reflection at the current snippet locations
+    for (size_t i = 0; i < snippet_indices.size(); i++) {
+        const Snippet& snippet = inp.snippets[snippet_indices[i]];
+        LspSnippetResult& res = state.snippet_results[keys[i]];
+        res.used = state.validate_count;
+        for (const LspSnippetResult::Message& msg: res.messages) {
+            ErrMsg err = msg.msg;
+            if (msg.snippet_line >= 0) {
+                const Line& line = inp.lines[snippet.lines[msg.snippet_line]];
+                err.file = inp.filenames[line.filename];
+                err.line_index = line.index;
+            }
+            add_message(doc, err);
+        }
+        if (res.reflected) {
+            StageReflection refl = res.refl;
+            refl.snippet_index = snippet.index;
+            refl.snippet_name = snippet.name;
+            doc.refls.push_back(refl);
+        }
+    }
+}
+
+static Json rpc_response(const Json& id, Json result) {
+    Json res = Json::make_object();
+    res.set("jsonrpc", Json::make_string("2.0"));
+    res.set("id", id);
+    res.set("result", std::move(result));
+    return res;
+}
+
+static Json rpc_error(const Json& id, int code, const std::string& msg) {
+    Json err = Json::make_object();
+    err.set("code", Json::make_number(code));
+    err.set("message", Json::make_string(msg));
+    Json res = Json::make_object();
+    res.set("jsonrpc", Json::make_string("2.0"));
+    res.set("id", id);
+    res.set("error", std::move(err));
+    return res;
+}
+
+static Json rpc_notification(const std::string& method, Json params) {
+    Json res = Json::make_object();
+    res.set("jsonrpc", Json::make_string("2.0"));
+    res.set("method", Json::make_string(method));
+    res.set("params", std::move(params));
+    return res;
+}
+
+static void send_message(const LspState& state, const Json& msg) {
+    const std::string body = msg.dump();
+    fmt::print(state.out, "Content-Length: {}\r\n\r\n{}", body.size(), body);
+    fflush(state.out);
+}
+
+// read the next message from stdin, returns false at end of input
+static bool read_message(std::string& out_msg) {
+    int content_length = -1;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && (line.back() == '\r')) {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            if (content_length >= 0) {
+                break;
+            }
+        } else if (pystring::startswith(pystring::lower(line), "content-length:")) {
+            content_length = atoi(line.substr(15).c_str());
+        }
+    }
+    if (content_length < 0) {
+        return false;
+    }
+    out_msg.resize(content_length);
+    std::cin.read(&out_msg[0], content_length);
+    return std::cin.gcount() == content_length;
+}
+
+static Json position_json(int line, int character) {
+    Json res = Json::make_object();
+    res.set("line", Json::make_number(line));
+    res.set("character", Json::make_number(character));
+    return res;
+}
+
+static Json range_json(int start_line, int start_character, int end_line, int end_character) {
+    Json res = Json::make_object();
+    res.set("start", position_json(start_line, start_character));
+    res.set("end", position_json(end_line, end_character));
+    return res;
+}
+
+static Json location_json(const LspState& state, const std::string& path, int line, int num_chars) {
+    Json res = Json::make_object();
+    res.set("uri", Json::make_string(uri_for_path(state, normalize_path(path))));
+    res.set("range", range_json(line, 0, line, num_chars));
+    return res;
+}
+
+// publish the diagnostics of all open documents for one file
+static void publish_diagnostics(const LspState& state, const std::string& path) {
+    Json diags = Json::make_array();
+    std::set<std::string> seen;
+    for (const auto& item: state.docs) {
+        auto it = item.second.messages.find(path);
+        if (it == item.second.messages.end()) {
+            continue;
+        }
+        for (const ErrMsg& msg: it->second) {
+            if (!seen.insert(msg.as_string(ErrMsg::GCC)).second) {
+                continue;
+            }
+            const int line = std::max(0, msg.line_index);
+            Json diag = Json::make_object();
+            diag.set("range", range_json(line, 0, line + 1, 0));
+            diag.set("severity", Json::make_number((msg.type == ErrMsg::WARNING) ? lsp_severity_warning : lsp_severity_error));
+            diag.set("source", Json::make_string("sokol-shdc"));
+            diag.set("message", Json::make_string(msg.msg));
+            diags.push(std::move(diag));
+        }
+    }
+    Json params = Json::make_object();
+    params.set("uri", Json::make_string(uri_for_path(state, path)));
+    params.set("diagnostics", std::move(diags));
+    send_message(state, rpc_notification("textDocument/publishDiagnostics", std::move(params)));
+}
+
+static bool depends_on(const LspDocument& doc, const std::string& path) {
+    for (const std::string& filename: doc.inp.filenames) {
+        if (normalize_path(filename) == path) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// validate all open documents which depend on a changed file, and publish the
+// diagnostics of all files which had or have messages
+static void update(LspState& state, const std::string& path, std::set<std::string> files) {
+    state.validate_count++;
+    files.insert(path);
+    for (auto& item: state.docs) {
+        LspDocument& doc = item.second;
+        if ((doc.path == path) || depends_on(doc, path)) {
+            for (const auto& msgs: doc.messages) {
+                files.insert(msgs.first);
+            }
+            validate_document(state, doc);
+            for (const auto& msgs: doc.messages) {
+                files.insert(msgs.first);
+            }
+        }
+    }
+    for (const std::string& file: files) {
+        publish_diagnostics(state, file);
+    }
+    // with --timings, each validation reports its own events
+    if (!state.args.timings.empty()) {
+        Timings::write_report(state.args.timings);
+    }
+    if (state.snippet_results.size() > max_snippet_results) {
+        for (auto it = state.snippet_results.begin(); it != state.snippet_results.end();) {
+            if (it->second.used != state.validate_count) {
+                it = state.snippet_results.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+static LspDocument* find_document(LspState& state, const Json& params) {
+    const Json* text_doc = params.find("textDocument");
+    const Json* uri = text_doc ? text_doc->find("uri") : nullptr;
+    if (!uri) {
+        return nullptr;
+    }
+    auto it = state.docs.find(uri_to_path(uri->as_string("")));
+    return (it != state.docs.end()) ? &it->second : nullptr;
+}
+
+static void did_open(LspState& state, const Json& params) {
+    const Json* text_doc = params.find("textDocument");
+    const Json* uri = text_doc ? text_doc->find("uri") : nullptr;
+    const Json* text = text_doc ? text_doc->find("text") : nullptr;
+    if (!uri || !text) {
+        return;
+    }
+    LspDocument doc;
+    doc.uri = uri->as_string("");
+    doc.path = uri_to_path(doc.uri);
+    doc.lines = split_lines(text->as_string(""));
+    const std::string path = doc.path;
+    state.docs[path] = std::move(doc);
+    update(state, path, {});
+}
+
+static void did_change(LspState& state, const Json& params) {
+    LspDocument* doc = find_document(state, params);
+    const Json* changes = params.find("contentChanges");
+    if (!doc || !changes || !changes->is_array()) {
+        return;
+    }
+    for (const Json& change: changes->items) {
+        apply_change(*doc, change);
+    }
+    update(state, doc->path, {});
+}
+
+static void did_close(LspState& state, const Json& params) {
+    LspDocument* doc = find_document(state, params);
+    if (!doc) {
+        return;
+    }
+    // the closed document is read from disk again by documents which include it
+    const std::string path = doc->path;
+    std::set<std::string> files;
+    for (const auto& msgs: doc->messages) {
+        files.insert(msgs.first);
+    }
+    state.docs.erase(path);
+    update(state, path, files);
+}
+
+// find the @block, @vs or @fs tag which defines a snippet
+static const Line* find_snippet_tag(const Input& inp, const std::string& name) {
+    for (const Line& line: inp.lines) {
+        if (line.line.find('@') == std::string::npos) {
+            continue;
+        }
+        const std::vector<std::string> tokens = tag_tokens(std::string(line.line));
+        if ((tokens.size() >= 2) && (tokens[1] == name) && ((tokens[0] == "@block") || (tokens[0] == "@vs") || (tokens[0] == "@fs"))) {
+            return &line;
+        }
+    }
+    return nullptr;
+}
+
+static Json definition(LspState& state, const Json& params) {
+    const LspDocument* doc = find_document(state, params);
+    const LspPosition pos = get_position(params.find("position"));
+    if (!doc || (pos.line < 0) || (pos.line >= (int)doc->lines.size())) {
+        return Json();
+    }
+    const std::string& line = doc->lines[pos.line];
+    const std::vector<std::string> tokens = tag_tokens(line);
+    if (tokens.size() < 2) {
+        return Json();
+    }
+    if (tokens[0] == "@include") {
+        const std::string include_path = normalize_path(tokens[1]);
+        for (size_t i = 1; i < doc->inp.filenames.size(); i++) {
+            if (pystring::endswith(normalize_path(doc->inp.filenames[i]), include_path)) {
+                return location_json(state, doc->inp.filenames[i], 0, 0);
+            }
+        }
+        return Json();
+    }
+    // @include_block [block], @program [name] [vs] [fs]
+    const int first_ref = (tokens[0] == "@include_block") ? 1 : ((tokens[0] == "@program") ? 2 : -1);
+    const std::string word = word_at(line, pos.character);
+    if ((first_ref < 0) || word.empty() || (std::find(tokens.begin() + first_ref, tokens.end(), word) == tokens.end())) {
+        return Json();
+    }
+    const Line* tag = find_snippet_tag(doc->inp, word);
+    if (!tag) {
+        return Json();
+    }
+    return location_json(state, doc->inp.filenames[tag->filename], tag->index, (int)tag->line.size());
+}
+
+static std::string type_as_glsl_decl(const Type& type) {
+    const std::string array = type.is_array ? fmt::format("[{}]", type.array_count) : "";
+    return fmt::format("{} {}{};", type.type_as_glsl(), type.name, array);
+}
+
+static std::string uniform_block_info(const UniformBlock& ub, const std::string& stage) {
+    std::string res = fmt::format("uniform block `{}` ({} slot {}, {} bytes)\n```glsl\n", ub.struct_info.struct_typename, stage, ub.slot, ub.struct_info.size);
+    for (const Type& item: ub.struct_info.struct_items) {
+        res += fmt::format("{} // offset {}, size {}\n", type_as_glsl_decl(item), item.offset, item.size);
+    }
+    return res + "```";
+}
+
+static Json hover(LspState& state, const Json& params) {
+    const LspDocument* doc = find_document(state, params);
+    const LspPosition pos = get_position(params.find("position"));
+    if (!doc || (pos.line < 0) || (pos.line >= (int)doc->lines.size())) {
+        return Json();
+    }
+    const std::string word = word_at(doc->lines[pos.line], pos.character);
+    if (word.empty()) {
+        return Json();
+    }
+    std::vector<std::string> infos;
+    for (const StageReflection& refl: doc->refls) {
+        const std::string& stage = refl.stage_name;
+        for (const UniformBlock& ub: refl.bindings.uniform_blocks) {
+            if ((ub.struct_info.struct_typename == word) || (ub.inst_name == word)) {
+                infos.push_back(uniform_block_info(ub, stage));
+                continue;
+            }
+            for (const Type& item: ub.struct_info.struct_items) {
+                if (item.name == word) {
+                    infos.push_back(fmt::format("`{}` in uniform block `{}` ({} slot {}): offset {}, size {}",
+                        type_as_glsl_decl(item), ub.struct_info.struct_typename, stage, ub.slot, item.offset, item.size));
+                }
+            }
+        }
+        for (const StorageBuffer& sbuf: refl.bindings.storage_buffers) {
+            if ((sbuf.struct_info.struct_typename == word) || (sbuf.inst_name == word)) {
+                infos.push_back(fmt::format("storage buffer `{}` ({} slot {}{})", sbuf.struct_info.struct_typename, stage, sbuf.slot, sbuf.readonly ? ", readonly" : ""));
+            }
+        }
+        for (const Image& img: refl.bindings.images) {
+            if (img.name == word) {
+                infos.push_back(fmt::format("image `{}` ({} slot {}, {}, sample type {}{})",
+                    img.name, stage, img.slot, ImageType::to_str(img.type), ImageSampleType::to_str(img.sample_type), img.multisampled ? ", multisampled" : ""));
+            }
+        }
+        for (const Sampler& smp: refl.bindings.samplers) {
+            if (smp.name == word) {
+                infos.push_back(fmt::format("sampler `{}` ({} slot {}, type {})", smp.name, stage, smp.slot, SamplerType::to_str(smp.type)));
+            }
+        }
+    }
+    if (infos.empty()) {
+        return Json();
+    }
+    Json contents = Json::make_object();
+    contents.set("kind", Json::make_string("markdown"));
+    contents.set("value", Json::make_string(pystring::join("\n\n", infos)));
+    Json res = Json::make_object();
+    res.set("contents", std::move(contents));
+    return res;
+}
+
+static Json capabilities() {
+    Json sync = Json::make_object();
+    sync.set("openClose", Json::make_bool(true));
+    sync.set("change", Json::make_number(2));   // incremental
+    Json caps = Json::make_object();
+    caps.set("textDocumentSync", std::move(sync));
+    caps.set("definitionProvider", Json::make_bool(true));
+    caps.set("hoverProvider", Json::make_bool(true));
+    Json info = Json::make_object();
+    info.set("name", Json::make_string("sokol-shdc"));
+    Json res = Json::make_object();
+    res.set("capabilities", std::move(caps));
+    res.set("serverInfo", std::move(info));
+    return res;
+}
+
+// handle a request or notification, returns false for unknown methods
+static bool handle_message(LspState& state, const std::string& method, const Json& params, Json& out_result) {
+    if (method == "initialize") {
+        out_result = capabilities();
+    } else if (method == "shutdown") {
+        state.shutdown = true;
+    } else if (method == "textDocument/didOpen") {
+        did_open(state, params);
+    } else if (method == "textDocument/didChange") {
+        did_change(state, params);
+    } else if (method == "textDocument/didClose") {
+        did_close(state, params);
+    } else if (method == "textDocument/definition") {
+        out_result = definition(state, params);
+    } else if (method == "textDocument/hover") {
+        out_result = hover(state, params);
+    } else if ((method != "initialized") && !pystring::startswith(method, "$/")) {
+        return false;
+    }
+    return true;
+}
+
+int Lsp::run(const Args& args) {
+    #if defined(__wasi__)
+    fmt::print(stderr, "sokol-shdc: language server mode is not supported on this platform\n");
+    return 10;
+    #else
+    // reserve stdout for protocol messages, and redirect everything else to stderr
+    #if defined(_WIN32)
+    _setmode(_fileno(stdin), _O_BINARY);
+    FILE* out = _fdopen(_dup(_fileno(stdout)), "wb");
+    _dup2(_fileno(stderr), _fileno(stdout));
+    #else
+    FILE* out = fdopen(dup(fileno(stdout)), "wb");
+    dup2(fileno(stderr), fileno(stdout));
+    #endif
+    if (!out) {
+        fmt::print(stderr, "sokol-shdc: failed to setup language server\n");
+        return 10;
+    }
+    LspState state;
+    state.args = args;
+    state.out = out;
+    // validate with the first requested shader language, or GLSL 4.3 if none was requested
+    for (int i = 0; i < Slang::Num; i++) {
+        if (args.slang & Slang::bit(Slang::from_index(i))) {
+            state.slang = Slang::from_index(i);
+            break;
+        }
+    }
+
+    // messages are handled in order, a document edit is validated before the next message is read
+    bool exit_requested = false;
+    std::string msg;
+    while (!exit_requested && read_message(msg)) {
+        std::string parse_error;
+        const Json req = Json::parse(msg, parse_error);
+        if (!parse_error.empty()) {
+            send_message(state, rpc_error(Json(), rpc_parse_error, parse_error));
+            continue;
+        }
+        const Json* method = req.find("method");
+        const Json* id = req.find("id");
+        if (!method || !method->is_string()) {
+            // a response to a server request (none are sent) or an invalid message
+            continue;
+        }
+        if (method->string == "exit") {
+            exit_requested = true;
+            continue;
+        }
+        const Json* params = req.find("params");
+        const Json null_params;
+        Json result;
+        const bool handled = handle_message(state, method->string, params ? *params : null_params, result);
+        if (id) {
+            if (handled) {
+                send_message(state, rpc_response(*id, std::move(result)));
+            } else {
+                send_message(state, rpc_error(*id, rpc_method_not_found, fmt::format("unknown method '{}'", method->string)));
+            }
+        }
+    }
+    fclose(out);
+    return state.shutdown ? 0 : 1;
+    #endif
+}
+
+} // namespace shdc
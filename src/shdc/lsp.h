@@ -0,0 +1,13 @@
+#pragma once
+#include "args.h"
+
+namespace shdc {
+
+// language server mode (--lsp), speaks the Language Server Protocol on stdin/stdout
+// and publishes diagnostics, go-to-definition and hover information for annotated
+// GLSL files which are open in an editor
+struct Lsp {
+    static int run(const Args& args);
+};
+
+} // namespace shdc
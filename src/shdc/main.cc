@@ -3,15 +3,21 @@
 */
 #include "spirv.h"
 #include "args.h"
-#include "input.h"
-#include "spirvcross.h"
-#include "bytecode.h"
-#include "reflection.h"
-#include "generators/generate.h"
+#include "cache.h"
+#include "pipeline.h"
+#include "batch.h"
+#include "server.h"
+#include "watch.h"
+#include "lsp.h"
+#include "stream.h"
+#include "jobs.h"
+#include "timings.h"
+#include "optprofile.h"
+#include "memstats.h"
+#include "memstats_new.h"
+#include "fmt/format.h"
 
 using namespace shdc;
-using namespace shdc::refl;
-using namespace shdc::gen;
 
 int main(int argc, const char** argv) {
     Spirv::initialize_spirv_tools();
@@ -25,107 +31,82 @@ int main(int argc, const char** argv) {
         return args.exit_code;
     }
 
-    // load the source and parse tagged blocks
-    const Input inp = Input::load_and_parse(args.input, args.module);
-    if (args.debug_dump) {
-        inp.dump_debug(args.error_format);
-    }
-    if (inp.out_error.valid()) {
-        inp.out_error.print(args.error_format);
+    // open the optional artifact cache (--cache-dir), in server and watch mode,
+    // artifacts are additionally kept in memory
+    const Cache cache = Cache::open(args.cache_dir, args.cache_size, !args.server.empty() || args.watch);
+    if (cache.error.valid()) {
+        cache.error.print(args.error_format);
         return 10;
     }
 
-    // compile source snippets to SPIRV blobs (multiple compilations is necessary
-    // because of conditional compilation by target language)
-    std::array<Spirv,Slang::Num> spirv;
-    for (int i = 0; i < Slang::Num; i++) {
-        Slang::Enum slang = Slang::from_index(i);
-        if (args.slang & Slang::bit(slang)) {
-            spirv[i] = Spirv::compile_glsl(inp, slang, args.defines);
-            if (args.debug_dump) {
-                spirv[i].dump_debug(inp, args.error_format);
-            }
-            if (!spirv[i].errors.empty()) {
-                bool has_errors = false;
-                for (const ErrMsg& err: spirv[i].errors) {
-                    if (err.type == ErrMsg::ERROR) {
-                        has_errors = true;
-                    }
-                    err.print(args.error_format);
-                }
-                if (has_errors) {
-                    return 10;
-                }
-            }
-            if (args.save_intermediate_spirv) {
-                if (!spirv[i].write_to_file(args, inp, slang)) {
-                    return 10;
-                }
-            }
-        }
+    // record per-stage timings (--timings)
+    if (!args.timings.empty()) {
+        Timings::enable();
+    }
+    // profile the SPIRV optimizer pass by pass (--spirv-opt-profile)
+    if (!args.spirv_opt_profile.empty()) {
+        OptProfile::enable();
+    }
+    // count heap allocations per pipeline stage (--mem-stats)
+    if (!args.mem_stats.empty()) {
+        MemStats::enable();
     }
 
-    // cross-translate SPIRV to shader dialects
-    std::array<Spirvcross,Slang::Num> spirvcross;
-    for (int i = 0; i < Slang::Num; i++) {
-        Slang::Enum slang = Slang::from_index(i);
-        if (args.slang & Slang::bit(slang)) {
-            spirvcross[i] = Spirvcross::translate(inp, spirv[i], slang);
-            if (args.debug_dump) {
-                spirvcross[i].dump_debug(args.error_format, slang);
-            }
-            if (spirvcross[i].error.valid()) {
-                spirvcross[i].error.print(args.error_format);
-                return 10;
-            }
-        }
+    // run the compilation pipeline for a single input file, for all jobs in a batch manifest,
+    // or for all requests sent to the compile server, in watch mode, recompile on file changes,
+    // in language server mode, validate the documents opened in an editor, in stream mode
+    // read from stdin or an input bundle and write to stdout or an output bundle
+    int exit_code = 0;
+    if (!args.server.empty()) {
+        exit_code = Server::run(args, cache);
+    } else if (args.lsp) {
+        exit_code = Lsp::run(args);
+    } else if (args.watch) {
+        exit_code = Watch::run(args, cache);
+    } else if (!args.batch.empty()) {
+        exit_code = Batch::run(args, cache);
+    } else if (Stream::enabled(args)) {
+        exit_code = Stream::run(args, cache);
+    } else {
+        const Pipeline res = Pipeline::run(args, cache);
+        res.print(args.error_format);
+        exit_code = res.exit_code;
     }
 
-    // compile shader-byte code if requested (HLSL / Metal)
-    std::array<Bytecode, Slang::Num> bytecode;
-    if (args.byte_code) {
-        for (int i = 0; i < Slang::Num; i++) {
-            Slang::Enum slang = Slang::from_index(i);
-            if (args.slang & Slang::bit(slang)) {
-                bytecode[i] = Bytecode::compile(args, inp, spirvcross[i], slang);
-                if (args.debug_dump) {
-                    bytecode[i].dump_debug();
-                }
-                if (!bytecode[i].errors.empty()) {
-                    bool has_errors = false;
-                    for (const ErrMsg& err: bytecode[i].errors) {
-                        if (err.type == ErrMsg::ERROR) {
-                            has_errors = true;
-                        }
-                        err.print(args.error_format);
-                    }
-                    if (has_errors) {
-                        return 10;
-                    }
-                }
-            }
+    if (args.debug_dump) {
+        fmt::print(stderr, "Jobs:\n");
+        fmt::print(stderr, "  jobserver: {}\n", Jobs::jobserver_active());
+        if (Jobs::jobserver_present() && !Jobs::jobserver_active()) {
+            fmt::print(stderr, "  jobserver_unusable: true (MAKEFLAGS has a jobserver which can't be used, all tasks run on a single thread)\n");
         }
+        fmt::print(stderr, "  max_concurrent_tasks: {}\n\n", Jobs::max_concurrent_tasks());
     }
 
-    // build merged Reflection info
-    const Reflection refl = Reflection::build(args, inp, spirvcross);
-    if (refl.error.valid()) {
-        refl.error.print(args.error_format);
-        return 10;
+    // in the long-running modes, this only reports the events since the last request or rebuild
+    if (!args.timings.empty()) {
+        if (!Timings::write_report(args.timings)) {
+            fmt::print(stderr, "sokol-shdc: failed to write timings to '{}'\n", args.timings);
+            exit_code = 10;
+        }
     }
-    if (args.debug_dump) {
-        refl.dump_debug(args.error_format);
+    if (!args.spirv_opt_profile.empty()) {
+        OptProfile::print_summary();
+        if (!OptProfile::write_report(args.spirv_opt_profile)) {
+            fmt::print(stderr, "sokol-shdc: failed to write SPIRV optimizer profile to '{}'\n", args.spirv_opt_profile);
+            exit_code = 10;
+        }
     }
-
-    // generate output files
-    const GenInput gen_input(args, inp, spirvcross, bytecode, refl);
-    ErrMsg gen_error = generate(args.output_format, gen_input);
-    if (gen_error.valid()) {
-        gen_error.print(args.error_format);
-        return 10;
+    if (!args.mem_stats.empty()) {
+        MemStats::print_summary();
+        if (!MemStats::write_report(args.mem_stats)) {
+            fmt::print(stderr, "sokol-shdc: failed to write heap allocation statistics to '{}'\n", args.mem_stats);
+            exit_code = 10;
+        }
     }
 
-    // success
+    // evict least recently used cache entries
+    cache.trim();
+
     Spirv::finalize_spirv_tools();
-    return 0;
+    return exit_code;
 }
@@ -0,0 +1,135 @@
+/*
+    Heap allocation statistics per pipeline stage (--mem-stats).
+
+    Each pipeline step sets the stage of the calling thread with a
+    MemStats::Scope, worker threads started by Jobs::run() inherit it.
+    While enabled, every allocation is counted in the stage of the
+    allocating thread, together with the allocated bytes, and the peak of
+    the total heap size (over all threads) is tracked while a stage runs.
+    Allocations are freed in whatever stage releases them, so the peak of
+    a stage is the largest heap size seen while any thread was in it.
+    The heap size when a stage's Scope was last entered and left shows
+    how much memory a stage leaves behind for the following stages.
+
+    The counters are relaxed atomics and must not allocate, since they
+    are updated from within operator new.
+*/
+#include "memstats.h"
+#include "json.h"
+#include "output.h"
+#include "fmt/format.h"
+#include <atomic>
+
+namespace shdc {
+
+static std::atomic<bool> stats_enabled(false);
+static std::atomic<uint64_t> num_allocs[MemStats::NUM];
+static std::atomic<uint64_t> num_bytes[MemStats::NUM];
+static std::atomic<int64_t> peak_bytes[MemStats::NUM];
+static std::atomic<int64_t> entry_bytes[MemStats::NUM];
+static std::atomic<int64_t> exit_bytes[MemStats::NUM];
+static std::atomic<int64_t> heap_bytes(0);
+static std::atomic<int64_t> max_heap_bytes(0);
+static thread_local MemStats::Stage cur_stage = MemStats::OTHER;
+
+static void update_max(std::atomic<int64_t>& max_val, int64_t val) {
+    int64_t cur = max_val.load(std::memory_order_relaxed);
+    while ((val > cur) && !max_val.compare_exchange_weak(cur, val, std::memory_order_relaxed)) { }
+}
+
+MemStats::Scope::Scope(Stage stage) {
+    prev_stage = cur_stage;
+    cur_stage = stage;
+    if (enabled()) {
+        entry_bytes[stage].store(heap_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+MemStats::Scope::~Scope() {
+    if (enabled()) {
+        exit_bytes[cur_stage].store(heap_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    cur_stage = prev_stage;
+}
+
+void MemStats::enable() {
+    stats_enabled = true;
+}
+
+bool MemStats::enabled() {
+    return stats_enabled.load(std::memory_order_relaxed);
+}
+
+const char* MemStats::stage_name(Stage stage) {
+    switch (stage) {
+        case INPUT:         return "input";
+        case COMPILE_GLSL:  return "compile_glsl";
+        case TRANSLATE:     return "translate";
+        case BYTECODE:      return "bytecode";
+        case REFLECTION:    return "reflection";
+        case GENERATE:      return "generate";
+        default:            return "other";
+    }
+}
+
+MemStats::Stage MemStats::thread_stage() {
+    return cur_stage;
+}
+
+void MemStats::set_thread_stage(Stage stage) {
+    cur_stage = stage;
+}
+
+void MemStats::on_alloc(size_t size) {
+    const Stage stage = cur_stage;
+    num_allocs[stage].fetch_add(1, std::memory_order_relaxed);
+    num_bytes[stage].fetch_add(size, std::memory_order_relaxed);
+    const int64_t heap = heap_bytes.fetch_add((int64_t)size, std::memory_order_relaxed) + (int64_t)size;
+    update_max(peak_bytes[stage], heap);
+    update_max(max_heap_bytes, heap);
+}
+
+void MemStats::on_free(size_t size) {
+    // allocations made before --mem-stats was enabled may make this negative
+    heap_bytes.fetch_sub((int64_t)size, std::memory_order_relaxed);
+}
+
+uint64_t MemStats::total_allocs() {
+    uint64_t res = 0;
+    for (int i = 0; i < NUM; i++) {
+        res += num_allocs[i].load(std::memory_order_relaxed);
+    }
+    return res;
+}
+
+bool MemStats::write_report(const std::string& path) {
+    Json report = Json::make_object();
+    report.set("peak_bytes", Json::make_number((double)max_heap_bytes.load()));
+    Json& stages = report.set("stages", Json::make_array());
+    for (int i = 0; i < NUM; i++) {
+        Json stage = Json::make_object();
+        stage.set("name", Json::make_string(stage_name((Stage)i)));
+        stage.set("allocs", Json::make_number((double)num_allocs[i].load()));
+        stage.set("bytes", Json::make_number((double)num_bytes[i].load()));
+        stage.set("peak_bytes", Json::make_number((double)peak_bytes[i].load()));
+        stage.set("entry_bytes", Json::make_number((double)entry_bytes[i].load()));
+        stage.set("exit_bytes", Json::make_number((double)exit_bytes[i].load()));
+        stages.push(std::move(stage));
+    }
+    return Output::write_atomic(path, report.dump() + "\n");
+}
+
+void MemStats::print_summary() {
+    fmt::print(stderr, "Heap allocations (peak: {:.3f} MB):\n", max_heap_bytes.load() / (1024.0 * 1024.0));
+    fmt::print(stderr, "  {:<16} {:>12} {:>14} {:>12}\n", "stage", "allocs", "allocated MB", "peak MB");
+    for (int i = 0; i < NUM; i++) {
+        fmt::print(stderr, "  {:<16} {:>12} {:>14.3f} {:>12.3f}\n",
+            stage_name((Stage)i),
+            num_allocs[i].load(),
+            num_bytes[i].load() / (1024.0 * 1024.0),
+            peak_bytes[i].load() / (1024.0 * 1024.0));
+    }
+    fmt::print(stderr, "\n");
+}
+
+} // namespace shdc
@@ -0,0 +1,52 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace shdc {
+
+// optional heap allocation statistics per pipeline stage (--mem-stats), the counting
+// global operator new and delete are in memstats_new.h, which is only included by the
+// sokol-shdc and sokol-shdc-bench executables (and not by other users of the shdc library)
+struct MemStats {
+    enum Stage {
+        OTHER = 0,      // everything outside the following stages (args, batch, server, ...)
+        INPUT,          // loading and parsing the input and @include files
+        COMPILE_GLSL,   // GLSL to SPIRV compilation and optimization
+        TRANSLATE,      // SPIRV to target language translation and reflection parsing
+        BYTECODE,       // HLSL and Metal bytecode compilation
+        REFLECTION,     // merging the reflection info of all programs
+        GENERATE,       // code generation and writing output files
+        NUM,
+    };
+    // sets the stage of the calling thread for the lifetime of the scope, and records
+    // the heap size when the scope is entered and left
+    struct Scope {
+        Scope(Stage stage);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        Stage prev_stage = OTHER;
+    };
+
+    static void enable();
+    static bool enabled();
+    static const char* stage_name(Stage stage);
+    // the stage which allocations on the calling thread are counted in, worker
+    // threads inherit the stage of the thread which started them (see Jobs::run())
+    static Stage thread_stage();
+    static void set_thread_stage(Stage stage);
+    // called by the global operator new and delete with the usable size of the allocation,
+    // an allocation is counted in the stage of the allocating thread
+    static void on_alloc(size_t size);
+    static void on_free(size_t size);
+    // the number of allocations over all stages so far
+    static uint64_t total_allocs();
+    // write the per-stage allocation counts, allocated bytes, peak heap size and
+    // the heap size on entering and leaving the stage as JSON
+    static bool write_report(const std::string& path);
+    // print the per-stage statistics to stderr
+    static void print_summary();
+};
+
+} // namespace shdc
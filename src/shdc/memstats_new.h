@@ -0,0 +1,172 @@
+#pragma once
+/*
+    Counting global operator new and delete for --mem-stats (see memstats.h).
+
+    This header defines the replacement operators, it must be included in
+    exactly one translation unit of an executable (the main.cc of sokol-shdc
+    and sokol-shdc-bench), so that other users of the shdc library don't
+    have their allocators replaced. While disabled this only costs a flag
+    check, the usable size of an allocation is taken from the allocator
+    so that no size header is needed (not available on WASI).
+*/
+#include "memstats.h"
+#include <stdlib.h>
+#include <new>
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#elif !defined(__wasi__)
+#include <malloc.h>
+#endif
+
+#if !defined(__wasi__)
+static size_t usable_size(void* ptr, size_t align) {
+    #if defined(__APPLE__)
+    return malloc_size(ptr);
+    #elif defined(_WIN32)
+    return (align > 0) ? _aligned_msize(ptr, align, 0) : _msize(ptr);
+    #else
+    return malloc_usable_size(ptr);
+    #endif
+}
+
+// align is 0 for the operators without std::align_val_t
+static void* counted_alloc(size_t size, size_t align) {
+    if (size == 0) {
+        size = 1;
+    }
+    void* ptr = nullptr;
+    if (align == 0) {
+        ptr = malloc(size);
+    } else {
+        #if defined(_WIN32)
+        ptr = _aligned_malloc(size, align);
+        #else
+        if (0 != posix_memalign(&ptr, (align < sizeof(void*)) ? sizeof(void*) : align, size)) {
+            ptr = nullptr;
+        }
+        #endif
+    }
+    if (ptr && shdc::MemStats::enabled()) {
+        shdc::MemStats::on_alloc(usable_size(ptr, align));
+    }
+    return ptr;
+}
+
+static void counted_free(void* ptr, size_t align) {
+    if (ptr && shdc::MemStats::enabled()) {
+        shdc::MemStats::on_free(usable_size(ptr, align));
+    }
+    #if defined(_WIN32)
+    if (align > 0) {
+        _aligned_free(ptr);
+        return;
+    }
+    #endif
+    free(ptr);
+}
+
+// the throwing operator new calls the new-handler until the allocation succeeds,
+// or throws std::bad_alloc if there is none
+static void* counted_new(size_t size, size_t align) {
+    while (true) {
+        void* ptr = counted_alloc(size, align);
+        if (ptr) {
+            return ptr;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+// the nothrow operator new behaves like the throwing one, but returns nullptr
+static void* counted_new_nothrow(size_t size, size_t align) noexcept {
+    try {
+        return counted_new(size, align);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new(size_t size) {
+    return counted_new(size, 0);
+}
+
+void* operator new[](size_t size) {
+    return counted_new(size, 0);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return counted_new_nothrow(size, 0);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return counted_new_nothrow(size, 0);
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+    return counted_new(size, (size_t)align);
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+    return counted_new(size, (size_t)align);
+}
+
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return counted_new_nothrow(size, (size_t)align);
+}
+
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return counted_new_nothrow(size, (size_t)align);
+}
+
+void operator delete(void* ptr) noexcept {
+    counted_free(ptr, 0);
+}
+
+void operator delete[](void* ptr) noexcept {
+    counted_free(ptr, 0);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    counted_free(ptr, 0);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    counted_free(ptr, 0);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    counted_free(ptr, 0);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    counted_free(ptr, 0);
+}
+
+void operator delete(void* ptr, std::align_val_t align) noexcept {
+    counted_free(ptr, (size_t)align);
+}
+
+void operator delete[](void* ptr, std::align_val_t align) noexcept {
+    counted_free(ptr, (size_t)align);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t align) noexcept {
+    counted_free(ptr, (size_t)align);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t align) noexcept {
+    counted_free(ptr, (size_t)align);
+}
+
+void operator delete(void* ptr, std::align_val_t align, const std::nothrow_t&) noexcept {
+    counted_free(ptr, (size_t)align);
+}
+
+void operator delete[](void* ptr, std::align_val_t align, const std::nothrow_t&) noexcept {
+    counted_free(ptr, (size_t)align);
+}
+#endif
@@ -0,0 +1,163 @@
+/*
+    SPIRV optimizer pass profiler (--spirv-opt-profile).
+
+    The optimizer passes are run one by one on a copy of each SPIRV module
+    (see spirv_optimize_profile() in spirv.cc), for each pass the wall time
+    and the instruction count, function count and module size before and
+    after the pass are recorded. The report aggregates the runs by pass
+    position in the pipeline (the same pass may run several times), so that
+    passes which rarely change anything or cost a lot of time for little
+    gain stand out.
+*/
+#include "optprofile.h"
+#include "json.h"
+#include "output.h"
+#include "fmt/format.h"
+#include <atomic>
+#include <mutex>
+
+namespace shdc {
+
+static std::atomic<bool> profile_enabled(false);
+static std::mutex modules_mutex;
+static std::vector<OptProfile::Module> modules;
+
+// aggregated runs of the pass at one position in the optimizer pipeline
+struct PassTotals {
+    const char* name = nullptr;
+    int num_runs = 0;
+    int num_changed = 0;    // runs which changed the instruction count, function count or size
+    uint64_t time_us = 0;
+    int64_t instructions_removed = 0;
+    int64_t functions_removed = 0;
+    int64_t bytes_removed = 0;
+};
+
+static std::vector<PassTotals> pass_totals() {
+    std::vector<PassTotals> totals;
+    for (const OptProfile::Module& module: modules) {
+        for (size_t i = 0; i < module.passes.size(); i++) {
+            const OptProfile::PassRun& run = module.passes[i];
+            if (i >= totals.size()) {
+                totals.push_back(PassTotals());
+                totals.back().name = run.name;
+            }
+            PassTotals& total = totals[i];
+            total.num_runs++;
+            if ((run.before.num_instructions != run.after.num_instructions) ||
+                (run.before.num_functions != run.after.num_functions) ||
+                (run.before.size != run.after.size))
+            {
+                total.num_changed++;
+            }
+            total.time_us += run.time_us;
+            total.instructions_removed += run.before.num_instructions - run.after.num_instructions;
+            total.functions_removed += run.before.num_functions - run.after.num_functions;
+            total.bytes_removed += run.before.size - run.after.size;
+        }
+    }
+    return totals;
+}
+
+void OptProfile::enable() {
+    profile_enabled = true;
+}
+
+bool OptProfile::enabled() {
+    return profile_enabled.load(std::memory_order_relaxed);
+}
+
+OptProfile::ModuleStats OptProfile::module_stats(const std::vector<uint32_t>& spirv) {
+    // skip the 5-word module header, the high 16 bits of the first word
+    // of each instruction is the instruction's word count
+    static const uint32_t op_function = 54;
+    ModuleStats stats;
+    stats.size = (int)(spirv.size() * sizeof(uint32_t));
+    size_t pos = 5;
+    while (pos < spirv.size()) {
+        const uint32_t word_count = spirv[pos] >> 16;
+        const uint32_t opcode = spirv[pos] & 0xFFFF;
+        if (word_count == 0) {
+            break;
+        }
+        stats.num_instructions++;
+        if (opcode == op_function) {
+            stats.num_functions++;
+        }
+        pos += word_count;
+    }
+    return stats;
+}
+
+void OptProfile::add(Module&& module) {
+    std::lock_guard<std::mutex> lock(modules_mutex);
+    modules.push_back(std::move(module));
+}
+
+static Json stats_to_json(const OptProfile::ModuleStats& stats) {
+    Json res = Json::make_object();
+    res.set("instructions", Json::make_number(stats.num_instructions));
+    res.set("functions", Json::make_number(stats.num_functions));
+    res.set("size", Json::make_number(stats.size));
+    return res;
+}
+
+bool OptProfile::write_report(const std::string& path) {
+    std::lock_guard<std::mutex> lock(modules_mutex);
+    Json report = Json::make_object();
+    Json& passes = report.set("passes", Json::make_array());
+    const std::vector<PassTotals> totals = pass_totals();
+    for (size_t i = 0; i < totals.size(); i++) {
+        const PassTotals& total = totals[i];
+        Json pass = Json::make_object();
+        pass.set("index", Json::make_number((double)i));
+        pass.set("name", Json::make_string(total.name));
+        pass.set("runs", Json::make_number(total.num_runs));
+        pass.set("changed", Json::make_number(total.num_changed));
+        pass.set("time_us", Json::make_number((double)total.time_us));
+        pass.set("instructions_removed", Json::make_number((double)total.instructions_removed));
+        pass.set("functions_removed", Json::make_number((double)total.functions_removed));
+        pass.set("bytes_removed", Json::make_number((double)total.bytes_removed));
+        passes.push(std::move(pass));
+    }
+    Json& mods = report.set("modules", Json::make_array());
+    for (const Module& module: modules) {
+        Json mod = Json::make_object();
+        mod.set("file", Json::make_string(module.path));
+        mod.set("snippet", Json::make_string(module.snippet_name));
+        mod.set("slang", Json::make_string(Slang::to_str(module.slang)));
+        Json& runs = mod.set("passes", Json::make_array());
+        for (const PassRun& run: module.passes) {
+            Json item = Json::make_object();
+            item.set("name", Json::make_string(run.name));
+            item.set("time_us", Json::make_number((double)run.time_us));
+            item.set("before", stats_to_json(run.before));
+            item.set("after", stats_to_json(run.after));
+            runs.push(std::move(item));
+        }
+        mods.push(std::move(mod));
+    }
+    return Output::write_atomic(path, report.dump() + "\n");
+}
+
+void OptProfile::print_summary() {
+    std::lock_guard<std::mutex> lock(modules_mutex);
+    fmt::print(stderr, "SPIRV optimizer passes ({} modules):\n", modules.size());
+    fmt::print(stderr, "  {:>3} {:<32} {:>8} {:>8} {:>10} {:>12} {:>10} {:>10}\n", "#", "pass", "runs", "changed", "time ms", "instrs +/-", "funcs +/-", "bytes +/-");
+    const std::vector<PassTotals> totals = pass_totals();
+    for (size_t i = 0; i < totals.size(); i++) {
+        const PassTotals& total = totals[i];
+        fmt::print(stderr, "  {:>3} {:<32} {:>8} {:>8} {:>10.3f} {:>12} {:>10} {:>10}\n",
+            i,
+            total.name,
+            total.num_runs,
+            total.num_changed,
+            total.time_us / 1000.0,
+            -total.instructions_removed,
+            -total.functions_removed,
+            -total.bytes_removed);
+    }
+    fmt::print(stderr, "\n");
+}
+
+} // namespace shdc
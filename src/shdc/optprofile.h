@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "types/slang.h"
+
+namespace shdc {
+
+// SPIRV optimizer pass profiler (--spirv-opt-profile), collects the time and
+// module statistics of each optimizer pass for every compiled snippet, and
+// aggregates them over all compiled input files
+struct OptProfile {
+    struct ModuleStats {
+        int num_instructions = 0;
+        int num_functions = 0;
+        int size = 0;           // module size in bytes
+    };
+    // a single optimizer pass run on one module
+    struct PassRun {
+        const char* name = nullptr;     // spirv-opt flag name of the pass
+        uint64_t time_us = 0;
+        ModuleStats before;
+        ModuleStats after;
+    };
+    // all pass runs on one snippet compilation, passes are in pipeline order, a compilation
+    // which is shared by several shader languages with the same glslang input (see
+    // Spirv::compile_glsl()) is recorded once for each of them
+    struct Module {
+        std::string path;
+        std::string snippet_name;
+        Slang::Enum slang = Slang::Num;
+        std::vector<PassRun> passes;
+    };
+
+    static void enable();
+    static bool enabled();
+    // count the instructions and functions of a SPIRV module
+    static ModuleStats module_stats(const std::vector<uint32_t>& spirv);
+    // record the pass runs on one module (thread-safe)
+    static void add(Module&& module);
+    // write the per-module pass runs and the per-pass aggregates as JSON
+    static bool write_report(const std::string& path);
+    // print the per-pass aggregates to stderr
+    static void print_summary();
+};
+
+} // namespace shdc
@@ -0,0 +1,114 @@
+/*
+    Output file helpers.
+
+    Output files are written atomically (to a temporary file which is then
+    renamed into place) so that build systems and concurrent sokol-shdc
+    processes never see partially written files, and generated files are
+    only written when their content changes, so that the modification time
+    of unchanged files is preserved and dependent build steps don't rerun.
+*/
+#include "output.h"
+#include "timings.h"
+#include "fmt/format.h"
+#include <stdio.h>
+#include <atomic>
+#include <filesystem>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace shdc {
+
+// a unique temporary file name, also unique across processes writing to the same directory
+static std::string temp_path(const std::string& path) {
+    static std::atomic<uint64_t> counter(0);
+    static const uint64_t process_id = []() {
+        std::random_device rd;
+        return ((uint64_t)rd() << 32) | (uint64_t)rd();
+    }();
+    return fmt::format("{}.{:016x}_{}.tmp", path, process_id, counter++);
+}
+
+static bool file_has_content(const std::string& path, const std::string& data) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    const long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    bool res = false;
+    if ((file_size >= 0) && ((size_t)file_size == data.size())) {
+        std::string file_data(data.size(), 0);
+        res = (fread(&file_data[0], 1, data.size(), fp) == data.size()) && (file_data == data);
+    }
+    fclose(fp);
+    return res;
+}
+
+bool Output::write_atomic(const std::string& path, const std::string& data) {
+    const std::string tmp_path = temp_path(path);
+    FILE* fp = fopen(tmp_path.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    const bool written = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    const bool closed = fclose(fp) == 0;
+    std::error_code ec;
+    if (written && closed) {
+        fs::rename(tmp_path, path, ec);
+    }
+    if (!written || !closed || ec) {
+        fs::remove(tmp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+bool Output::write_if_changed(const std::string& path, const std::string& data, bool text) {
+    Timings::Scope timing("write_file", path.c_str());
+    #if defined(_WIN32)
+    if (text) {
+        std::string crlf_data;
+        crlf_data.reserve(data.size() + data.size() / 16);
+        for (const char c: data) {
+            if (c == '\n') {
+                crlf_data += '\r';
+            }
+            crlf_data += c;
+        }
+        return file_has_content(path, crlf_data) || write_atomic(path, crlf_data);
+    }
+    #endif
+    return file_has_content(path, data) || write_atomic(path, data);
+}
+
+// escape a path for use in a Make/Ninja depfile
+static std::string depfile_escape(const std::string& path) {
+    std::string res;
+    for (const char c: path) {
+        if ((c == ' ') || (c == '#')) {
+            res += '\\';
+        } else if (c == '$') {
+            res += '$';
+        }
+        res += c;
+    }
+    return res;
+}
+
+bool Output::write_depfile(const std::string& path, const std::vector<std::string>& targets, const std::vector<std::string>& deps) {
+    std::string content;
+    for (const std::string& target: targets) {
+        content += content.empty() ? "" : " ";
+        content += depfile_escape(target);
+    }
+    content += ":";
+    for (const std::string& dep: deps) {
+        content += fmt::format(" \\\n  {}", depfile_escape(dep));
+    }
+    content += "\n";
+    return write_if_changed(path, content, false);
+}
+
+} // namespace shdc
@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace shdc {
+
+// a generated output file which is returned in memory instead of written (see Compiler::compile)
+struct OutputFile {
+    std::string path;
+    std::string content;
+    bool text = true;   // false for binary files (e.g. bytecode from the bare generator)
+};
+
+// helper functions for writing output files
+struct Output {
+    // atomically replace the file at path (via a temporary file and rename)
+    static bool write_atomic(const std::string& path, const std::string& data);
+    // atomically replace the file at path, but only if its content would change,
+    // in text mode, line endings are converted to the platform convention
+    static bool write_if_changed(const std::string& path, const std::string& data, bool text);
+    // write a Make/Ninja-compatible depfile, all targets depend on all deps
+    static bool write_depfile(const std::string& path, const std::vector<std::string>& targets, const std::vector<std::string>& deps);
+};
+
+} // namespace shdc
@@ -0,0 +1,211 @@
+/*
+    The sokol-shdc compilation pipeline for a single input file.
+*/
+#include "pipeline.h"
+#include "input.h"
+#include "spirv.h"
+#include "spirvcross.h"
+#include "bytecode.h"
+#include "reflection.h"
+#include "output.h"
+#include "generators/generate.h"
+
+namespace shdc {
+
+using namespace refl;
+using namespace gen;
+
+// append messages to the pipeline result, returns true if any of the messages is an error
+static bool add_messages(Pipeline& res, const std::vector<ErrMsg>& messages) {
+    bool has_errors = false;
+    for (const ErrMsg& msg: messages) {
+        if (msg.type == ErrMsg::ERROR) {
+            has_errors = true;
+        }
+        res.messages.push_back(msg);
+    }
+    return has_errors;
+}
+
+static Pipeline failed(Pipeline& res) {
+    res.exit_code = 10;
+    return res;
+}
+
+// load and parse the input file, and apply the optional --programs filter
+static Input load_input(const Args& args, const Input::FileLoader& loader) {
+    Input inp = Input::load_and_parse(args.input, args.module, loader);
+    if (!inp.out_error.valid() && !args.programs.empty()) {
+        inp.out_error = inp.select_programs(args.programs);
+    }
+    return inp;
+}
+
+static Pipeline run_check(const Args& args, const Input::FileLoader& loader) {
+    Pipeline res;
+    const Input inp = load_input(args, loader);
+    res.filenames = inp.filenames;
+    if (inp.out_error.valid()) {
+        res.messages.push_back(inp.out_error);
+        return failed(res);
+    }
+
+    // check with the first requested shader language, or GLSL 4.3 if none was requested
+    Slang::Enum slang = Slang::GLSL430;
+    for (int i = 0; i < Slang::Num; i++) {
+        if (args.slang & Slang::bit(Slang::from_index(i))) {
+            slang = Slang::from_index(i);
+            break;
+        }
+    }
+    const Spirv spirv = Spirv::check_glsl(inp, slang, args.defines, args.num_jobs);
+    const bool compile_errors = add_messages(res, spirv.errors);
+    const bool validate_errors = add_messages(res, Spirvcross::validate(inp, spirv, args.num_jobs));
+    if (compile_errors || validate_errors) {
+        return failed(res);
+    }
+    return res;
+}
+
+static Pipeline run_pipeline(const Args& args, const Cache& shared_cache, const Input::FileLoader& loader, bool in_memory) {
+    if (args.check) {
+        return run_check(args, loader);
+    }
+    Pipeline res;
+
+    // with --incremental, the compilation results used for the output file are recorded
+    // in a manifest next to it, and without --cache-dir, kept in a directory next to it
+    const bool incremental = args.incremental && !in_memory;
+    const Cache cache = incremental ? shared_cache.with_manifest(args.output + ".shdc-manifest", args.output + ".shdc-cache") : shared_cache;
+
+    // load the source and parse tagged blocks, @vs and @fs snippets which are not
+    // used by any (selected) @program are skipped by all following steps
+    const Input inp = load_input(args, loader);
+    res.filenames = inp.filenames;
+    if (args.debug_dump) {
+        inp.dump_debug(args.error_format);
+    }
+    if (inp.out_error.valid()) {
+        res.messages.push_back(inp.out_error);
+        return failed(res);
+    }
+
+    // compile source snippets to SPIRV blobs (multiple compilations is necessary
+    // because of conditional compilation by target language)
+    // the slang x snippet matrix is compiled in parallel, errors are reported
+    // in the same order as a serial compilation would
+    // with --load-intermediate-spirv, up-to-date SPIRV files from an earlier
+    // --save-intermediate-spirv run are used instead of compiling the snippet
+    // the merged GLSL sources are only kept when they are written or dumped
+    const bool keep_sources = args.save_intermediate_spirv || args.debug_dump;
+    std::array<Spirv,Slang::Num> spirv = Spirv::compile_glsl(inp, args.slang, args.defines, args.num_jobs, cache, keep_sources, args.load_intermediate_spirv ? &args.tmpdir : nullptr);
+    for (int i = 0; i < Slang::Num; i++) {
+        Slang::Enum slang = Slang::from_index(i);
+        if (args.slang & Slang::bit(slang)) {
+            if (args.debug_dump) {
+                spirv[i].dump_debug(inp, args.error_format);
+            }
+            if (add_messages(res, spirv[i].errors)) {
+                return failed(res);
+            }
+            if (args.save_intermediate_spirv) {
+                if (!spirv[i].write_to_file(args, inp, slang)) {
+                    return failed(res);
+                }
+            }
+        }
+    }
+
+    // cross-translate SPIRV to shader dialects
+    // (the slang x snippet matrix is translated in parallel)
+    std::array<Spirvcross,Slang::Num> spirvcross = Spirvcross::translate(inp, spirv, args.slang, args.num_jobs, cache);
+    // the SPIRV blobs aren't needed by any of the following steps, release them
+    // before the bytecode compilation and code generation which allocate the most
+    spirv = {};
+    for (int i = 0; i < Slang::Num; i++) {
+        Slang::Enum slang = Slang::from_index(i);
+        if (args.slang & Slang::bit(slang)) {
+            if (args.debug_dump) {
+                spirvcross[i].dump_debug(args.error_format, slang);
+            }
+            if (spirvcross[i].error.valid()) {
+                res.messages.push_back(spirvcross[i].error);
+                return failed(res);
+            }
+        }
+    }
+
+    // compile shader-byte code if requested (HLSL / Metal)
+    std::array<Bytecode, Slang::Num> bytecode;
+    if (args.byte_code) {
+        for (int i = 0; i < Slang::Num; i++) {
+            Slang::Enum slang = Slang::from_index(i);
+            if (args.slang & Slang::bit(slang)) {
+                bytecode[i] = Bytecode::compile(args, inp, spirvcross[i], slang, cache);
+                if (args.debug_dump) {
+                    bytecode[i].dump_debug();
+                }
+                if (add_messages(res, bytecode[i].errors)) {
+                    return failed(res);
+                }
+            }
+        }
+    }
+
+    // build merged Reflection info
+    const Reflection refl = Reflection::build(args, inp, spirvcross);
+    if (refl.error.valid()) {
+        res.messages.push_back(refl.error);
+        return failed(res);
+    }
+    if (args.debug_dump) {
+        refl.dump_debug(args.error_format);
+    }
+
+    // generate output files, with multiple output formats the code generators
+    // run in parallel on the same compilation results
+    GenInput gen_input(args, inp, spirvcross, bytecode, refl);
+    if (in_memory) {
+        gen_input.output_files = &res.output_files;
+        res.reflection = refl;
+    }
+    ErrMsg gen_error = generate_all(gen_input);
+    if (gen_error.valid()) {
+        res.messages.push_back(gen_error);
+        return failed(res);
+    }
+    if (incremental) {
+        cache.save_manifest();
+    }
+
+    // write the optional depfile for build system integration
+    std::vector<std::string> targets = { args.output };
+    for (const Args::ExtraOutput& extra: args.extra_outputs) {
+        targets.push_back(extra.path);
+    }
+    if (!in_memory && !args.depfile.empty() && !Output::write_depfile(args.depfile, targets, res.filenames)) {
+        res.messages.push_back(ErrMsg::error(args.depfile, 0, "failed to write depfile"));
+        return failed(res);
+    }
+    return res;
+}
+
+Pipeline Pipeline::run(const Args& args, const Cache& cache) {
+    return run_pipeline(args, cache, nullptr, false);
+}
+
+Pipeline Pipeline::run_in_memory(const Args& args, const Cache& cache, const Input::FileLoader& loader) {
+    return run_pipeline(args, cache, loader, true);
+}
+
+Pipeline Pipeline::check(const Args& args) {
+    return run_check(args, nullptr);
+}
+
+void Pipeline::print(ErrMsg::Format err_fmt) const {
+    for (const ErrMsg& msg: messages) {
+        msg.print(err_fmt);
+    }
+}
+
+} // namespace shdc
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include "args.h"
+#include "cache.h"
+#include "input.h"
+#include "output.h"
+#include "reflection.h"
+#include "types/errmsg.h"
+
+namespace shdc {
+
+// runs all compilation steps for one input file, from loading the input to
+// writing the generated output, errors and warnings are collected instead of
+// printed so that concurrently running pipelines don't interleave their output
+struct Pipeline {
+    int exit_code = 0;
+    std::vector<ErrMsg> messages;   // errors and warnings in the order they happened
+    std::vector<std::string> filenames; // all source files which were read (input and @include files)
+    std::vector<OutputFile> output_files;   // generated files (only with run_in_memory())
+    refl::Reflection reflection;    // merged reflection info (only with run_in_memory())
+
+    // with --check, only run the steps described in check()
+    static Pipeline run(const Args& args, const Cache& cache);
+    // run the pipeline with an optional virtual file loader, and return the generated
+    // files in memory instead of writing them (--incremental and --depfile are ignored)
+    static Pipeline run_in_memory(const Args& args, const Cache& cache, const Input::FileLoader& loader);
+    // only check for errors (--check): parse the input, compile all snippets for a single
+    // shader language without optimization, and validate resource restrictions
+    static Pipeline check(const Args& args);
+    void print(ErrMsg::Format err_fmt) const;
+};
+
+} // namespace shdc
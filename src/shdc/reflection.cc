@@ -3,6 +3,9 @@
 */
 #include "reflection.h"
 #include "spirvcross.h"
+#include "timings.h"
+#include "memstats.h"
+#include <unordered_map>
 
 // workaround for Compiler.comparison_ids being protected
 class UnprotectedCompiler: spirv_cross::Compiler {
@@ -72,6 +75,8 @@ static ErrMsg validate_linking(const Input& inp, const Program& prog, const Prog
 }
 
 Reflection Reflection::build(const Args& args, const Input& inp, const std::array<Spirvcross,Slang::Num>& spirvcross_array) {
+    Timings::Scope timing("reflection_build");
+    MemStats::Scope mem_stage(MemStats::REFLECTION);
     Reflection res;
 
     // for each program, just pick the reflection info from the first compiled slang
@@ -368,76 +373,89 @@ std::vector<StageAttr> Reflection::merge_vs_inputs(const std::vector<ProgramRefl
 }
 
 Bindings Reflection::merge_bindings(const std::vector<Bindings>& in_bindings, ErrMsg& out_error) {
+    Timings::Scope timing("merge_bindings");
     Bindings out_bindings;
     out_error = ErrMsg();
+    // name => index into the merged bindings, so that merging is linear in the number of snippets
+    std::unordered_map<std::string, size_t> ub_index, sbuf_index, img_index, smp_index, img_smp_index;
     for (const Bindings& src_bindings: in_bindings) {
 
         // merge identical uniform blocks
         for (const UniformBlock& ub: src_bindings.uniform_blocks) {
-            const UniformBlock* other_ub = out_bindings.find_uniform_block_by_name(ub.struct_info.name);
-            if (other_ub) {
+            const auto it = ub_index.find(ub.struct_info.name);
+            if (it != ub_index.end()) {
+                const UniformBlock& other_ub = out_bindings.uniform_blocks[it->second];
                 // another uniform block of the same name exists, make sure it's identical
-                if (!ub.equals(*other_ub)) {
+                if (!ub.equals(other_ub)) {
                     out_error = ErrMsg::error(fmt::format("conflicting uniform block definitions found for '{}'", ub.struct_info.name));
                     return Bindings();
                 }
             } else {
+                ub_index[ub.struct_info.name] = out_bindings.uniform_blocks.size();
                 out_bindings.uniform_blocks.push_back(ub);
             }
         }
 
         // merge identical storage buffers
         for (const StorageBuffer& sbuf: src_bindings.storage_buffers) {
-            const StorageBuffer* other_sbuf = out_bindings.find_storage_buffer_by_name(sbuf.struct_info.name);
-            if (other_sbuf) {
+            const auto it = sbuf_index.find(sbuf.struct_info.name);
+            if (it != sbuf_index.end()) {
+                const StorageBuffer& other_sbuf = out_bindings.storage_buffers[it->second];
                 // another storage buffer of the same name exists, make sure it's identical
-                if (!sbuf.equals(*other_sbuf)) {
+                if (!sbuf.equals(other_sbuf)) {
                     out_error = ErrMsg::error(fmt::format("conflicting storage buffer definitions found for '{}'", sbuf.struct_info.name));
                     return Bindings();
                 }
             } else {
+                sbuf_index[sbuf.struct_info.name] = out_bindings.storage_buffers.size();
                 out_bindings.storage_buffers.push_back(sbuf);
             }
         }
 
         // merge identical images
         for (const Image& img: src_bindings.images) {
-            const Image* other_img = out_bindings.find_image_by_name(img.name);
-            if (other_img) {
+            const auto it = img_index.find(img.name);
+            if (it != img_index.end()) {
+                const Image& other_img = out_bindings.images[it->second];
                 // another image of the same name exists, make sure it's identical
-                if (!img.equals(*other_img)) {
+                if (!img.equals(other_img)) {
                     out_error = ErrMsg::error(fmt::format("conflicting texture definitions found for '{}'", img.name));
                     return Bindings();
                 }
             } else {
+                img_index[img.name] = out_bindings.images.size();
                 out_bindings.images.push_back(img);
             }
         }
 
         // merge identical samplers
         for (const Sampler& smp: src_bindings.samplers) {
-            const Sampler* other_smp = out_bindings.find_sampler_by_name(smp.name);
-            if (other_smp) {
+            const auto it = smp_index.find(smp.name);
+            if (it != smp_index.end()) {
+                const Sampler& other_smp = out_bindings.samplers[it->second];
                 // another sampler of the same name exists, make sure it's identical
-                if (!smp.equals(*other_smp)) {
+                if (!smp.equals(other_smp)) {
                     out_error = ErrMsg::error(fmt::format("conflicting sampler definitions found for '{}'", smp.name));
                     return Bindings();
                 }
             } else {
+                smp_index[smp.name] = out_bindings.samplers.size();
                 out_bindings.samplers.push_back(smp);
             }
         }
 
         // merge image samplers
         for (const ImageSampler& img_smp: src_bindings.image_samplers) {
-            const ImageSampler* other_img_smp = out_bindings.find_image_sampler_by_name(img_smp.name);
-            if (other_img_smp) {
+            const auto it = img_smp_index.find(img_smp.name);
+            if (it != img_smp_index.end()) {
+                const ImageSampler& other_img_smp = out_bindings.image_samplers[it->second];
                 // another image sampler of the same name exists, make sure it's identical
-                if (!img_smp.equals(*other_img_smp)) {
+                if (!img_smp.equals(other_img_smp)) {
                     out_error = ErrMsg::error(fmt::format("conflicting image-sampler definition found for '{}'", img_smp.name));
                     return Bindings();
                 }
             } else {
+                img_smp_index[img_smp.name] = out_bindings.image_samplers.size();
                 out_bindings.image_samplers.push_back(img_smp);
             }
         }
@@ -0,0 +1,396 @@
+/*
+    Compile server mode.
+
+    Requests and responses are JSON-RPC 2.0 messages, one message per line:
+
+    --> {"jsonrpc":"2.0","id":1,"method":"compile","params":{"cwd":"/path","args":["-i","shd.glsl","-o","shd.h","-l","glsl430"]}}
+    <-- {"jsonrpc":"2.0","id":1,"result":{"exit_code":0,"output":"/path/shd.h","messages":[]}}
+
+    The "args" array are regular sokol-shdc cmdline args, relative paths are
+    resolved against "cwd". Messages have the fields "type" ("error" or "warning"),
+    "file", "line" (1-based), "message" and "text" (formatted according
+    to the --errfmt arg of the request). The "shutdown" method stops the server.
+
+    glslang, SPIRV-Cross and Tint stay initialized over the lifetime of the
+    server, and compiled artifacts are kept in an in-memory cache. Requests
+    are handled by a pool of worker threads. In stdio mode, stdout is reserved
+    for responses, any other output is redirected to stderr.
+*/
+#include "server.h"
+#include "pipeline.h"
+#include "jobs.h"
+#include "json.h"
+#include "timings.h"
+#include "fmt/format.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <filesystem>
+#if !defined(__wasi__)
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <iostream>
+#endif
+#if defined(_WIN32)
+#include <io.h>
+#elif !defined(__wasi__)
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace shdc {
+
+// JSON-RPC error codes
+static const int rpc_parse_error = -32700;
+static const int rpc_invalid_request = -32600;
+static const int rpc_method_not_found = -32601;
+static const int rpc_invalid_params = -32602;
+
+static std::string resolve_path(const std::string& cwd, const std::string& path) {
+    if (cwd.empty() || path.empty() || fs::path(path).is_absolute()) {
+        return path;
+    }
+    return (fs::path(cwd) / path).string();
+}
+
+static Json rpc_response(const Json& id, Json result) {
+    Json res = Json::make_object();
+    res.set("jsonrpc", Json::make_string("2.0"));
+    res.set("id", id);
+    res.set("result", std::move(result));
+    return res;
+}
+
+static Json rpc_error(const Json& id, int code, const std::string& msg) {
+    Json err = Json::make_object();
+    err.set("code", Json::make_number(code));
+    err.set("message", Json::make_string(msg));
+    Json res = Json::make_object();
+    res.set("jsonrpc", Json::make_string("2.0"));
+    res.set("id", id);
+    res.set("error", std::move(err));
+    return res;
+}
+
+static Json message_to_json(const ErrMsg& msg, ErrMsg::Format err_fmt) {
+    Json res = Json::make_object();
+    res.set("type", Json::make_string((msg.type == ErrMsg::WARNING) ? "warning" : "error"));
+    res.set("file", Json::make_string(msg.file));
+    res.set("line", Json::make_number(msg.line_index + 1));
+    res.set("message", Json::make_string(msg.msg));
+    res.set("text", Json::make_string(msg.as_string(err_fmt)));
+    return res;
+}
+
+// run a compile request, the params object contains the cmdline args and working directory
+static Json compile(const Json& id, const Json& params, const Args& server_args, const Cache& cache) {
+    const Json* args_json = params.find("args");
+    if (!args_json || !args_json->is_array()) {
+        return rpc_error(id, rpc_invalid_params, "'params.args' must be an array of strings");
+    }
+    const Json* cwd_json = params.find("cwd");
+    const std::string cwd = cwd_json ? cwd_json->as_string("") : "";
+    std::vector<const char*> argv = { "sokol-shdc" };
+    for (const Json& arg: args_json->items) {
+        if (!arg.is_string()) {
+            return rpc_error(id, rpc_invalid_params, "'params.args' must be an array of strings");
+        }
+        argv.push_back(arg.string.c_str());
+    }
+    Args args = Args::parse((int)argv.size(), argv.data());
+    if (!args.valid || !args.batch.empty() || !args.server.empty() || args.watch || args.lsp) {
+        return rpc_error(id, rpc_invalid_params, "invalid sokol-shdc arguments");
+    }
+    // the server process may run in a different working directory than the client
+    args.input = resolve_path(cwd, args.input);
+    args.output = resolve_path(cwd, args.output);
+    for (Args::ExtraOutput& extra: args.extra_outputs) {
+        extra.path = resolve_path(cwd, extra.path);
+    }
+    args.depfile = resolve_path(cwd, args.depfile);
+    if (!cwd.empty()) {
+        args.tmpdir = resolve_path(cwd, args.tmpdir.empty() ? "." : args.tmpdir);
+        if (args.tmpdir.back() != '/') {
+            args.tmpdir += "/";
+        }
+    }
+
+    const Pipeline pipeline = Pipeline::run(args, cache);
+    // with --timings, report the events since the previous request (which may include
+    // parts of concurrent requests), so that they don't pile up over the server lifetime
+    if (!server_args.timings.empty()) {
+        Timings::write_report(server_args.timings);
+    }
+    Json messages = Json::make_array();
+    for (const ErrMsg& msg: pipeline.messages) {
+        messages.push(message_to_json(msg, args.error_format));
+    }
+    Json result = Json::make_object();
+    result.set("exit_code", Json::make_number(pipeline.exit_code));
+    result.set("output", Json::make_string(args.output));
+    result.set("messages", std::move(messages));
+    return rpc_response(id, std::move(result));
+}
+
+// handle a single request line, returns the response line, sets out_shutdown on a shutdown request
+static std::string handle_request(const std::string& line, const Args& args, const Cache& cache, bool& out_shutdown) {
+    std::string parse_error;
+    const Json req = Json::parse(line, parse_error);
+    if (!parse_error.empty()) {
+        return rpc_error(Json(), rpc_parse_error, parse_error).dump();
+    }
+    const Json* id = req.find("id");
+    const Json null_id;
+    if (!id) {
+        id = &null_id;
+    }
+    const Json* method = req.find("method");
+    if (!req.is_object() || !method || !method->is_string()) {
+        return rpc_error(*id, rpc_invalid_request, "invalid JSON-RPC request").dump();
+    }
+    if (method->string == "compile") {
+        const Json* params = req.find("params");
+        if (!params || !params->is_object()) {
+            return rpc_error(*id, rpc_invalid_params, "'params' must be an object").dump();
+        }
+        return compile(*id, *params, args, cache).dump();
+    } else if (method->string == "shutdown") {
+        out_shutdown = true;
+        return rpc_response(*id, Json()).dump();
+    }
+    return rpc_error(*id, rpc_method_not_found, fmt::format("unknown method '{}'", method->string)).dump();
+}
+
+#if !defined(__wasi__)
+
+// a simple queue of work items processed by a fixed number of worker threads
+struct WorkQueue {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::function<void()>> items;
+    std::vector<std::thread> threads;
+    bool done = false;
+
+    WorkQueue(int num_threads) {
+        for (int i = 0; i < num_threads; i++) {
+            threads.emplace_back([this]() {
+                while (true) {
+                    std::function<void()> item;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        cond.wait(lock, [this]() { return done || !items.empty(); });
+                        if (items.empty()) {
+                            return;
+                        }
+                        item = std::move(items.front());
+                        items.pop_front();
+                    }
+                    // under a make jobserver, concurrent requests each need a token
+                    const Jobs::Token token;
+                    item();
+                }
+            });
+        }
+    }
+    void push(std::function<void()> item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            items.push_back(std::move(item));
+        }
+        cond.notify_one();
+    }
+    // finish all queued items and stop the worker threads
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        cond.notify_all();
+        for (std::thread& thread: threads) {
+            thread.join();
+        }
+        threads.clear();
+    }
+};
+
+static bool is_shutdown_request(const std::string& line) {
+    std::string parse_error;
+    const Json req = Json::parse(line, parse_error);
+    const Json* method = req.find("method");
+    return parse_error.empty() && method && (method->as_string("") == "shutdown");
+}
+
+static int run_stdio(const Args& args, const Cache& cache) {
+    // reserve stdout for responses, and redirect everything else to stderr
+    #if defined(_WIN32)
+    FILE* out = _fdopen(_dup(_fileno(stdout)), "wb");
+    _dup2(_fileno(stderr), _fileno(stdout));
+    #else
+    FILE* out = fdopen(dup(fileno(stdout)), "wb");
+    dup2(fileno(stderr), fileno(stdout));
+    #endif
+    if (!out) {
+        fmt::print(stderr, "sokol-shdc: failed to setup stdio server\n");
+        return 10;
+    }
+    std::mutex out_mutex;
+    const auto respond = [out, &out_mutex](const std::string& response) {
+        std::lock_guard<std::mutex> lock(out_mutex);
+        fwrite(response.data(), 1, response.size(), out);
+        fputc('\n', out);
+        fflush(out);
+    };
+
+    // requests are answered out of order as they complete, the JSON-RPC id connects
+    // responses to requests, a shutdown request waits for all pending requests
+    WorkQueue queue(Jobs::num_threads(args.num_jobs));
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (is_shutdown_request(line)) {
+            bool shutdown = false;
+            const std::string response = handle_request(line, args, cache, shutdown);
+            queue.finish();
+            respond(response);
+            break;
+        }
+        queue.push([line, &args, &cache, &respond]() {
+            bool shutdown = false;
+            respond(handle_request(line, args, cache, shutdown));
+        });
+    }
+    queue.finish();
+    fclose(out);
+    return 0;
+}
+
+#if !defined(_WIN32)
+static bool send_all(int fd, const std::string& data) {
+    size_t pos = 0;
+    while (pos < data.size()) {
+        const ssize_t num_bytes = send(fd, data.data() + pos, data.size() - pos, 0);
+        if (num_bytes <= 0) {
+            return false;
+        }
+        pos += (size_t)num_bytes;
+    }
+    return true;
+}
+
+// wake up the accept() call of the main thread by connecting to the server socket
+static void wakeup_listener(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0) {
+        sockaddr_un addr = { };
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+        connect(fd, (const sockaddr*)&addr, sizeof(addr));
+        close(fd);
+    }
+}
+
+// handle all requests of one client connection, requests on the same connection are handled in order
+static void handle_connection(int fd, const Args& args, const Cache& cache, std::atomic<bool>& stop) {
+    const std::string& path = args.server;
+    std::string buf;
+    char chunk[4096];
+    ssize_t num_bytes;
+    bool shutdown = false;
+    while (!shutdown && ((num_bytes = recv(fd, chunk, sizeof(chunk), 0)) > 0)) {
+        buf.append(chunk, (size_t)num_bytes);
+        size_t nl;
+        while (!shutdown && ((nl = buf.find('\n')) != std::string::npos)) {
+            const std::string line = buf.substr(0, nl);
+            buf.erase(0, nl + 1);
+            if (line.empty()) {
+                continue;
+            }
+            if (!send_all(fd, handle_request(line, args, cache, shutdown) + "\n")) {
+                shutdown = false;
+                buf.clear();
+                break;
+            }
+        }
+    }
+    close(fd);
+    if (shutdown) {
+        stop = true;
+        wakeup_listener(path);
+    }
+}
+
+static int run_socket(const Args& args, const Cache& cache) {
+    const std::string& path = args.server;
+    sockaddr_un addr = { };
+    if (path.size() >= sizeof(addr.sun_path)) {
+        fmt::print(stderr, "sokol-shdc: socket path too long: '{}'\n", path);
+        return 10;
+    }
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        fmt::print(stderr, "sokol-shdc: failed to create server socket\n");
+        return 10;
+    }
+    // remove a stale socket file from a previous server run
+    unlink(path.c_str());
+    if ((bind(listen_fd, (const sockaddr*)&addr, sizeof(addr)) != 0) || (listen(listen_fd, 16) != 0)) {
+        fmt::print(stderr, "sokol-shdc: failed to bind server socket '{}'\n", path);
+        close(listen_fd);
+        return 10;
+    }
+    // don't die when a client disconnects before reading its response
+    signal(SIGPIPE, SIG_IGN);
+
+    std::atomic<bool> stop(false);
+    WorkQueue queue(Jobs::num_threads(args.num_jobs));
+    while (!stop) {
+        const int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        if (stop) {
+            close(fd);
+            break;
+        }
+        queue.push([fd, &args, &cache, &stop]() {
+            handle_connection(fd, args, cache, stop);
+        });
+    }
+    queue.finish();
+    close(listen_fd);
+    unlink(path.c_str());
+    return 0;
+}
+#endif // !_WIN32
+#endif // !__wasi__
+
+int Server::run(const Args& args, const Cache& cache) {
+    #if defined(__wasi__)
+    fmt::print(stderr, "sokol-shdc: server mode is not supported on this platform\n");
+    return 10;
+    #else
+    if (args.server == "stdio") {
+        return run_stdio(args, cache);
+    }
+    #if defined(_WIN32)
+    fmt::print(stderr, "sokol-shdc: unix socket server mode is not supported on Windows, use '--server stdio'\n");
+    return 10;
+    #else
+    return run_socket(args, cache);
+    #endif
+    #endif
+}
+
+} // namespace shdc
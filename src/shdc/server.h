@@ -0,0 +1,14 @@
+#pragma once
+#include "args.h"
+#include "cache.h"
+
+namespace shdc {
+
+// server mode (--server [stdio|socket path]), a long-running process which
+// accepts compile requests as line-delimited JSON-RPC 2.0 messages either
+// on stdin/stdout or on a unix domain socket (see sokol-shdc-client)
+struct Server {
+    static int run(const Args& args, const Cache& cache);
+};
+
+} // namespace shdc
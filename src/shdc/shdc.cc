@@ -0,0 +1,43 @@
+/*
+    libshdc C++ API implementation.
+*/
+#include "shdc.h"
+#include "args.h"
+#include "spirv.h"
+#include "pipeline.h"
+#include "fmt/format.h"
+
+namespace shdc {
+
+void Compiler::setup() {
+    Spirv::initialize_spirv_tools();
+}
+
+void Compiler::shutdown() {
+    Spirv::finalize_spirv_tools();
+}
+
+CompileResult Compiler::compile(const CompileDesc& desc) {
+    CompileResult res;
+    std::vector<const char*> argv = { "sokol-shdc" };
+    for (const std::string& arg: desc.args) {
+        argv.push_back(arg.c_str());
+    }
+    const Args args = Args::parse((int)argv.size(), argv.data());
+    res.error_format = args.error_format;
+    if (!args.valid || !args.batch.empty() || !args.server.empty() || args.watch) {
+        res.exit_code = args.valid ? 10 : args.exit_code;
+        res.messages.push_back(ErrMsg::error(args.input, 0, fmt::format("invalid sokol-shdc args: '{}'", args.cmdline)));
+        return res;
+    }
+    Pipeline pipeline = Pipeline::run_in_memory(args, desc.cache ? *desc.cache : Cache(), desc.load_file);
+    res.exit_code = pipeline.exit_code;
+    res.messages = std::move(pipeline.messages);
+    res.files = std::move(pipeline.output_files);
+    res.dependencies = std::move(pipeline.filenames);
+    res.programs = std::move(pipeline.reflection.progs);
+    res.bindings = std::move(pipeline.reflection.bindings);
+    return res;
+}
+
+} // namespace shdc
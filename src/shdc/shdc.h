@@ -0,0 +1,47 @@
+#pragma once
+/*
+    libshdc: the in-memory C++ compile API of sokol-shdc.
+
+    Takes regular sokol-shdc cmdline args, loads the input and @include files
+    through an optional virtual file loader, and returns generated files,
+    reflection info and diagnostics in memory without writing any files
+    (except temporary files for Metal bytecode compilation with -b).
+*/
+#include <assert.h>
+#include <string>
+#include <vector>
+#include "types/slang.h"
+#include "types/errmsg.h"
+#include "types/reflection/program_reflection.h"
+#include "types/reflection/bindings.h"
+#include "input.h"
+#include "output.h"
+#include "cache.h"
+
+namespace shdc {
+
+struct CompileDesc {
+    std::vector<std::string> args;  // sokol-shdc cmdline args without the executable name
+    Input::FileLoader load_file;    // optional virtual file loader (default: load from filesystem)
+    const Cache* cache = nullptr;   // optional artifact cache, e.g. Cache::open("", max_size, true)
+};
+
+struct CompileResult {
+    int exit_code = 0;
+    std::vector<ErrMsg> messages;           // errors and warnings
+    ErrMsg::Format error_format = ErrMsg::GCC;  // the --errfmt arg for formatting messages
+    std::vector<OutputFile> files;          // generated files, with the paths they would have been written to
+    std::vector<std::string> dependencies;  // the input file and all @include files
+    std::vector<refl::ProgramReflection> programs;  // per-program reflection info
+    refl::Bindings bindings;                // merged resource bindings of all programs
+};
+
+struct Compiler {
+    // call once before the first and after the last compile() call
+    static void setup();
+    static void shutdown();
+    // compile one input file, may be called from multiple threads
+    static CompileResult compile(const CompileDesc& desc);
+};
+
+} // namespace shdc
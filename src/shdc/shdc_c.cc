@@ -0,0 +1,81 @@
+/*
+    libshdc C API implementation.
+*/
+#include "shdc_c.h"
+#include "shdc.h"
+
+using namespace shdc;
+
+// the C result struct is the base of the object which owns all strings and arrays
+struct CResult: shdc_result_t {
+    CompileResult cpp;
+    std::vector<std::string> message_texts;
+    std::vector<shdc_message_t> message_items;
+    std::vector<shdc_file_t> file_items;
+    std::vector<const char*> dependency_items;
+};
+
+void shdc_setup(void) {
+    Compiler::setup();
+}
+
+void shdc_shutdown(void) {
+    Compiler::shutdown();
+}
+
+shdc_result_t* shdc_compile(const shdc_desc_t* desc) {
+    assert(desc);
+    CompileDesc cpp_desc;
+    for (int i = 0; i < desc->num_args; i++) {
+        cpp_desc.args.push_back(desc->args[i]);
+    }
+    if (desc->load_file) {
+        cpp_desc.load_file = [desc](const std::string& path, std::string& out_content) {
+            size_t size = 0;
+            const char* data = desc->load_file(path.c_str(), &size, desc->user_data);
+            if (!data) {
+                return false;
+            }
+            out_content.assign(data, size);
+            return true;
+        };
+    }
+    CResult* cres = new CResult();
+    cres->cpp = Compiler::compile(cpp_desc);
+
+    const CompileResult& cpp = cres->cpp;
+    cres->message_texts.reserve(cpp.messages.size());
+    for (const ErrMsg& msg: cpp.messages) {
+        cres->message_texts.push_back(msg.as_string(cpp.error_format));
+    }
+    for (size_t i = 0; i < cpp.messages.size(); i++) {
+        const ErrMsg& msg = cpp.messages[i];
+        shdc_message_t cmsg = { };
+        cmsg.is_warning = (msg.type == ErrMsg::WARNING) ? 1 : 0;
+        cmsg.file = msg.file.c_str();
+        cmsg.line = msg.line_index + 1;
+        cmsg.message = msg.msg.c_str();
+        cmsg.text = cres->message_texts[i].c_str();
+        cres->message_items.push_back(cmsg);
+    }
+    for (const OutputFile& file: cpp.files) {
+        cres->file_items.push_back({ file.path.c_str(), file.content.data(), file.content.size() });
+    }
+    for (const std::string& dep: cpp.dependencies) {
+        cres->dependency_items.push_back(dep.c_str());
+    }
+    cres->exit_code = cpp.exit_code;
+    cres->num_messages = (int)cres->message_items.size();
+    cres->messages = cres->message_items.data();
+    cres->num_files = (int)cres->file_items.size();
+    cres->files = cres->file_items.data();
+    cres->num_dependencies = (int)cres->dependency_items.size();
+    cres->dependencies = cres->dependency_items.data();
+    return cres;
+}
+
+void shdc_free_result(shdc_result_t* result) {
+    if (result) {
+        delete static_cast<CResult*>(result);
+    }
+}
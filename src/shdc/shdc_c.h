@@ -0,0 +1,59 @@
+#pragma once
+/*
+    libshdc: a thin C API on top of the C++ compile API in shdc.h
+
+    - call shdc_setup() once before the first and shdc_shutdown() after
+      the last shdc_compile() call
+    - shdc_compile() takes regular sokol-shdc cmdline args and an optional
+      virtual file loader, and returns a result object which must be freed
+      with shdc_free_result()
+    - the load_file callback returns a pointer to the file content and writes
+      the content size to out_size, or returns NULL if the file doesn't exist,
+      the content pointer must remain valid until the callback is called again
+      or shdc_compile() returns
+*/
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct shdc_desc_t {
+    int num_args;
+    const char* const* args;    // sokol-shdc cmdline args without the executable name
+    const char* (*load_file)(const char* path, size_t* out_size, void* user_data);
+    void* user_data;
+} shdc_desc_t;
+
+typedef struct shdc_message_t {
+    int is_warning;         // 0 for errors, 1 for warnings
+    const char* file;
+    int line;               // 1-based line number
+    const char* message;
+    const char* text;       // formatted according to the --errfmt arg
+} shdc_message_t;
+
+typedef struct shdc_file_t {
+    const char* path;
+    const char* data;
+    size_t size;
+} shdc_file_t;
+
+typedef struct shdc_result_t {
+    int exit_code;
+    int num_messages;
+    const shdc_message_t* messages;
+    int num_files;
+    const shdc_file_t* files;
+    int num_dependencies;
+    const char* const* dependencies;
+} shdc_result_t;
+
+void shdc_setup(void);
+void shdc_shutdown(void);
+shdc_result_t* shdc_compile(const shdc_desc_t* desc);
+void shdc_free_result(shdc_result_t* result);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -2,7 +2,14 @@
     compile GLSL to SPIRV, wrapper around https://github.com/KhronosGroup/glslang
 */
 #include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <chrono>
 #include "spirv.h"
+#include "jobs.h"
+#include "timings.h"
+#include "memstats.h"
+#include "optprofile.h"
 #include "fmt/format.h"
 #include "pystring.h"
 #include "ShaderLang.h"
@@ -13,6 +20,12 @@
 
 namespace shdc {
 
+// NOTE: glslang keeps process-global state (the TLS slot for the per-thread
+// pool allocators and the shared builtin symbol tables), this must be set up
+// once on the main thread before any worker threads are started, after that
+// TShader/TProgram objects may be used concurrently on different threads
+// (each object owns its pool allocator, symbol table setup is guarded by
+// glslang's global lock)
 void Spirv::initialize_spirv_tools() {
     glslang::InitializeProcess();
 }
@@ -54,8 +67,15 @@ static MergedSource merge_source(const Input& inp, const Snippet& snippet, Slang
         res.linenr_offset += 1;
         res.src += fmt::format("#define {} (1)\n", define);
     }
+    // grow the merged source only once
+    size_t src_size = res.src.size();
     for (int line_index : snippet.lines) {
-        res.src += fmt::format("{}\n", inp.lines[line_index].line);
+        src_size += inp.lines[line_index].line.size() + 1;
+    }
+    res.src.reserve(src_size);
+    for (int line_index : snippet.lines) {
+        res.src += inp.lines[line_index].line;
+        res.src += '\n';
     }
     return res;
 }
@@ -134,60 +154,106 @@ static void infolog_to_errors(const std::string& log, const Input& inp, int snip
     which translates to valid GLSL, but invalid WebGL GLSL - e.g. simple
     bounded for-loops are converted to what looks like an unbounded loop
     ("for (;;) { }") to WebGL
+
+    the names are the spirv-opt cmdline flags of the passes (used by --spirv-opt-profile)
 */
-static void spirv_optimize(Slang::Enum slang, std::vector<uint32_t>& spirv) {
-    if (slang == Slang::WGSL) {
-        return;
-    }
-    spv_target_env target_env;
-    target_env = SPV_ENV_UNIVERSAL_1_2;
-    spvtools::Optimizer optimizer(target_env);
-    optimizer.SetMessageConsumer(
-        [](spv_message_level_t level, const char *source, const spv_position_t &position, const char *message) {
-            // FIXME
-        });
+struct OptimizerPass {
+    const char* name;
+    spvtools::Optimizer::PassToken (*create)();
+};
 
-    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+static const OptimizerPass optimizer_passes[] = {
+    { "eliminate-dead-branches", []() { return spvtools::CreateDeadBranchElimPass(); } },
 /*
-    optimizer.RegisterPass(spvtools::CreateMergeReturnPass());
-    optimizer.RegisterPass(spvtools::CreateInlineExhaustivePass());
+    { "merge-return", []() { return spvtools::CreateMergeReturnPass(); } },
+    { "inline-entry-points-exhaustive", []() { return spvtools::CreateInlineExhaustivePass(); } },
 */
-    optimizer.RegisterPass(spvtools::CreateEliminateDeadFunctionsPass());
-    optimizer.RegisterPass(spvtools::CreateScalarReplacementPass());
-    optimizer.RegisterPass(spvtools::CreateLocalAccessChainConvertPass());
-    optimizer.RegisterPass(spvtools::CreateLocalSingleBlockLoadStoreElimPass());
-    optimizer.RegisterPass(spvtools::CreateLocalSingleStoreElimPass());
-    optimizer.RegisterPass(spvtools::CreateSimplificationPass());
-    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass(true));    // NOTE: call the "preserveInterface" version of CreateAggressiveDCEPass()
-    optimizer.RegisterPass(spvtools::CreateVectorDCEPass());
-    optimizer.RegisterPass(spvtools::CreateDeadInsertElimPass());
-    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass(true));
-    optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+    { "eliminate-dead-functions", []() { return spvtools::CreateEliminateDeadFunctionsPass(); } },
+    { "scalar-replacement", []() { return spvtools::CreateScalarReplacementPass(); } },
+    { "convert-local-access-chains", []() { return spvtools::CreateLocalAccessChainConvertPass(); } },
+    { "eliminate-local-single-block", []() { return spvtools::CreateLocalSingleBlockLoadStoreElimPass(); } },
+    { "eliminate-local-single-store", []() { return spvtools::CreateLocalSingleStoreElimPass(); } },
+    { "simplify-instructions", []() { return spvtools::CreateSimplificationPass(); } },
+    // NOTE: call the "preserveInterface" version of CreateAggressiveDCEPass()
+    { "eliminate-dead-code-aggressive", []() { return spvtools::CreateAggressiveDCEPass(true); } },
+    { "vector-dce", []() { return spvtools::CreateVectorDCEPass(); } },
+    { "eliminate-dead-inserts", []() { return spvtools::CreateDeadInsertElimPass(); } },
+    { "eliminate-dead-code-aggressive", []() { return spvtools::CreateAggressiveDCEPass(true); } },
+    { "eliminate-dead-branches", []() { return spvtools::CreateDeadBranchElimPass(); } },
 // NOTE: it's the BlockMergePass which moves the init statement of a for-loop
 //       out of the for-statement, which makes it invalid for WebGL
-//    optimizer.RegisterPass(spvtools::CreateBlockMergePass());
+//  { "merge-blocks", []() { return spvtools::CreateBlockMergePass(); } },
 // NOTE: this is the pass which may create invalid WebGL code
-//    optimizer.RegisterPass(spvtools::CreateLocalMultiStoreElimPass());
-    optimizer.RegisterPass(spvtools::CreateIfConversionPass());
-    optimizer.RegisterPass(spvtools::CreateSimplificationPass());
-    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass(true));
-    optimizer.RegisterPass(spvtools::CreateVectorDCEPass());
-    optimizer.RegisterPass(spvtools::CreateDeadInsertElimPass());
-    optimizer.RegisterPass(spvtools::CreateRedundancyEliminationPass());
-    optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass(true));
-    optimizer.RegisterPass(spvtools::CreateCFGCleanupPass());
+//  { "eliminate-local-multi-store", []() { return spvtools::CreateLocalMultiStoreElimPass(); } },
+    { "if-conversion", []() { return spvtools::CreateIfConversionPass(); } },
+    { "simplify-instructions", []() { return spvtools::CreateSimplificationPass(); } },
+    { "eliminate-dead-code-aggressive", []() { return spvtools::CreateAggressiveDCEPass(true); } },
+    { "vector-dce", []() { return spvtools::CreateVectorDCEPass(); } },
+    { "eliminate-dead-inserts", []() { return spvtools::CreateDeadInsertElimPass(); } },
+    { "redundancy-elimination", []() { return spvtools::CreateRedundancyEliminationPass(); } },
+    { "eliminate-dead-code-aggressive", []() { return spvtools::CreateAggressiveDCEPass(true); } },
+    { "cfg-cleanup", []() { return spvtools::CreateCFGCleanupPass(); } },
+};
 
+// run a range of the optimizer passes on a SPIRV module
+static void run_optimizer_passes(int first_pass, int num_passes, std::vector<uint32_t>& spirv) {
+    spv_target_env target_env;
+    target_env = SPV_ENV_UNIVERSAL_1_2;
+    spvtools::Optimizer optimizer(target_env);
+    optimizer.SetMessageConsumer(
+        [](spv_message_level_t level, const char *source, const spv_position_t &position, const char *message) {
+            // FIXME
+        });
+    for (int i = first_pass; i < (first_pass + num_passes); i++) {
+        optimizer.RegisterPass(optimizer_passes[i].create());
+    }
     spvtools::OptimizerOptions spvOptOptions;
     spvOptOptions.set_run_validator(false); // The validator may run as a separate step later on
     optimizer.Run(spirv.data(), spirv.size(), &spirv, spvOptOptions);
 }
 
-/* compile a vertex or fragment shader to SPIRV */
-static bool compile(EShLanguage stage, Slang::Enum slang, const MergedSource& source, const Input& inp, int snippet_index, Spirv& out_spirv) {
+static void spirv_optimize(Slang::Enum slang, std::vector<uint32_t>& spirv) {
+    // NOTE: keep in sync with optimizer_profile()
+    if (slang == Slang::WGSL) {
+        return;
+    }
+    run_optimizer_passes(0, (int)(sizeof(optimizer_passes) / sizeof(optimizer_passes[0])), spirv);
+}
+
+// run the optimizer passes one by one on a copy of the SPIRV module and record
+// the time and module statistics before and after each pass (--spirv-opt-profile),
+// this doesn't modify the module, spirv_optimize() still runs all passes at once
+static void spirv_optimize_profile(Slang::Enum slang, const std::string& path, const std::string& snippet_name, const std::vector<uint32_t>& spirv, OptProfile::Module& module) {
+    if (slang == Slang::WGSL) {
+        return;
+    }
+    module.path = path;
+    module.snippet_name = snippet_name;
+    module.slang = slang;
+    std::vector<uint32_t> bytecode = spirv;
+    const int num_passes = (int)(sizeof(optimizer_passes) / sizeof(optimizer_passes[0]));
+    for (int i = 0; i < num_passes; i++) {
+        OptProfile::PassRun run;
+        run.name = optimizer_passes[i].name;
+        run.before = OptProfile::module_stats(bytecode);
+        const auto start = std::chrono::steady_clock::now();
+        run_optimizer_passes(i, 1, bytecode);
+        run.time_us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        run.after = OptProfile::module_stats(bytecode);
+        module.passes.push_back(run);
+    }
+}
+
+/* compile a vertex or fragment shader to SPIRV, optionally without running the optimizer passes,
+    with --spirv-opt-profile, the optimizer pass runs are recorded in out_profile
+*/
+static bool compile(EShLanguage stage, Slang::Enum slang, const MergedSource& source, const Input& inp, int snippet_index, bool optimize, Spirv& out_spirv, OptProfile::Module* out_profile = nullptr) {
     const char* sources[1] = { source.src.c_str() };
     const int sourcesLen[1] = { (int) source.src.length() };
     const char* sourcesNames[1] = { inp.base_path.c_str() };
     const int linenr_offset = source.linenr_offset;
+    const char* snippet_name = inp.snippets[snippet_index].name.c_str();
+    const char* slang_name = Slang::to_str(slang);
 
     // compile GLSL vertex- or fragment-shader
     glslang::TShader shader(stage);
@@ -201,7 +267,11 @@ static bool compile(EShLanguage stage, Slang::Enum slang, const MergedSource& so
     // We'll fix up the bindings later before calling SPIRVCross.
     shader.setAutoMapLocations(true);
     shader.setAutoMapBindings(true);
-    bool parse_success = shader.parse(GetDefaultResources(), 100, false, EShMsgDefault);
+    bool parse_success = false;
+    {
+        Timings::Scope timing("glslang_parse", snippet_name, slang_name);
+        parse_success = shader.parse(GetDefaultResources(), 100, false, EShMsgDefault);
+    }
     infolog_to_errors(shader.getInfoLog(), inp, snippet_index, linenr_offset, out_spirv.errors);
     infolog_to_errors(shader.getInfoDebugLog(), inp, snippet_index, linenr_offset, out_spirv.errors);
     if (!parse_success) {
@@ -211,13 +281,21 @@ static bool compile(EShLanguage stage, Slang::Enum slang, const MergedSource& so
     // "link" into a program
     glslang::TProgram program;
     program.addShader(&shader);
-    bool link_success = program.link(EShMsgDefault);
+    bool link_success = false;
+    {
+        Timings::Scope timing("glslang_link", snippet_name, slang_name);
+        link_success = program.link(EShMsgDefault);
+    }
     infolog_to_errors(program.getInfoLog(), inp, snippet_index, linenr_offset, out_spirv.errors);
     infolog_to_errors(program.getInfoDebugLog(), inp, snippet_index, linenr_offset, out_spirv.errors);
     if (!link_success) {
         return false;
     }
-    bool map_success = program.mapIO();
+    bool map_success = false;
+    {
+        Timings::Scope timing("glslang_map_io", snippet_name, slang_name);
+        map_success = program.mapIO();
+    }
     infolog_to_errors(program.getInfoLog(), inp, snippet_index, linenr_offset, out_spirv.errors);
     infolog_to_errors(program.getInfoDebugLog(), inp, snippet_index, linenr_offset, out_spirv.errors);
     if (!map_success) {
@@ -239,54 +317,311 @@ static bool compile(EShLanguage stage, Slang::Enum slang, const MergedSource& so
     spv_options.emitNonSemanticShaderDebugInfo = false;
     spv_options.emitNonSemanticShaderDebugSource = false;
     out_spirv.blobs.push_back(SpirvBlob(snippet_index));
-    out_spirv.blobs.back().source = source.src;
-    glslang::GlslangToSpv(*im, out_spirv.blobs.back().bytecode, &spv_logger, &spv_options);
-    std::string spirv_log = spv_logger.getAllMessages();
+    {
+        Timings::Scope timing("glslang_to_spv", snippet_name, slang_name);
+        glslang::GlslangToSpv(*im, out_spirv.blobs.back().bytecode, &spv_logger, &spv_options);
+    }
+    // the GlslangToSpv log has no line information (haven't seen a case yet where
+    // this generates log messages), report each line as a warning on the first snippet line
+    const std::string spirv_log = spv_logger.getAllMessages();
     if (!spirv_log.empty()) {
-        // FIXME: need to parse string for errors and translate to ErrMsg objects?
-        // haven't seen a case yet where this generates log messages
-        fmt::print("{}", spirv_log);
+        const Snippet& snippet = inp.snippets[snippet_index];
+        const int line_index = snippet.lines.empty() ? 0 : snippet.lines[0];
+        std::vector<std::string> log_lines;
+        pystring::splitlines(spirv_log, log_lines);
+        for (const std::string& log_line: log_lines) {
+            if (!pystring::strip(log_line).empty()) {
+                out_spirv.errors.push_back(inp.warning(line_index, fmt::format("GlslangToSpv: {}", pystring::strip(log_line))));
+            }
+        }
     }
     // run optimizer passes
-    spirv_optimize(slang, out_spirv.blobs.back().bytecode);
+    if (optimize) {
+        if (out_profile && OptProfile::enabled()) {
+            spirv_optimize_profile(slang, inp.base_path, snippet_name, out_spirv.blobs.back().bytecode, *out_profile);
+        }
+        Timings::Scope timing("spirv_optimize", snippet_name, slang_name);
+        spirv_optimize(slang, out_spirv.blobs.back().bytecode);
+    }
+    // the blob is kept until all shader languages are translated, drop the spare capacity
+    // left by GlslangToSpv and the optimizer (which writes the result into its input vector)
+    out_spirv.blobs.back().bytecode.shrink_to_fit();
     return true;
 }
 
-// compile all shader-snippets into SPIRV bytecode
-Spirv Spirv::compile_glsl(const Input& inp, Slang::Enum slang, const std::vector<std::string>& defines) {
-    Spirv out_spirv;
+// the SPIRV optimizer passes that run for a shader language (see spirv_optimize())
+static const char* optimizer_profile(Slang::Enum slang) {
+    return (slang == Slang::WGSL) ? "none" : "default";
+}
 
-    // compile shader-snippets
-    int snippet_index = 0;
-    for (const Snippet& snippet: inp.snippets) {
-        if (snippet.type == Snippet::VS) {
-            // vertex shader
-            const MergedSource src = merge_source(inp, snippet, slang, defines);
-            if (!compile(EShLangVertex, slang, src, inp, snippet_index, out_spirv)) {
-                // spirv.errors contains error list
-                return out_spirv;
+// check if a snippet references any of the SOKOL_* target language defines,
+// if not, the SPIRV output is identical for all target languages
+static bool uses_slang_defines(const Input& inp, const Snippet& snippet) {
+    for (int line_index: snippet.lines) {
+        if (inp.lines[line_index].line.find("SOKOL_") != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// a unique vertex- or fragment-shader snippet compilation, shared by all
+// shader languages which produce the same glslang input
+struct CompileTask {
+    Slang::Enum slang = Slang::Num;     // first shader language which requested this compilation
+    int snippet_index = -1;
+    MergedSource source;
+    std::string cache_key;
+    std::string intermediate_path;      // optional base path of the files written by --save-intermediate-spirv
+    bool success = false;
+    Spirv spirv;        // errors and warnings, and on success exactly one blob
+    OptProfile::Module profile;     // optimizer pass runs (--spirv-opt-profile)
+};
+
+// one entry of the slang x snippet matrix, referencing its compile task
+struct CompileItem {
+    Slang::Enum slang = Slang::Num;
+    int task_index = -1;
+    std::string source; // the merged source for this slang (may differ from the task's source)
+};
+
+// the base path of the files written by --save-intermediate-spirv for one shader language
+static std::string intermediate_base_path(const std::string& dir, const Input& inp, Slang::Enum slang) {
+    std::string base_dir;
+    std::string base_filename;
+    pystring::os::path::split(base_dir, base_filename, inp.base_path);
+    return fmt::format("{}{}_{}_", dir, base_filename, Slang::to_str(slang));
+}
+
+static bool load_binary_file(const std::string& path, std::string& out_data) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    out_data.resize(size > 0 ? size : 0);
+    const bool success = (size > 0) && (fread(&out_data[0], size, 1, fp) == 1);
+    fclose(fp);
+    return success;
+}
+
+// load the SPIRV file written by --save-intermediate-spirv for a snippet, the GLSL file
+// which was saved next to it must match the current merged source, otherwise the
+// SPIRV file is outdated and the snippet must be compiled again
+static bool load_intermediate(const std::string& base_path, const std::string& source, SpirvBlob& out_blob) {
+    std::string saved_source;
+    std::string data;
+    if (!load_binary_file(base_path + ".glsl", saved_source) || (saved_source != source)) {
+        return false;
+    }
+    if (!load_binary_file(base_path + ".spv", data) || ((data.size() % sizeof(uint32_t)) != 0)) {
+        return false;
+    }
+    out_blob.bytecode.resize(data.size() / sizeof(uint32_t));
+    memcpy(out_blob.bytecode.data(), data.data(), data.size());
+    return true;
+}
+
+// compile all shader-snippets into SPIRV bytecode for all shader languages in slang_mask,
+// snippets with a @spirv tag use their precompiled SPIRV module as is, and with
+// an intermediate_dir the files written by --save-intermediate-spirv are loaded
+// from there instead of compiling the snippet (if they exist)
+std::array<Spirv,Slang::Num> Spirv::compile_glsl(const Input& inp, uint32_t slang_mask, const std::vector<std::string>& defines, int num_jobs, const Cache& cache, bool keep_sources, const std::string* intermediate_dir) {
+    Timings::Scope timing("compile_glsl");
+    MemStats::Scope mem_stage(MemStats::COMPILE_GLSL);
+
+    // build the slang x snippet compile matrix, and memoize the actual compilations
+    // by snippet, optimizer profile and merged source, this means that shader language
+    // families with identical input (e.g. glsl410/glsl430/glsl300es) are only compiled
+    // once, and snippets which don't reference the SOKOL_* defines are only
+    // compiled once for all target languages
+    std::vector<CompileTask> tasks;
+    std::vector<CompileItem> items;
+    std::map<std::string, int> task_map;
+    for (int i = 0; i < Slang::Num; i++) {
+        Slang::Enum slang = Slang::from_index(i);
+        if (slang_mask & Slang::bit(slang)) {
+            for (const Snippet& snippet: inp.snippets) {
+                if (snippet.reachable && ((snippet.type == Snippet::VS) || (snippet.type == Snippet::FS))) {
+                    CompileItem item;
+                    item.slang = slang;
+                    if (!snippet.spirv.empty()) {
+                        // a precompiled @spirv module is shared by all shader languages
+                        const std::string key = fmt::format("{}:spirv", snippet.index);
+                        auto it = task_map.find(key);
+                        if (it != task_map.end()) {
+                            item.task_index = it->second;
+                        } else {
+                            item.task_index = (int)tasks.size();
+                            task_map[key] = item.task_index;
+                            CompileTask task;
+                            task.slang = slang;
+                            task.snippet_index = snippet.index;
+                            tasks.push_back(std::move(task));
+                        }
+                        items.push_back(std::move(item));
+                        continue;
+                    }
+                    MergedSource src = merge_source(inp, snippet, slang, defines);
+                    const std::string& key_src = uses_slang_defines(inp, snippet) ? src.src : merge_source(inp, snippet, Slang::REFLECTION, defines).src;
+                    // each shader language loads its own intermediate SPIRV file
+                    const std::string key = intermediate_dir ?
+                        fmt::format("{}:{}:{}", snippet.index, Slang::to_str(slang), key_src) :
+                        fmt::format("{}:{}:{}", snippet.index, optimizer_profile(slang), key_src);
+                    auto it = task_map.find(key);
+                    if (it != task_map.end()) {
+                        item.task_index = it->second;
+                    } else {
+                        item.task_index = (int)tasks.size();
+                        task_map[key] = item.task_index;
+                        CompileTask task;
+                        task.slang = slang;
+                        task.snippet_index = snippet.index;
+                        task.source = src;
+                        if (intermediate_dir) {
+                            task.intermediate_path = intermediate_base_path(*intermediate_dir, inp, slang) + snippet.name;
+                        }
+                        if (cache.enabled()) {
+                            // the merged source already contains the target language and user defines
+                            task.cache_key = Cache::key(fmt::format("spirv:{}:{}:{}", Snippet::type_to_str(snippet.type), optimizer_profile(slang), key_src));
+                        }
+                        tasks.push_back(std::move(task));
+                    }
+                    if (keep_sources) {
+                        item.source = std::move(src.src);
+                    }
+                    items.push_back(std::move(item));
+                }
+            }
+        }
+    }
+
+    // compile shader-snippets, each task only writes to its own CompileTask item,
+    // only compilations without any errors or warnings (including the GlslangToSpv log) are cached,
+    // the optimizer profiler bypasses cache lookups so that all snippets are profiled
+    const bool profile = OptProfile::enabled();
+    Jobs::run(num_jobs, (int)tasks.size(), [&inp, &tasks, &cache, profile](int task_index) {
+        CompileTask& task = tasks[task_index];
+        const Snippet& snippet = inp.snippets[task.snippet_index];
+        if (!snippet.spirv.empty()) {
+            SpirvBlob blob(task.snippet_index);
+            blob.bytecode = snippet.spirv;
+            task.spirv.blobs.push_back(std::move(blob));
+            task.success = true;
+            return;
+        }
+        if (!task.intermediate_path.empty()) {
+            SpirvBlob blob(task.snippet_index);
+            if (load_intermediate(task.intermediate_path, task.source.src, blob)) {
+                if (profile) {
+                    task.spirv.errors.push_back(inp.warning(snippet.lines.empty() ? 0 : snippet.lines[0],
+                        fmt::format("SPIRV of '{}' loaded from '{}.spv' (--load-intermediate-spirv) is not profiled by --spirv-opt-profile", snippet.name, task.intermediate_path)));
+                }
+                task.spirv.blobs.push_back(std::move(blob));
+                task.success = true;
+                return;
             }
-        } else if (snippet.type == Snippet::FS) {
-            // fragment shader
-            const MergedSource src = merge_source(inp, snippet, slang, defines);
-            if (!compile(EShLangFragment, slang, src, inp, snippet_index, out_spirv)) {
-                // spirv.errors contains error list
-                return out_spirv;
+        }
+        if (cache.enabled() && !profile) {
+            SpirvBlob blob(task.snippet_index);
+            if (cache.load_spirv(task.cache_key, blob)) {
+                task.spirv.blobs.push_back(std::move(blob));
+                task.success = true;
+                return;
             }
         }
-        snippet_index++;
+        const EShLanguage stage = (snippet.type == Snippet::VS) ? EShLangVertex : EShLangFragment;
+        task.success = compile(stage, task.slang, task.source, inp, task.snippet_index, true, task.spirv, &task.profile);
+        if (cache.enabled() && task.success && task.spirv.errors.empty()) {
+            cache.store_spirv(task.cache_key, task.spirv.blobs.back());
+        }
+    });
+
+    // gather results in the same order as a serial compilation, the first
+    // failed snippet ends the compilation of its shader language, the last
+    // item which references a task takes over its blob instead of copying it
+    std::vector<int> num_task_items(tasks.size(), 0);
+    for (const CompileItem& item: items) {
+        num_task_items[item.task_index]++;
+    }
+    std::array<Spirv,Slang::Num> out_spirv;
+    std::array<bool,Slang::Num> failed = { };
+    for (CompileItem& item: items) {
+        const bool last_item = (--num_task_items[item.task_index] == 0);
+        CompileTask& task = tasks[item.task_index];
+        // the optimizer profile of a task counts once for each shader language which uses it
+        if (!task.profile.passes.empty() && (item.slang != Slang::WGSL)) {
+            OptProfile::Module module = task.profile;
+            module.slang = item.slang;
+            OptProfile::add(std::move(module));
+        }
+        if (failed[item.slang]) {
+            continue;
+        }
+        Spirv& spirv = out_spirv[item.slang];
+        for (const ErrMsg& err: task.spirv.errors) {
+            spirv.errors.push_back(err);
+        }
+        for (SpirvBlob& blob: task.spirv.blobs) {
+            if (last_item) {
+                spirv.blobs.push_back(std::move(blob));
+            } else {
+                spirv.blobs.push_back(SpirvBlob(blob.snippet_index));
+                spirv.blobs.back().bytecode = blob.bytecode;
+            }
+            spirv.blobs.back().source = std::move(item.source);
+        }
+        if (!task.success) {
+            // spirv.errors contains error list
+            failed[item.slang] = true;
+        }
+    }
+    // when arriving here, spirv.bytecodes array contains the SPIRV-bytecode
+    // for each shader snippet of all slangs without compile errors
+    return out_spirv;
+}
+
+// compile a single shader-snippet for --check, without running the SPIRV optimizer
+Spirv Spirv::check_snippet(const Input& inp, int snippet_index, Slang::Enum slang, const std::vector<std::string>& defines) {
+    const Snippet& snippet = inp.snippets[snippet_index];
+    const EShLanguage stage = (snippet.type == Snippet::VS) ? EShLangVertex : EShLangFragment;
+    Spirv out_spirv;
+    if (!snippet.spirv.empty()) {
+        out_spirv.blobs.push_back(SpirvBlob(snippet_index));
+        out_spirv.blobs.back().bytecode = snippet.spirv;
+        return out_spirv;
+    }
+    compile(stage, slang, merge_source(inp, snippet, slang, defines), inp, snippet.index, false, out_spirv);
+    return out_spirv;
+}
+
+// compile all shader-snippets for a single shader language without running the
+// SPIRV optimizer (used by --check), unlike compile_glsl(), a failed snippet
+// doesn't stop the compilation of the remaining snippets
+Spirv Spirv::check_glsl(const Input& inp, Slang::Enum slang, const std::vector<std::string>& defines, int num_jobs) {
+    MemStats::Scope mem_stage(MemStats::COMPILE_GLSL);
+    std::vector<int> snippet_indices;
+    for (const Snippet& snippet: inp.snippets) {
+        if (snippet.reachable && ((snippet.type == Snippet::VS) || (snippet.type == Snippet::FS))) {
+            snippet_indices.push_back(snippet.index);
+        }
+    }
+    std::vector<Spirv> results(snippet_indices.size());
+    Jobs::run(num_jobs, (int)snippet_indices.size(), [&inp, slang, &defines, &snippet_indices, &results](int i) {
+        results[i] = check_snippet(inp, snippet_indices[i], slang, defines);
+    });
+    Spirv out_spirv;
+    for (size_t i = 0; i < results.size(); i++) {
+        out_spirv.errors.insert(out_spirv.errors.end(), results[i].errors.begin(), results[i].errors.end());
+        out_spirv.blobs.insert(out_spirv.blobs.end(), results[i].blobs.begin(), results[i].blobs.end());
     }
-    // when arriving here, no compile errors occurred
-    // spirv.bytecodes array contains the SPIRV-bytecode
-    // for each shader snippet
     return out_spirv;
 }
 
 bool Spirv::write_to_file(const Args& args, const Input& inp, Slang::Enum slang) {
-    std::string base_dir;
-    std::string base_filename;
-    pystring::os::path::split(base_dir, base_filename, inp.base_path);
-    std::string base_path = fmt::format("{}{}_{}_", args.tmpdir, base_filename, Slang::to_str(slang));
+    const std::string base_path = intermediate_base_path(args.tmpdir, inp, slang);
     for (const SpirvBlob& blob: blobs) {
         const Snippet& snippet = inp.snippets[blob.snippet_index];
         {
@@ -300,7 +635,8 @@ bool Spirv::write_to_file(const Args& args, const Input& inp, Slang::Enum slang)
                 return false;
             }
         }
-        {
+        // precompiled @spirv snippets have no GLSL source
+        if (!blob.source.empty()) {
             const std::string path = fmt::format("{}{}.glsl", base_path, snippet.name);
             FILE* fp = fopen(path.c_str(), "w");
             if (fp) {
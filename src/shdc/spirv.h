@@ -1,8 +1,10 @@
 #pragma once
+#include <array>
 #include <vector>
 #include <string>
 #include "args.h"
 #include "input.h"
+#include "cache.h"
 #include "types/errmsg.h"
 #include "types/spirv_blob.h"
 #include "types/slang.h"
@@ -16,7 +18,11 @@ struct Spirv {
 
     static void initialize_spirv_tools();
     static void finalize_spirv_tools();
-    static Spirv compile_glsl(const Input& inp, Slang::Enum slang, const std::vector<std::string>& defines);
+    // the merged sources are only kept in SpirvBlob.source with keep_sources (for --save-intermediate-spirv and --dump)
+    static std::array<Spirv,Slang::Num> compile_glsl(const Input& inp, uint32_t slang_mask, const std::vector<std::string>& defines, int num_jobs, const Cache& cache, bool keep_sources, const std::string* intermediate_dir = nullptr);
+    // compile a single vs or fs snippet without optimizer passes (see --check and --lsp)
+    static Spirv check_snippet(const Input& inp, int snippet_index, Slang::Enum slang, const std::vector<std::string>& defines);
+    static Spirv check_glsl(const Input& inp, Slang::Enum slang, const std::vector<std::string>& defines, int num_jobs);
     bool write_to_file(const Args& args, const Input& inp, Slang::Enum slang);
     void dump_debug(const Input& inp, ErrMsg::Format err_fmt) const;
 };
@@ -5,13 +5,19 @@
 */
 #include "spirvcross.h"
 #include "reflection.h"
+#include "jobs.h"
+#include "timings.h"
+#include "memstats.h"
 #include "types/option.h"
 #include "fmt/format.h"
 #include "pystring.h"
 #include "spirv_hlsl.hpp"
 #include "spirv_msl.hpp"
 #include "spirv_reflect.hpp"
+#include "spirv_parser.hpp"
 #include "tint/tint.h"
+#include <atomic>
+#include <unordered_map>
 
 #include "spirv_glsl.hpp"
 
@@ -201,8 +207,8 @@ static void wgsl_patch_bind_slots(Compiler& compiler, Snippet::Type type, std::v
     }
 }
 
-static ErrMsg validate_resource_restrictions(const Input& inp, const SpirvBlob& blob) {
-    CompilerGLSL compiler(blob.bytecode);
+static ErrMsg validate_resource_restrictions(const Input& inp, const ParsedIR& ir) {
+    CompilerGLSL compiler(ir);
     ShaderResources res = compiler.get_shader_resources();
     // - uniform blocks:
     //   - must only have float and int base types
@@ -298,10 +304,10 @@ static void to_combined_image_samplers(CompilerGLSL& compiler) {
     }
 }
 
-static StageReflection parse_reflection(const std::vector<uint32_t>& bytecode, const Snippet& snippet, ErrMsg& out_error) {
+static StageReflection parse_reflection(const ParsedIR& ir, const Snippet& snippet, ErrMsg& out_error) {
     // NOTE: do *NOT* use CompilerReflection here, this doesn't generate
     // the right reflection info for depth textures and comparison samplers
-    CompilerGLSL compiler(bytecode);
+    CompilerGLSL compiler(ir);
     CompilerGLSL::Options options;
     options.emit_line_directives = false;
     options.version = 430;
@@ -319,8 +325,40 @@ static StageReflection parse_reflection(const std::vector<uint32_t>& bytecode, c
     return Reflection::parse_snippet_reflection(compiler, snippet, out_error);
 }
 
-static SpirvcrossSource to_glsl(const Input& inp, const SpirvBlob& blob, Slang::Enum slang, uint32_t opt_mask, const Snippet& snippet) {
-    CompilerGLSL compiler(blob.bytecode);
+// parsed SPIRV, reflection info and resource validation result of one snippet,
+// this only depends on the SPIRV bytecode (and not on the target language), so it
+// is computed once for each unique bytecode blob and shared by all backends,
+// the backend compilers are created from a copy of the parsed IR, which is
+// much cheaper than parsing the bytecode again
+struct SnippetReflection {
+    const SpirvBlob* blob = nullptr;
+    ParsedIR ir;
+    ErrMsg validate_error;
+    ErrMsg refl_error;
+    StageReflection stage_refl;
+};
+
+static void reflect_blob(const Input& inp, SnippetReflection& refl) {
+    const Snippet& snippet = inp.snippets[refl.blob->snippet_index];
+    try {
+        {
+            Timings::Scope timing("spirv_parse", snippet.name.c_str());
+            Parser parser(refl.blob->bytecode.data(), refl.blob->bytecode.size());
+            parser.parse();
+            refl.ir = std::move(parser.get_parsed_ir());
+        }
+        refl.validate_error = validate_resource_restrictions(inp, refl.ir);
+        if (!refl.validate_error.valid()) {
+            Timings::Scope timing("parse_reflection", snippet.name.c_str());
+            refl.stage_refl = parse_reflection(refl.ir, snippet, refl.refl_error);
+        }
+    } catch (const std::runtime_error& err) {
+        refl.validate_error = inp.error(0, fmt::format("SPIRVCross exception: {}\n", err.what()));
+    }
+}
+
+static SpirvcrossSource to_glsl(const Input& inp, const SpirvBlob& blob, Slang::Enum slang, uint32_t opt_mask, const Snippet& snippet, const SnippetReflection& refl) {
+    CompilerGLSL compiler(refl.ir);
     CompilerGLSL::Options options;
     options.emit_line_directives = false;
     switch (slang) {
@@ -356,14 +394,15 @@ static SpirvcrossSource to_glsl(const Input& inp, const SpirvBlob& blob, Slang::
     res.snippet_index = blob.snippet_index;
     if (!src.empty()) {
         res.source_code = std::move(src);
-        res.stage_refl = parse_reflection(blob.bytecode, snippet, res.error);
+        res.stage_refl = refl.stage_refl;
+        res.error = refl.refl_error;
     }
     res.valid = !res.error.valid();
     return res;
 }
 
-static SpirvcrossSource to_hlsl(const Input& inp, const SpirvBlob& blob, Slang::Enum slang, uint32_t opt_mask, const Snippet& snippet) {
-    CompilerHLSL compiler(blob.bytecode);
+static SpirvcrossSource to_hlsl(const Input& inp, const SpirvBlob& blob, Slang::Enum slang, uint32_t opt_mask, const Snippet& snippet, const SnippetReflection& refl) {
+    CompilerHLSL compiler(refl.ir);
     CompilerGLSL::Options commonOptions;
     commonOptions.emit_line_directives = false;
     commonOptions.vertex.fixup_clipspace = (0 != (opt_mask & Option::FIXUP_CLIPSPACE));
@@ -388,14 +427,15 @@ static SpirvcrossSource to_hlsl(const Input& inp, const SpirvBlob& blob, Slang::
     res.snippet_index = blob.snippet_index;
     if (!src.empty()) {
         res.source_code = std::move(src);
-        res.stage_refl = parse_reflection(blob.bytecode, snippet, res.error);
+        res.stage_refl = refl.stage_refl;
+        res.error = refl.refl_error;
     }
     res.valid = !res.error.valid();
     return res;
 }
 
-static SpirvcrossSource to_msl(const Input& inp, const SpirvBlob& blob, Slang::Enum slang, uint32_t opt_mask, const Snippet& snippet) {
-    CompilerMSL compiler(blob.bytecode);
+static SpirvcrossSource to_msl(const Input& inp, const SpirvBlob& blob, Slang::Enum slang, uint32_t opt_mask, const Snippet& snippet, const SnippetReflection& refl) {
+    CompilerMSL compiler(refl.ir);
     CompilerGLSL::Options commonOptions;
     commonOptions.emit_line_directives = false;
     commonOptions.vertex.fixup_clipspace = (0 != (opt_mask & Option::FIXUP_CLIPSPACE));
@@ -418,28 +458,36 @@ static SpirvcrossSource to_msl(const Input& inp, const SpirvBlob& blob, Slang::E
     res.snippet_index = blob.snippet_index;
     if (!src.empty()) {
         res.source_code = std::move(src);
-        res.stage_refl = parse_reflection(blob.bytecode, snippet, res.error);
+        res.stage_refl = refl.stage_refl;
+        res.error = refl.refl_error;
     }
     res.valid = !res.error.valid();
     return res;
 }
 
-static SpirvcrossSource to_wgsl(const Input& inp, const SpirvBlob& blob, Slang::Enum slang, uint32_t opt_mask, const Snippet& snippet) {
+static SpirvcrossSource to_wgsl(const Input& inp, const SpirvBlob& blob, Slang::Enum slang, uint32_t opt_mask, const Snippet& snippet, const SnippetReflection& refl) {
     std::vector<uint32_t> patched_bytecode = blob.bytecode;
-    CompilerGLSL compiler_temp(blob.bytecode);
+    CompilerGLSL compiler_temp(refl.ir);
     fix_bind_slots(compiler_temp, snippet.type, slang);
     wgsl_patch_bind_slots(compiler_temp, snippet.type, patched_bytecode);
     SpirvcrossSource res;
     res.snippet_index = blob.snippet_index;
     tint::reader::spirv::Options spirv_options;
     spirv_options.allow_non_uniform_derivatives = true; // FIXME? => this allow texture sample calls inside dynamic if blocks
-    tint::Program program = tint::reader::spirv::Parse(patched_bytecode, spirv_options);
+    tint::Program program = [&]() {
+        Timings::Scope timing("tint_parse", snippet.name.c_str());
+        return tint::reader::spirv::Parse(patched_bytecode, spirv_options);
+    }();
     if (!program.Diagnostics().contains_errors()) {
         const tint::writer::wgsl::Options wgsl_options;
-        tint::writer::wgsl::Result result = tint::writer::wgsl::Generate(&program, wgsl_options);
+        tint::writer::wgsl::Result result = [&]() {
+            Timings::Scope timing("tint_generate", snippet.name.c_str());
+            return tint::writer::wgsl::Generate(&program, wgsl_options);
+        }();
         if (result.success) {
             res.source_code = result.wgsl;
-            res.stage_refl = parse_reflection(blob.bytecode, snippet, res.error);
+            res.stage_refl = refl.stage_refl;
+            res.error = refl.refl_error;
         } else {
             res.error = inp.error(blob.snippet_index, result.error);
         }
@@ -457,46 +505,213 @@ struct SnippetRefls {
     const StageReflection fs_refl;
 };
 
-Spirvcross Spirvcross::translate(const Input& inp, const Spirv& spirv, Slang::Enum slang) {
-    Spirvcross spv_cross;
+// translate a single SPIRV blob to one shader language, returns a valid ErrMsg on failure
+static ErrMsg translate_blob(const Input& inp, const SpirvBlob& blob, Slang::Enum slang, const SnippetReflection& refl, SpirvcrossSource& out_src) {
+    if (refl.validate_error.valid()) {
+        return refl.validate_error;
+    }
     try {
-        for (const auto& blob: spirv.blobs) {
-            SpirvcrossSource src;
-            uint32_t opt_mask = inp.snippets[blob.snippet_index].options[(int)slang];
-            const Snippet& snippet = inp.snippets[blob.snippet_index];
-            assert((snippet.type == Snippet::VS) || (snippet.type == Snippet::FS));
-            spv_cross.error = validate_resource_restrictions(inp, blob);
-            if (spv_cross.error.valid()) {
-                return spv_cross;
-            }
-            if (Slang::is_glsl(slang)) {
-                src = to_glsl(inp, blob, slang, opt_mask, snippet);
-            } else if (Slang::is_hlsl(slang)) {
-                src = to_hlsl(inp, blob, slang, opt_mask, snippet);
-            } else if (Slang::is_msl(slang)) {
-                src = to_msl(inp, blob, slang, opt_mask, snippet);
-            } else if (Slang::is_wgsl(slang)) {
-                src = to_wgsl(inp, blob, slang, opt_mask, snippet);
-            }
-            if (src.valid) {
-                assert(src.snippet_index == blob.snippet_index);
-                spv_cross.sources.push_back(std::move(src));
+        uint32_t opt_mask = inp.snippets[blob.snippet_index].options[(int)slang];
+        const Snippet& snippet = inp.snippets[blob.snippet_index];
+        assert((snippet.type == Snippet::VS) || (snippet.type == Snippet::FS));
+        SpirvcrossSource src;
+        if (Slang::is_glsl(slang)) {
+            Timings::Scope timing("to_glsl", snippet.name.c_str(), Slang::to_str(slang));
+            src = to_glsl(inp, blob, slang, opt_mask, snippet, refl);
+        } else if (Slang::is_hlsl(slang)) {
+            Timings::Scope timing("to_hlsl", snippet.name.c_str(), Slang::to_str(slang));
+            src = to_hlsl(inp, blob, slang, opt_mask, snippet, refl);
+        } else if (Slang::is_msl(slang)) {
+            Timings::Scope timing("to_msl", snippet.name.c_str(), Slang::to_str(slang));
+            src = to_msl(inp, blob, slang, opt_mask, snippet, refl);
+        } else if (Slang::is_wgsl(slang)) {
+            Timings::Scope timing("to_wgsl", snippet.name.c_str(), Slang::to_str(slang));
+            src = to_wgsl(inp, blob, slang, opt_mask, snippet, refl);
+        }
+        if (!src.valid) {
+            const int line_index = snippet.lines[0];
+            std::string err_msg;
+            if (src.error.valid()) {
+                err_msg = fmt::format("Failed to cross-compile to {} with:\n{}\n", Slang::to_str(slang), src.error.msg);
             } else {
-                const int line_index = snippet.lines[0];
-                std::string err_msg;
-                if (src.error.valid()) {
-                    err_msg = fmt::format("Failed to cross-compile to {} with:\n{}\n", Slang::to_str(slang), src.error.msg);
-                } else {
-                    err_msg = fmt::format("Failed to cross-compile to {}\n", Slang::to_str(slang));
-                }
-                spv_cross.error = inp.error(line_index, err_msg);
-                return spv_cross;
+                err_msg = fmt::format("Failed to cross-compile to {}\n", Slang::to_str(slang));
             }
+            return inp.error(line_index, err_msg);
         }
+        assert(src.snippet_index == blob.snippet_index);
+        out_src = std::move(src);
     } catch (const std::runtime_error& err) {
-        spv_cross.error = inp.error(0, fmt::format("SPIRVCross exception: {}\n", err.what()));
+        return inp.error(0, fmt::format("SPIRVCross exception: {}\n", err.what()));
+    }
+    return ErrMsg();
+}
+
+// the cache key for a translation covers everything the SPIRVCross output and the
+// stage reflection depend on: the SPIRV bytecode, target language, snippet options,
+// snippet name and type, and the image-sample-type and sampler-type tags
+static std::string source_cache_key(const Input& inp, const SpirvBlob& blob, Slang::Enum slang) {
+    const Snippet& snippet = inp.snippets[blob.snippet_index];
+    std::string inputs = fmt::format("src:{}:{}:{}:{}:", Slang::to_str(slang), snippet.options[(int)slang], Snippet::type_to_str(snippet.type), snippet.name);
+    for (const auto& item: snippet.image_sample_type_tags) {
+        inputs += fmt::format("img:{}={}:", item.first, ImageSampleType::to_str(item.second.type));
+    }
+    for (const auto& item: snippet.sampler_type_tags) {
+        inputs += fmt::format("smp:{}={}:", item.first, SamplerType::to_str(item.second.type));
+    }
+    inputs.append((const char*)blob.bytecode.data(), blob.bytecode.size() * sizeof(uint32_t));
+    return Cache::key(inputs);
+}
+
+std::vector<ErrMsg> Spirvcross::validate(const Input& inp, const Spirv& spirv, int num_jobs) {
+    std::vector<ErrMsg> results(spirv.blobs.size());
+    Jobs::run(num_jobs, (int)spirv.blobs.size(), [&inp, &spirv, &results](int blob_index) {
+        const SpirvBlob& blob = spirv.blobs[blob_index];
+        try {
+            Parser parser(blob.bytecode.data(), blob.bytecode.size());
+            parser.parse();
+            results[blob_index] = validate_resource_restrictions(inp, parser.get_parsed_ir());
+        } catch (const std::runtime_error& err) {
+            results[blob_index] = inp.error(0, fmt::format("SPIRVCross exception: {}\n", err.what()));
+        }
+    });
+    std::vector<ErrMsg> errors;
+    for (const ErrMsg& err: results) {
+        if (err.valid()) {
+            errors.push_back(err);
+        }
+    }
+    return errors;
+}
+
+ErrMsg Spirvcross::reflect(const Input& inp, const SpirvBlob& blob, StageReflection& out_refl) {
+    SnippetReflection refl;
+    refl.blob = &blob;
+    reflect_blob(inp, refl);
+    if (refl.validate_error.valid()) {
+        return refl.validate_error;
+    }
+    out_refl = refl.stage_refl;
+    return refl.refl_error;
+}
+
+// a single SPIRV blob to shader language translation
+struct TranslateTask {
+    Slang::Enum slang = Slang::Num;
+    const SpirvBlob* blob = nullptr;
+    int refl_index = -1;    // index into shared SnippetReflection array
+    std::string cache_key;
+    bool cached = false;
+    ErrMsg error;
+    SpirvcrossSource src;
+
+    TranslateTask(Slang::Enum sl, const SpirvBlob* b): slang(sl), blob(b) { };
+};
+
+// FNV-1a hash over the snippet index and bytecode of a SPIRV blob, used to find
+// blobs which are shared between target languages
+static uint64_t blob_hash(const SpirvBlob& blob) {
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t h = (0xcbf29ce484222325ULL ^ (uint32_t)blob.snippet_index) * prime;
+    for (const uint32_t word: blob.bytecode) {
+        h = (h ^ word) * prime;
+    }
+    return h;
+}
+
+std::array<Spirvcross,Slang::Num> Spirvcross::translate(const Input& inp, const std::array<Spirv,Slang::Num>& spirv, uint32_t slang_mask, int num_jobs, const Cache& cache) {
+    Timings::Scope timing("translate");
+    MemStats::Scope mem_stage(MemStats::TRANSLATE);
+    // build the slang x blob translation matrix
+    std::vector<TranslateTask> tasks;
+    for (int i = 0; i < Slang::Num; i++) {
+        Slang::Enum slang = Slang::from_index(i);
+        if (slang_mask & Slang::bit(slang)) {
+            for (const SpirvBlob& blob: spirv[i].blobs) {
+                tasks.push_back(TranslateTask(slang, &blob));
+            }
+        }
+    }
+
+    // lookup translations in the artifact cache
+    if (cache.enabled()) {
+        Jobs::run(num_jobs, (int)tasks.size(), [&inp, &tasks, &cache](int task_index) {
+            TranslateTask& task = tasks[task_index];
+            task.cache_key = source_cache_key(inp, *task.blob, task.slang);
+            task.src.snippet_index = task.blob->snippet_index;
+            task.cached = cache.load_source(task.cache_key, task.src);
+        });
+    }
+
+    // build the list of unique per-snippet bytecode blobs for reflection parsing
+    // of the remaining translations (blobs are usually shared between target
+    // languages, see Spirv::compile_glsl()), blobs are only compared byte by
+    // byte if their hashes are identical
+    std::vector<SnippetReflection> refls;
+    std::unordered_map<uint64_t, std::vector<int>> refls_by_hash;
+    for (TranslateTask& task: tasks) {
+        if (task.cached) {
+            continue;
+        }
+        std::vector<int>& same_hash = refls_by_hash[blob_hash(*task.blob)];
+        for (const int ri: same_hash) {
+            const SpirvBlob* other = refls[ri].blob;
+            if ((other->snippet_index == task.blob->snippet_index) && (other->bytecode == task.blob->bytecode)) {
+                task.refl_index = ri;
+                break;
+            }
+        }
+        if (task.refl_index == -1) {
+            task.refl_index = (int)refls.size();
+            same_hash.push_back(task.refl_index);
+            refls.push_back(SnippetReflection());
+            refls.back().blob = task.blob;
+        }
+    }
+
+    // validate and parse reflection once per unique blob
+    Jobs::run(num_jobs, (int)refls.size(), [&inp, &refls](int refl_index) {
+        reflect_blob(inp, refls[refl_index]);
+    });
+
+    // the number of translations which still need the parsed SPIRV of a unique blob
+    std::vector<std::atomic<int>> num_refl_users(refls.size());
+    for (const TranslateTask& task: tasks) {
+        if (!task.cached) {
+            num_refl_users[task.refl_index]++;
+        }
+    }
+
+    // translate in parallel, each task only writes to its own TranslateTask item,
+    // exceptions are caught per task so that a failing snippet doesn't affect the others,
+    // the parsed SPIRV of a blob is released after its last translation
+    Jobs::run(num_jobs, (int)tasks.size(), [&inp, &refls, &num_refl_users, &tasks, &cache](int task_index) {
+        TranslateTask& task = tasks[task_index];
+        if (task.cached) {
+            return;
+        }
+        task.error = translate_blob(inp, *task.blob, task.slang, refls[task.refl_index], task.src);
+        if (--num_refl_users[task.refl_index] == 0) {
+            refls[task.refl_index].ir = ParsedIR();
+        }
+        if (cache.enabled() && !task.error.valid()) {
+            cache.store_source(task.cache_key, task.src);
+        }
+    });
+
+    // gather results in snippet order, the first error ends a shader language
+    std::array<Spirvcross,Slang::Num> out_spirvcross;
+    for (TranslateTask& task: tasks) {
+        Spirvcross& spv_cross = out_spirvcross[task.slang];
+        if (spv_cross.error.valid()) {
+            continue;
+        }
+        if (task.error.valid()) {
+            spv_cross.error = std::move(task.error);
+        } else {
+            spv_cross.sources.push_back(std::move(task.src));
+        }
     }
-    return spv_cross;
+    return out_spirvcross;
 }
 
 void Spirvcross::dump_debug(ErrMsg::Format err_fmt, Slang::Enum slang) const {
@@ -1,12 +1,15 @@
 #pragma once
+#include <array>
 #include <vector>
 #include "spirv_cross.hpp"
 #include "input.h"
 #include "spirv.h"
+#include "cache.h"
 #include "types/errmsg.h"
 #include "types/slang.h"
 #include "types/spirvcross_source.h"
 #include "types/reflection/bindings.h"
+#include "types/reflection/stage_reflection.h"
 
 namespace shdc {
 
@@ -15,7 +18,11 @@ struct Spirvcross {
     ErrMsg error;
     std::vector<SpirvcrossSource> sources;
 
-    static Spirvcross translate(const Input& inp, const Spirv& spirv, Slang::Enum slang);
+    static std::array<Spirvcross,Slang::Num> translate(const Input& inp, const std::array<Spirv,Slang::Num>& spirv, uint32_t slang_mask, int num_jobs, const Cache& cache);
+    // validate the resource restrictions of all SPIRV blobs without translating them (see --check)
+    static std::vector<ErrMsg> validate(const Input& inp, const Spirv& spirv, int num_jobs);
+    // validate and reflect a single SPIRV blob without translating it (see --lsp)
+    static ErrMsg reflect(const Input& inp, const SpirvBlob& blob, refl::StageReflection& out_refl);
     static bool can_flatten_uniform_block(const spirv_cross::Compiler& compiler, const spirv_cross::Resource& ub_res);
     const SpirvcrossSource* find_source_by_snippet_index(int snippet_index) const;
     void dump_debug(ErrMsg::Format err_fmt, Slang::Enum slang) const;
@@ -0,0 +1,249 @@
+/*
+    Stream mode: read the input from stdin or a file bundle, and write the
+    generated files to stdout or a file bundle.
+
+    The pipeline runs in memory (see Pipeline::run_in_memory()), input and
+    @include files are served by a virtual file loader, and no temporary
+    files are written, --depfile and --incremental are ignored. With an input
+    bundle, all files are read from the bundle, never from the filesystem.
+    When writing to stdout, stdout is reserved for the generated output,
+    any other output is redirected to stderr.
+*/
+#include "stream.h"
+#include "pipeline.h"
+#include "fmt/format.h"
+#include "pystring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#elif !defined(__wasi__)
+#include <unistd.h>
+#endif
+
+namespace shdc {
+
+static const std::string bundle_header = "sokol-shdc-bundle 1";
+
+// bundle paths are compared without a leading "./"
+static std::string normalize_path(const std::string& path) {
+    return pystring::startswith(path, "./") ? path.substr(2) : path;
+}
+
+bool Bundle::parse(const std::string& data, Bundle& out_bundle, std::string& out_error) {
+    size_t pos = 0;
+    // read the next line without the trailing newline, returns false at the end of data
+    const auto next_line = [&data, &pos](std::string& out_line) {
+        if (pos >= data.size()) {
+            return false;
+        }
+        size_t end = data.find('\n', pos);
+        if (end == std::string::npos) {
+            end = data.size();
+        }
+        out_line = pystring::rstrip(data.substr(pos, end - pos), "\r");
+        pos = end + 1;
+        return true;
+    };
+    std::string line;
+    if (!next_line(line) || (line != bundle_header)) {
+        out_error = fmt::format("missing bundle header '{}'", bundle_header);
+        return false;
+    }
+    while (next_line(line)) {
+        if (line.empty()) {
+            continue;
+        }
+        std::vector<std::string> tokens;
+        pystring::split(line, tokens, " ", 2);
+        char* end = nullptr;
+        const unsigned long long size = (tokens.size() == 3) ? strtoull(tokens[1].c_str(), &end, 10) : 0;
+        if ((tokens.size() != 3) || (tokens[0] != "file") || (end == tokens[1].c_str()) || (*end != 0) || tokens[2].empty()) {
+            out_error = fmt::format("invalid bundle entry '{}' (expected 'file [size] [path]')", line);
+            return false;
+        }
+        if (size > (data.size() - pos)) {
+            out_error = fmt::format("bundle entry '{}' is truncated", tokens[2]);
+            return false;
+        }
+        OutputFile file;
+        file.path = normalize_path(tokens[2]);
+        file.content = data.substr(pos, (size_t)size);
+        pos += (size_t)size;
+        // skip the newline after the content
+        if ((pos < data.size()) && (data[pos] == '\n')) {
+            pos++;
+        }
+        if (out_bundle.find(file.path)) {
+            out_error = fmt::format("duplicate bundle entry '{}'", file.path);
+            return false;
+        }
+        out_bundle.files.push_back(std::move(file));
+    }
+    return true;
+}
+
+std::string Bundle::write() const {
+    std::string data = bundle_header + "\n";
+    for (const OutputFile& file: files) {
+        data += fmt::format("file {} {}\n", file.content.size(), file.path);
+        data += file.content;
+        data += "\n";
+    }
+    return data;
+}
+
+const OutputFile* Bundle::find(const std::string& path) const {
+    const std::string norm_path = normalize_path(path);
+    for (const OutputFile& file: files) {
+        if (file.path == norm_path) {
+            return &file;
+        }
+    }
+    return nullptr;
+}
+
+static bool read_stream(FILE* fp, std::string& out_data) {
+    char buf[64 * 1024];
+    size_t num_bytes = 0;
+    while ((num_bytes = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        out_data.append(buf, num_bytes);
+    }
+    return !ferror(fp);
+}
+
+static bool read_file(const std::string& path, std::string& out_data) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return false;
+    }
+    const bool res = read_stream(fp, out_data);
+    fclose(fp);
+    return res;
+}
+
+static bool write_stream(FILE* fp, const std::string& data) {
+    const bool res = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    return (fflush(fp) == 0) && res;
+}
+
+bool Stream::enabled(const Args& args) {
+    return (args.input == "-") || (args.output == "-") || !args.input_bundle.empty() || !args.output_bundle.empty();
+}
+
+int Stream::run(const Args& args, const Cache& cache) {
+    #if defined(__wasi__)
+    fmt::print(stderr, "sokol-shdc: stdin/stdout and bundle streams are not supported on this platform\n");
+    return 10;
+    #else
+    // reserve stdout for the generated output, and redirect everything else to stderr
+    const bool to_stdout = (args.output == "-") || (args.output_bundle == "-");
+    FILE* out = nullptr;
+    if (to_stdout) {
+        #if defined(_WIN32)
+        out = _fdopen(_dup(_fileno(stdout)), "wb");
+        _dup2(_fileno(stderr), _fileno(stdout));
+        #else
+        out = fdopen(dup(fileno(stdout)), "wb");
+        dup2(fileno(stderr), fileno(stdout));
+        #endif
+        if (!out) {
+            fmt::print(stderr, "sokol-shdc: failed to setup stdout output\n");
+            return 10;
+        }
+    }
+    #if defined(_WIN32)
+    _setmode(_fileno(stdin), _O_BINARY);
+    #endif
+
+    // load the input bundle or the input file from stdin
+    Args job = args;
+    Bundle input_bundle;
+    std::string stdin_data;
+    if (!args.input_bundle.empty()) {
+        std::string data;
+        const bool loaded = (args.input_bundle == "-") ? read_stream(stdin, data) : read_file(args.input_bundle, data);
+        std::string parse_error;
+        if (!loaded) {
+            fmt::print(stderr, "sokol-shdc: failed to read input bundle '{}'\n", args.input_bundle);
+            return 10;
+        }
+        if (!Bundle::parse(data, input_bundle, parse_error)) {
+            fmt::print(stderr, "sokol-shdc: {}: {}\n", args.input_bundle, parse_error);
+            return 10;
+        }
+        if (job.input.empty()) {
+            if (input_bundle.files.empty()) {
+                fmt::print(stderr, "sokol-shdc: input bundle '{}' is empty\n", args.input_bundle);
+                return 10;
+            }
+            job.input = input_bundle.files[0].path;
+        }
+    } else if (args.input == "-") {
+        if (!read_stream(stdin, stdin_data)) {
+            fmt::print(stderr, "sokol-shdc: failed to read input from stdin\n");
+            return 10;
+        }
+    }
+
+    // with an input bundle, files are only looked up in the bundle, otherwise
+    // @include files of the stdin input are loaded from the filesystem
+    const bool use_bundle = !args.input_bundle.empty();
+    const bool use_stdin = (args.input == "-") && !use_bundle;
+    const Input::FileLoader loader = [&input_bundle, &stdin_data, use_bundle, use_stdin](const std::string& path, std::string& out_content) {
+        if (use_bundle) {
+            const OutputFile* file = input_bundle.find(path);
+            if (file) {
+                out_content = file->content;
+            }
+            return file != nullptr;
+        }
+        if (use_stdin && (path == "-")) {
+            out_content = stdin_data;
+            return true;
+        }
+        return read_file(path, out_content);
+    };
+
+    Pipeline res = Pipeline::run_in_memory(job, cache, loader);
+    res.print(args.error_format);
+    if ((res.exit_code != 0) || args.check) {
+        return res.exit_code;
+    }
+
+    // write the generated files
+    if (!args.output_bundle.empty()) {
+        Bundle output_bundle;
+        output_bundle.files = std::move(res.output_files);
+        const std::string data = output_bundle.write();
+        const bool written = (args.output_bundle == "-") ? write_stream(out, data) : Output::write_if_changed(args.output_bundle, data, false);
+        if (!written) {
+            fmt::print(stderr, "sokol-shdc: failed to write output bundle '{}'\n", args.output_bundle);
+            return 10;
+        }
+    } else if (args.output == "-") {
+        if (res.output_files.size() != 1) {
+            fmt::print(stderr, "sokol-shdc: -o - needs an output format with a single output file ({} files generated), use --output-bundle instead\n", res.output_files.size());
+            return 10;
+        }
+        if (!write_stream(out, res.output_files[0].content)) {
+            fmt::print(stderr, "sokol-shdc: failed to write output to stdout\n");
+            return 10;
+        }
+    } else {
+        for (const OutputFile& file: res.output_files) {
+            if (!Output::write_if_changed(file.path, file.content, file.text)) {
+                fmt::print(stderr, "sokol-shdc: failed to write output file '{}'\n", file.path);
+                return 10;
+            }
+        }
+    }
+    if (out) {
+        fclose(out);
+    }
+    return 0;
+    #endif
+}
+
+} // namespace shdc
@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "args.h"
+#include "cache.h"
+#include "output.h"
+
+namespace shdc {
+
+// several files in a single stream (--input-bundle and --output-bundle), the format is:
+//
+//  sokol-shdc-bundle 1
+//  file [size in bytes] [path]
+//  [file content]
+//  file [size in bytes] [path]
+//  [file content]
+//  ...
+//
+// each file content is followed by a single newline character
+struct Bundle {
+    std::vector<OutputFile> files;
+
+    static bool parse(const std::string& data, Bundle& out_bundle, std::string& out_error);
+    std::string write() const;
+    const OutputFile* find(const std::string& path) const;
+};
+
+// stream mode, the input and @include files are read from stdin or an input bundle,
+// and the generated files are written to stdout or an output bundle, without
+// any intermediate files (except for Metal bytecode compilation with -b)
+struct Stream {
+    // true if the args read from stdin, write to stdout or use a bundle
+    static bool enabled(const Args& args);
+    static int run(const Args& args, const Cache& cache);
+};
+
+} // namespace shdc
@@ -0,0 +1,188 @@
+/*
+    Per-stage timing instrumentation (--timings).
+
+    Instrumented code creates a Timings::Scope on the stack, while timings
+    are disabled this only checks a flag. While enabled, each scope records
+    a complete trace event with its start time, duration and the track of
+    the thread which ran it: the thread which called Timings::enable() is
+    the 'main' track, worker threads use the track of their worker index
+    (see Jobs::run()), so that parallel tasks show up as one track per
+    worker thread in chrome://tracing or Perfetto.
+
+    The long-running modes (--server, --watch, --lsp) write a report after
+    each request or rebuild, which takes the events recorded since the
+    previous report, so that the event list doesn't grow without bounds.
+*/
+#include "timings.h"
+#include "json.h"
+#include "output.h"
+#include "fmt/format.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace shdc {
+
+struct TraceEvent {
+    const char* name = nullptr;
+    std::string detail;
+    uint64_t start_us = 0;
+    uint64_t dur_us = 0;
+    int track = 0;
+};
+
+static std::atomic<bool> timings_enabled(false);
+static std::chrono::steady_clock::time_point start_time;
+static std::mutex events_mutex;
+static std::vector<TraceEvent> events;
+static int num_tracks = 1;
+// the start of the time span covered by the next write_report()
+static std::atomic<uint64_t> report_start_us(0);
+static thread_local int thread_track = 0;
+
+static uint64_t now_us() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+Timings::Scope::Scope(const char* n, const char* d, const char* d2) {
+    if (timings_enabled.load(std::memory_order_relaxed)) {
+        name = n;
+        detail = d;
+        detail2 = d2;
+        active = true;
+        start_us = now_us();
+    }
+}
+
+Timings::Scope::~Scope() {
+    if (!active) {
+        return;
+    }
+    TraceEvent event;
+    event.name = name;
+    event.start_us = start_us;
+    event.dur_us = now_us() - start_us;
+    event.track = thread_track;
+    if (detail) {
+        event.detail = detail;
+    }
+    if (detail2) {
+        event.detail += event.detail.empty() ? detail2 : fmt::format(" {}", detail2);
+    }
+    std::lock_guard<std::mutex> lock(events_mutex);
+    events.push_back(std::move(event));
+}
+
+void Timings::enable() {
+    start_time = std::chrono::steady_clock::now();
+    report_start_us = 0;
+    thread_track = 0;
+    timings_enabled = true;
+}
+
+bool Timings::enabled() {
+    return timings_enabled.load(std::memory_order_relaxed);
+}
+
+void Timings::set_thread_track(int track) {
+    thread_track = track;
+    if (enabled()) {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        num_tracks = std::max(num_tracks, track + 1);
+    }
+}
+
+// the trace-event JSON of a list of events
+static std::string trace_json(const std::vector<TraceEvent>& trace_events, int trace_tracks) {
+    std::string data = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (int track = 0; track < trace_tracks; track++) {
+        Json meta = Json::make_object();
+        meta.set("name", Json::make_string("thread_name"));
+        meta.set("ph", Json::make_string("M"));
+        meta.set("pid", Json::make_number(1));
+        meta.set("tid", Json::make_number(track));
+        meta.set("args", Json::make_object()).set("name", Json::make_string((track == 0) ? std::string("main") : fmt::format("worker {}", track)));
+        data += meta.dump();
+        data += ",\n";
+    }
+    for (const TraceEvent& event: trace_events) {
+        Json ev = Json::make_object();
+        ev.set("name", Json::make_string(event.name));
+        ev.set("cat", Json::make_string("shdc"));
+        ev.set("ph", Json::make_string("X"));
+        ev.set("ts", Json::make_number((double)event.start_us));
+        ev.set("dur", Json::make_number((double)event.dur_us));
+        ev.set("pid", Json::make_number(1));
+        ev.set("tid", Json::make_number(event.track));
+        if (!event.detail.empty()) {
+            ev.set("args", Json::make_object()).set("detail", Json::make_string(event.detail));
+        }
+        data += ev.dump();
+        data += ",\n";
+    }
+    // remove the trailing comma
+    data.erase(data.size() - 2, 1);
+    data += "]}\n";
+    return data;
+}
+
+// the per-stage totals of a list of events, sorted by total time
+static std::vector<Timings::Stage> stage_totals_of(const std::vector<TraceEvent>& trace_events) {
+    std::map<std::string, Timings::Stage> stages;
+    for (const TraceEvent& event: trace_events) {
+        Timings::Stage& stage = stages[event.name];
+        stage.name = event.name;
+        stage.count++;
+        stage.total_us += event.dur_us;
+        stage.max_us = std::max(stage.max_us, event.dur_us);
+    }
+    // stages which took the most time first
+    std::vector<Timings::Stage> sorted;
+    for (const auto& item: stages) {
+        sorted.push_back(item.second);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Timings::Stage& a, const Timings::Stage& b) {
+        return a.total_us > b.total_us;
+    });
+    return sorted;
+}
+
+static void print_stages(const std::vector<Timings::Stage>& stages, uint64_t wall_us) {
+    fmt::print(stderr, "Timings (wall time: {:.3f} ms):\n", wall_us / 1000.0);
+    fmt::print(stderr, "  {:<28} {:>8} {:>12} {:>12} {:>12}\n", "stage", "count", "total ms", "avg ms", "max ms");
+    for (const Timings::Stage& stage: stages) {
+        fmt::print(stderr, "  {:<28} {:>8} {:>12.3f} {:>12.3f} {:>12.3f}\n",
+            stage.name,
+            stage.count,
+            stage.total_us / 1000.0,
+            stage.total_us / 1000.0 / stage.count,
+            stage.max_us / 1000.0);
+    }
+    fmt::print(stderr, "\n");
+}
+
+std::vector<Timings::Stage> Timings::stage_totals() {
+    std::lock_guard<std::mutex> lock(events_mutex);
+    return stage_totals_of(events);
+}
+
+bool Timings::write_report(const std::string& path) {
+    std::vector<TraceEvent> report_events;
+    int report_tracks = 1;
+    {
+        std::lock_guard<std::mutex> lock(events_mutex);
+        report_events.swap(events);
+        report_tracks = num_tracks;
+    }
+    if (report_events.empty()) {
+        return true;
+    }
+    const uint64_t end_us = now_us();
+    print_stages(stage_totals_of(report_events), end_us - report_start_us.exchange(end_us));
+    return Output::write_atomic(path, trace_json(report_events, report_tracks));
+}
+
+} // namespace shdc
@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace shdc {
+
+// optional per-stage timing instrumentation (--timings), while disabled,
+// an instrumented scope costs a single flag check
+struct Timings {
+    // records a trace event from construction to destruction, the optional
+    // detail strings (e.g. snippet name and shader language) must outlive the scope
+    struct Scope {
+        Scope(const char* name, const char* detail = nullptr, const char* detail2 = nullptr);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        const char* name = nullptr;
+        const char* detail = nullptr;
+        const char* detail2 = nullptr;
+        bool active = false;
+        uint64_t start_us = 0;
+    };
+
+    // the accumulated time of all events with the same name
+    struct Stage {
+        std::string name;
+        int count = 0;
+        uint64_t total_us = 0;
+        uint64_t max_us = 0;
+    };
+
+    // start recording, the calling thread is the 'main' track
+    static void enable();
+    static bool enabled();
+    // assign the calling thread to a worker track (called by Jobs::run() on new worker threads)
+    static void set_thread_track(int track);
+    // all stages sorted by total time (summed over all threads)
+    static std::vector<Stage> stage_totals();
+    // print the number of calls and total/average/max time per stage to stderr, and write
+    // the events as Chrome trace-event JSON (chrome://tracing or Perfetto) with one track
+    // per worker thread, a report contains the events since the previous report, which are
+    // removed (called after each request or rebuild in the long-running modes, and at exit),
+    // does nothing if no events were recorded since the previous report
+    static bool write_report(const std::string& path);
+};
+
+} // namespace shdc
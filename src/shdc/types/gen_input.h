@@ -4,6 +4,7 @@
 #include "spirvcross.h"
 #include "bytecode.h"
 #include "reflection.h"
+#include "output.h"
 
 namespace shdc::gen {
 
@@ -13,6 +14,7 @@ struct GenInput {
     const std::array<Spirvcross,Slang::Num>& spirvcross;
     const std::array<Bytecode,Slang::Num>& bytecode;
     const refl::Reflection& refl;
+    std::vector<OutputFile>* output_files = nullptr;   // if set, output files are collected here instead of written
 
     GenInput(const Args& args,
              const Input& inp,
@@ -1,21 +1,21 @@
 #pragma once
-#include <string>
+#include <string_view>
 
 namespace shdc {
 
 // mapping each line to included filename and line index
 struct Line {
-    std::string line;       // line content
+    std::string_view line;  // line content, points into Input::sources
     int filename = 0;       // index into Input filenames
     int index = 0;          // line index == line nr - 1
 
     Line();
-    Line(const std::string& ln, int fn, int ix);
+    Line(std::string_view ln, int fn, int ix);
 };
 
 inline Line::Line() { };
 
-inline Line::Line(const std::string& ln, int fn, int ix):
+inline Line::Line(std::string_view ln, int fn, int ix):
     line(ln),
     filename(fn),
     index(ix)
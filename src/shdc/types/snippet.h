@@ -24,6 +24,9 @@ struct Snippet {
     std::map<std::string, SamplerTypeTag> sampler_type_tags;
     std::string name;
     std::vector<int> lines; // resolved zero-based line-indices (including @include_block)
+    bool reachable = true;  // false for @vs and @fs snippets which are not used by any (selected) @program
+    std::string spirv_path;         // optional precompiled SPIRV module (@spirv path)
+    std::vector<uint32_t> spirv;    // the loaded @spirv module, replaces the GLSL source
 
     Snippet();
     Snippet(Type t, const std::string& n);
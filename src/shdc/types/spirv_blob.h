@@ -7,7 +7,7 @@ namespace shdc {
 // a SPIRV-bytecode blob with "back-link" to Input.snippets
 struct SpirvBlob {
     int snippet_index = -1;         // index into Input.snippets
-    std::string source;             // source code this blob was compiled from
+    std::string source;             // source code this blob was compiled from (optional, see Spirv::compile_glsl())
     std::vector<uint32_t> bytecode; // the resulting SPIRV blob
 
     SpirvBlob(int snippet_index);
@@ -0,0 +1,220 @@
+/*
+    Watch mode: compile once, then wait for changes in the input files and
+    their @include files and recompile the affected jobs.
+
+    The files of each job are the Input::filenames of its last compilation,
+    so that changes to the @include graph are picked up with every rebuild.
+    On a change only the jobs which read the changed file are recompiled, and
+    since watch mode runs with the in-memory artifact cache, only the snippets
+    whose resolved source lines changed actually go through glslang, SPIRV-Cross
+    and the bytecode compilers again.
+
+    On Linux, changes are detected with inotify on the parent directories of
+    all watched files (so that editors which save by renaming a temporary file
+    are handled), on other platforms the file modification times are polled.
+*/
+#include "watch.h"
+#include "batch.h"
+#include "jobs.h"
+#include "pipeline.h"
+#include "timings.h"
+#include "fmt/format.h"
+#include <set>
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#if defined(__linux__)
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace shdc {
+
+struct WatchJob {
+    Args args;
+    Pipeline result;
+    std::set<std::string> files;    // normalized paths of all files read by the last compilation
+};
+
+static std::string normalize_path(const std::string& path) {
+    std::error_code ec;
+    const fs::path res = fs::weakly_canonical(fs::absolute(path, ec), ec);
+    return ec ? path : res.string();
+}
+
+// wait for changes in a set of files, returns the changed files
+struct Watcher {
+    #if defined(__linux__)
+    int fd = -1;
+    std::map<int, std::string> dirs;    // inotify watch descriptor to directory
+
+    Watcher() {
+        fd = inotify_init1(IN_CLOEXEC);
+    }
+    ~Watcher() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    // read all pending inotify events, add changed watched files to out_changed
+    void read_events(const std::set<std::string>& files, std::set<std::string>& out_changed) {
+        alignas(inotify_event) char buf[4096];
+        const ssize_t num_bytes = read(fd, buf, sizeof(buf));
+        for (ssize_t pos = 0; pos < num_bytes;) {
+            const inotify_event* event = (const inotify_event*)&buf[pos];
+            auto it = dirs.find(event->wd);
+            if ((it != dirs.end()) && (event->len > 0)) {
+                const std::string path = (fs::path(it->second) / event->name).string();
+                if (files.count(path) > 0) {
+                    out_changed.insert(path);
+                }
+            }
+            pos += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    std::set<std::string> wait(const std::set<std::string>& files) {
+        std::set<std::string> changed;
+        if (fd < 0) {
+            return changed;
+        }
+        for (const std::string& file: files) {
+            const std::string dir = fs::path(file).parent_path().string();
+            const int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+            if (wd >= 0) {
+                dirs[wd] = dir;
+            }
+        }
+        pollfd pfd = { fd, POLLIN, 0 };
+        while (changed.empty()) {
+            if (poll(&pfd, 1, -1) > 0) {
+                read_events(files, changed);
+            }
+        }
+        // editors often write a file in several steps, wait until things have calmed down
+        while (poll(&pfd, 1, 50) > 0) {
+            read_events(files, changed);
+        }
+        return changed;
+    }
+    #else
+    std::map<std::string, fs::file_time_type> mtimes;
+
+    static fs::file_time_type mtime(const std::string& path) {
+        std::error_code ec;
+        const fs::file_time_type res = fs::last_write_time(path, ec);
+        return ec ? fs::file_time_type::min() : res;
+    }
+
+    std::set<std::string> wait(const std::set<std::string>& files) {
+        for (const std::string& file: files) {
+            if (mtimes.count(file) == 0) {
+                mtimes[file] = mtime(file);
+            }
+        }
+        std::set<std::string> changed;
+        while (changed.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            for (const std::string& file: files) {
+                const fs::file_time_type cur = mtime(file);
+                if (cur != mtimes[file]) {
+                    mtimes[file] = cur;
+                    changed.insert(file);
+                }
+            }
+        }
+        return changed;
+    }
+    #endif
+};
+
+// compile a subset of jobs in parallel, print messages in job order
+static void compile_jobs(const Args& args, const Cache& cache, std::vector<WatchJob>& jobs, const std::vector<int>& job_indices) {
+    Jobs::run(args.num_jobs, (int)job_indices.size(), [&jobs, &job_indices, &cache](int i) {
+        WatchJob& job = jobs[job_indices[i]];
+        job.result = Pipeline::run(job.args, cache);
+    });
+    int num_failed = 0;
+    for (int job_index: job_indices) {
+        WatchJob& job = jobs[job_index];
+        job.result.print(job.args.error_format);
+        if (job.result.exit_code != 0) {
+            num_failed++;
+        }
+        job.files.clear();
+        job.files.insert(normalize_path(job.args.input));
+        for (const std::string& filename: job.result.filenames) {
+            job.files.insert(normalize_path(filename));
+        }
+    }
+    if (num_failed > 0) {
+        fmt::print(stderr, "sokol-shdc: {} of {} jobs failed\n", num_failed, (int)job_indices.size());
+    }
+    // with --timings, each rebuild reports its own events
+    if (!args.timings.empty()) {
+        Timings::write_report(args.timings);
+    }
+}
+
+int Watch::run(const Args& args, const Cache& cache) {
+    std::vector<WatchJob> jobs;
+    if (!args.batch.empty()) {
+        std::vector<Args> job_args;
+        int num_invalid = 0;
+        if (!Batch::load_jobs(args, job_args, num_invalid)) {
+            return 10;
+        }
+        for (Args& job_arg: job_args) {
+            WatchJob job;
+            job.args = std::move(job_arg);
+            jobs.push_back(std::move(job));
+        }
+    } else {
+        WatchJob job;
+        job.args = args;
+        jobs.push_back(std::move(job));
+    }
+    std::vector<int> job_indices;
+    for (int i = 0; i < (int)jobs.size(); i++) {
+        job_indices.push_back(i);
+    }
+    compile_jobs(args, cache, jobs, job_indices);
+
+    Watcher watcher;
+    while (true) {
+        std::set<std::string> files;
+        for (const WatchJob& job: jobs) {
+            files.insert(job.files.begin(), job.files.end());
+        }
+        fmt::print(stderr, "sokol-shdc: watching {} files for changes...\n", files.size());
+        const std::set<std::string> changed = watcher.wait(files);
+        if (changed.empty()) {
+            fmt::print(stderr, "sokol-shdc: failed to watch for file changes\n");
+            return 10;
+        }
+        // only recompile the jobs which depend on one of the changed files
+        job_indices.clear();
+        for (int i = 0; i < (int)jobs.size(); i++) {
+            for (const std::string& file: changed) {
+                if (jobs[i].files.count(file) > 0) {
+                    job_indices.push_back(i);
+                    break;
+                }
+            }
+        }
+        for (const std::string& file: changed) {
+            fmt::print(stderr, "sokol-shdc: '{}' changed\n", file);
+        }
+        compile_jobs(args, cache, jobs, job_indices);
+    }
+    return 0;
+}
+
+} // namespace shdc
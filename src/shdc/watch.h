@@ -0,0 +1,13 @@
+#pragma once
+#include "args.h"
+#include "cache.h"
+
+namespace shdc {
+
+// watch mode (--watch), compiles the input file (or all jobs of a --batch manifest)
+// and recompiles when the input file or one of its @include files changes
+struct Watch {
+    static int run(const Args& args, const Cache& cache);
+};
+
+} // namespace shdc
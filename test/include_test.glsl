@@ -0,0 +1,18 @@
+@include include_test_inc.glsl
+
+@vs vs
+@include_block scale
+in vec4 position;
+void main() {
+    gl_Position = scale_pos(position);
+}
+@end
+
+@fs fs
+out vec4 frag_color;
+void main() {
+    frag_color = vec4(1.0, 0.0, 0.0, 1.0);
+}
+@end
+
+@program include_test vs fs
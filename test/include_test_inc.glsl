@@ -0,0 +1,5 @@
+@block scale
+vec4 scale_pos(vec4 pos) {
+    return vec4(pos.xyz * 0.5, pos.w);
+}
+@end
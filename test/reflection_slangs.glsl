@@ -0,0 +1,65 @@
+// Reflection info is computed once per snippet and shared between target
+// languages, it must match the reflection info of a single-target compilation,
+// both for snippets which are compiled once for all targets (vs_plain), and
+// snippets which are compiled per target language family (vs_slang, fs_slang).
+@block params
+layout(binding=0) uniform vs_params {
+    mat4 mvp;
+    vec4 offset;
+};
+@end
+
+@vs vs_plain
+@include_block params
+in vec4 position;
+in vec2 texcoord0;
+out vec2 uv;
+void main() {
+    gl_Position = mvp * (position + offset);
+    uv = texcoord0;
+}
+@end
+
+@vs vs_slang
+@include_block params
+in vec4 position;
+in vec2 texcoord0;
+out vec2 uv;
+void main() {
+    #if SOKOL_GLSL
+    gl_Position = mvp * position + offset;
+    #else
+    gl_Position = mvp * (position + offset);
+    #endif
+    uv = texcoord0;
+}
+@end
+
+@fs fs_plain
+layout(binding=0) uniform texture2D tex;
+layout(binding=0) uniform sampler smp;
+in vec2 uv;
+out vec4 frag_color;
+void main() {
+    frag_color = texture(sampler2D(tex, smp), uv);
+}
+@end
+
+@fs fs_slang
+@image_sample_type ftex unfilterable_float
+@sampler_type fsmp nonfiltering
+layout(binding=0) uniform texture2D ftex;
+layout(binding=0) uniform sampler fsmp;
+in vec2 uv;
+out vec4 frag_color;
+void main() {
+    #if SOKOL_MSL || SOKOL_HLSL
+    frag_color = texture(sampler2D(ftex, fsmp), uv).zyxw;
+    #else
+    frag_color = texture(sampler2D(ftex, fsmp), uv);
+    #endif
+}
+@end
+
+@program plain vs_plain fs_plain
+@program slang vs_slang fs_slang
@@ -0,0 +1,32 @@
+// @vs and @fs snippets which are not used by any @program are not compiled,
+// compile with '--programs prog_a' to only generate the first program
+@vs vs
+in vec4 position;
+void main() {
+    gl_Position = position;
+}
+@end
+
+@fs fs_a
+out vec4 frag_color;
+void main() {
+    frag_color = vec4(1.0, 0.0, 0.0, 1.0);
+}
+@end
+
+@fs fs_b
+uniform fs_params {
+    vec4 color;
+};
+out vec4 frag_color;
+void main() {
+    frag_color = color;
+}
+@end
+
+@vs vs_unused
+this is not valid GLSL, but the snippet isn't used by any @program
+@end
+
+@program prog_a vs fs_a
+@program prog_b vs fs_b